@@ -40,7 +40,11 @@ Options:\n\
          --col_gene <int>: column number for gene name of reference file (default:0).\n\
          --consid_ov: consider exon overlapping. If exon is overlapped less than (1-thresh), the non-overlapping exon is used for calculation. Set --thresh argument(default: off)l\n\
          --thresh: threshold for considering exon overlapping. The 'non-overlapping' exon is used for calculation for exon which is overlapped by proportion of '1-thresh'(default:0.5).\n\
-         --header: the first line of reference file is considered as header (default:off).\n");
+         --sigfmt <sig format:bedgraph | sigbin | sigshm | bigwig>: format of expression file (default:bedgraph).\n\
+         --header: the first line of reference file is considered as header (default:off).\n\
+         --sig_index: window sums are calculated from prefix-sum index of signal, so the time doesn't depend on window size. The last digit may differ by rounding (default:off)\n\
+         --compact: adjacent signal records with the same value are merged and records with value 0 are removed on loading, so the scan of signal is shorter. The last digit may differ by rounding (default:off)\n\
+         --sig_quant <none | half | int16>: signal values are stored in 16 bits to save memory. half keeps about 3 significant digits, and int16 keeps 1/32767 of the max value of each chr (default:none)\n");
   exit(0);
 }
 
@@ -53,10 +57,16 @@ static void version()
 
 static int hf = 0;
 static char hfs[4] = "off\0";
+static int sig_index = 0; //if 1, window sums are calculated by prefix-sum index
+static char sig_indexs[4] = "off\0";
+static int compact = 0; //if 1, adjacent sig with the same value are merged on loading
+static char compacts[4] = "off\0";
+static char *sig_quant = "none"; //none | half | int16
 static int cf = 0;
 static char cfs[4] = "off\0";
 static char *fileexp = NULL;
 static char *fileref = NULL;
+static char *sigfmt = "bedgraph";
 static int readlen = 101;
 static int col_chr = 2;
 static int col_st = 4;
@@ -68,6 +78,7 @@ static int col_gene = 0;
 static double thresh = 0.5; //threshold for considering exon overlapping. The "non-overlapping" exon is used for calculation for exon of which is overlapped proportion is less than (1-thresh). Thus if thresh is 0.7, and overlapping rate is less than 0.3, the remaining non-overlapping (>=0.7) exon is used for calculation.
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line
+static char ga_line_in[LINE_STR_LEN] = {0}; //input line made by ga_line
 
 static const Argument args[] = {
   {"-h"           , ARGUMENT_TYPE_FUNCTION, usage        },
@@ -77,6 +88,7 @@ static const Argument args[] = {
   {"--consid_ov"  , ARGUMENT_TYPE_FLAG_ON , &cf          },
   {"-exp"         , ARGUMENT_TYPE_STRING  , &fileexp     },
   {"-ref"         , ARGUMENT_TYPE_STRING  , &fileref     },
+  {"--sigfmt"     , ARGUMENT_TYPE_STRING  , &sigfmt      },
   {"-readlen"     , ARGUMENT_TYPE_INTEGER , &readlen     },
   {"--col_chr"    , ARGUMENT_TYPE_INTEGER , &col_chr     },
   {"--col_start"  , ARGUMENT_TYPE_INTEGER , &col_st      },
@@ -86,6 +98,9 @@ static const Argument args[] = {
   {"--col_exon_ed", ARGUMENT_TYPE_INTEGER , &col_ex_ed   },
   {"--col_gene"   , ARGUMENT_TYPE_INTEGER , &col_gene    },
   {"--thresh"     , ARGUMENT_TYPE_FLOAT   , &thresh      },
+  {"--sig_index"  , ARGUMENT_TYPE_FLAG_ON , &sig_index   },
+  {"--compact"    , ARGUMENT_TYPE_FLAG_ON , &compact     },
+  {"--sig_quant"  , ARGUMENT_TYPE_STRING  , &sig_quant   },
   {NULL           , ARGUMENT_TYPE_NONE    , NULL         },
 };
 
@@ -99,8 +114,9 @@ int main (int argc, char *argv[])
   struct chr_block *chr_block_headref = NULL; //for reference
 
   struct chr_block *ch_ref, *ch_exp; //for "for loop of chr"
+  struct chr_block **exp_idx = NULL; //exp addressed by chr ID
   struct ref *r;
-  struct sig *j1, *j1_tmp;
+  unsigned long j1, j1_tmp; //index of sig arrays of ch_exp
   struct output *output_head = NULL; //for output
 
   /*path, filename, and extension*/
@@ -120,16 +136,19 @@ int main (int argc, char *argv[])
   unsigned long tmp_ed;
   unsigned long exon_len;
   int fl, c, exon_nb;
-  double val;
+  double val, sum;
 
   time_t timer;
 
   if(hf) strcpy(hfs, "on\0");
+  if(sig_index) strcpy(sig_indexs, "on\0");
+  if(compact) strcpy(compacts, "on\0");
   if(cf) strcpy(cfs, "on\0");
   time(&timer);
   printf("Tool:                            %s\n\n\
 Input expression file:             %s\n\
 Input reference file:              %s\n\
+expression format:                 %s\n\
 Read length:                       %d\n\
 ref col of chr, start, end, strand:%d, %d, %d, %d\n\
 ref col exon start, end:           %d, %d\n\
@@ -137,32 +156,37 @@ ref col gene:                      %d\n\
 header flag:                       %s\n\
 consider overlapping?:             %s\n\
 threshold:                         %.3f\n\
+signal index:                      %s\n\
+signal compaction:                 %s\n\
+signal quantization:               %s\n\
 time:                              %s\n",\
- "ga_RPKM", fileexp, fileref, readlen, col_chr, col_st, col_ed, col_strand, col_ex_st, col_ex_ed, col_gene, hfs, cfs, thresh, ctime(&timer) );
+ "ga_RPKM", fileexp, fileref, sigfmt, readlen, col_chr, col_st, col_ed, col_strand, col_ex_st, col_ex_ed, col_gene, hfs, cfs, thresh, sig_indexs, compacts, sig_quant, ctime(&timer) );
 
   ga_parse_file_path (fileexp, path_exp, fn_exp, ext_exp); //parsing input file name into path, file name, and extension
+  if (!strcmp(sigfmt, "sigshm")) path_exp[0] = '\0'; //signal store has no directory, so the output is written in the current directory
   ga_parse_file_path (fileref, path_ref, fn_ref, ext_ref);
 
   ga_parse_chr_ref (fileref, &chr_block_headref, col_chr, col_st, col_ed, col_strand, col_ex_st, col_ex_ed, col_gene, hf); //parsing each ref for each chromosome
 
   // reading exp file
-  ga_parse_bedgraph (fileexp, &chr_block_headexp);
+  if (ga_parse_sig (fileexp, sigfmt, &chr_block_headexp) != 0) {
+    LOG("error: error in ga_parse_sig function.");
+    goto err;
+  }
 
   // sorting summit and sig
-  chr_block_headref = ga_mergesort_chr(chr_block_headref);
-  chr_block_headexp = ga_mergesort_chr(chr_block_headexp);
-
-  for (ch_ref = chr_block_headref; ch_ref; ch_ref = ch_ref -> next) {
-    ch_ref -> ref_list = ga_mergesort_ref(ch_ref -> ref_list);
-  }
-  for (ch_exp = chr_block_headexp; ch_exp; ch_exp = ch_exp -> next) {
-    ch_exp -> sig_list = ga_mergesort_sig(ch_exp -> sig_list);
+  chr_block_headref = ga_sort_chr_block_ref(chr_block_headref);
+  chr_block_headexp = ga_sort_chr_block_sig(chr_block_headexp);
+  if (compact) ga_compact_sig (chr_block_headexp, 1);
+  if (ga_quantize_sig (chr_block_headexp, sig_quant) != 0) {
+    LOG("error: error in ga_quantize_sig function.");
+    goto err;
   }
+  if (sig_index) ga_index_sig (chr_block_headexp);
 
+  exp_idx = ga_index_chr_block (chr_block_headexp);
   for (ch_ref = chr_block_headref; ch_ref; ch_ref = ch_ref -> next) {
-    for (ch_exp = chr_block_headexp; ch_exp; ch_exp = ch_exp -> next) {
-      if (!strcmp(ch_ref->chr, ch_exp->chr)) break;
-    }
+    ch_exp = exp_idx[ch_ref->id];
 
     if (cf) { //if considering exon overlap
       if(reassign_exon (ch_ref -> ref_list) != 0) {
@@ -176,15 +200,16 @@ time:                              %s\n",\
         if (cf) sprintf(tmp, "0\t%s\t%s\t%s\t%.3f\n", r -> rm_ex_st, r -> rm_ex_ed, r -> ov_gene, r -> ov_prop);
         else sprintf(tmp, "0\n");
 
-        if (add_one_val(ga_line_out, r -> line, tmp) < 0) {
+        if (add_one_val(ga_line_out, ga_line(ga_line_in, r -> line, r -> line_len), tmp) < 0) {
           LOG("error: output line was too long.");
           goto err;
         }
         ga_output_append (&output_head, ga_line_out);
       }
+      continue;
     }
 
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each ref.
+    j1_tmp = 0; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each ref.
     for (r = ch_ref -> ref_list; r; r = r -> next) {
       fl = 0; //init of flag
       val = 0;
@@ -207,51 +232,40 @@ time:                              %s\n",\
         st = arr_ex_st[c] - 1; //-1 because bedgraph is zero-based, exon st also should be zero-based
         ed = arr_ex_ed[c]; //but end is half-open, so this is not -1.
         exon_len += ed - st; 
-        if (j1_tmp == NULL) {
-          for (j1 = ch_exp->sig_list; j1; j1=j1->next) {
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the exon
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap exon
-              j1 = NULL;
-              break;
-            }
-          }
-        } else {
-          for (j1 = j1_tmp; j1; j1=j1->next) { //starting the search from j1_tmp to speed up!
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the exon
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap exon
-              j1 = NULL;
-              break;
-            }
+        if (SIG_DIRECT(ch_exp)) { //sum by prefix-sum index or dense sig blocks
+          ga_sig_sum (ch_exp, st, ed, &sum);
+          val += sum;
+          continue;
+        }
+        for (j1 = j1_tmp; j1 < ch_exp->sig_nb; j1++) { //starting the search from j1_tmp to speed up!
+          if (st < SIG_ED(ch_exp, j1) && SIG_ST(ch_exp, j1) < ed) {
+            break; //if one of sig block is inside the exon
+          } else if (SIG_ST(ch_exp, j1) >= ed) { //if there's no chance for j1 to overlap exon
+            j1 = ch_exp->sig_nb;
+            break;
           }
         }
 
-        if (j1 == NULL) continue; //if the exon doesn't overlap with any sig
+        if (j1 == ch_exp->sig_nb) continue; //if the exon doesn't overlap with any sig
 
-        if (!(r -> ov_prop)) { //if no overlap
-          if (j1_tmp == NULL) { //if j1_tmp is not set for the chr
-            j1_tmp = j1;
-            fl = 1;
-          } else if (!fl) { //else if j1_tmp is not set for the ref (fl == 0)
-            j1_tmp = j1;
-            fl = 1;
-          }
+        if (!(r -> ov_prop) && !fl) { //if no overlap and j1_tmp is not set for the ref (fl == 0)
+          j1_tmp = j1;
+          fl = 1;
         }
 
-        for (;j1 ; j1 = j1->next) {
-          if (j1->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1->st) tmp_st = st; //if st of sig block is left-side to pos of st
-          else tmp_st = j1->st;
-          if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is right-side to pos of ed
-          else tmp_ed = j1->ed;
-          val += (j1->val) * (tmp_ed - tmp_st);
+        for (; j1 < ch_exp->sig_nb; j1++) {
+          if (SIG_ST(ch_exp, j1) >= ed) break; //if the sig pos is out of the win
+          if (st > SIG_ST(ch_exp, j1)) tmp_st = st; //if st of sig block is left-side to pos of st
+          else tmp_st = SIG_ST(ch_exp, j1);
+          if (SIG_ED(ch_exp, j1) > ed) tmp_ed = ed; //if ed of sig block is right-side to pos of ed
+          else tmp_ed = SIG_ED(ch_exp, j1);
+          val += SIG_VAL(ch_exp, j1) * (tmp_ed - tmp_st);
         }
       } //for exon
 
       if (cf) sprintf(tmp, "%.6f\t%s\t%s\t%s\t%.3f\n", val / ( (float)exon_len / 1000 ) / (float)readlen, r -> rm_ex_st, r -> rm_ex_ed, r -> ov_gene, r -> ov_prop);
       else sprintf(tmp, "%.6f\n", val / ( (float)exon_len / 1000 ) / (float)readlen ); //calculating RPKM
-      if (add_one_val(ga_line_out, r -> line, tmp) < 0) {
+      if (add_one_val(ga_line_out, ga_line(ga_line_in, r -> line, r -> line_len), tmp) < 0) {
         LOG("error: output line was too long.");
         goto err;
       }
@@ -270,14 +284,18 @@ time:                              %s\n",\
   if (chr_block_headref) ga_free_chr_block(&chr_block_headref);
   if (chr_block_headexp) ga_free_chr_block(&chr_block_headexp);
   if (output_head) ga_free_output(&output_head);
+  MYFREE(exp_idx);
   MYFREE(ga_header_line);
+  ga_free_chr_dict();
   return 0;
 
 err:
   if (chr_block_headref) ga_free_chr_block(&chr_block_headref);
   if (chr_block_headexp) ga_free_chr_block(&chr_block_headexp);
   if (output_head) ga_free_output(&output_head);
+  MYFREE(exp_idx);
   MYFREE(ga_header_line);
+  ga_free_chr_dict();
   return -1;
 }
 
@@ -53,6 +53,7 @@ static int col_chr1 = 0, col_chr2 = 0;
 static int col_smt1 = 3, col_smt2 = 3;
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line with overlapping flag
+static char ga_line_in[LINE_STR_LEN] = {0}; //input line made by ga_line
 
 
 static const Argument args[] = {
@@ -78,6 +79,7 @@ int main (int argc, char *argv[])
   struct output *output_head = NULL; //for output
 
   struct chr_block *ch1, *ch2; //for "for loop of chr"
+  struct chr_block **chr_idx2 = NULL; //peak2 addressed by chr ID
   struct bs *bs_nonov, *bs1; //for bs of file1 of which chr is not in file2 and for loop
 
   /*path, filename, and extension*/
@@ -109,27 +111,17 @@ time:                            %s\n",\
     ga_parse_chr_bs(file1, &chr_block_head1, col_chr1, col_smt1, col_smt1, -1, hf); //parsing each binding sites for each chromosome without strand info
     ga_parse_chr_bs(file2, &chr_block_head2, col_chr2, col_smt2, col_smt2, -1, hf);
 
-    chr_block_head1 = ga_mergesort_chr(chr_block_head1); //sorting chr block
-    chr_block_head2 = ga_mergesort_chr(chr_block_head2); //sorting chr block
-
-    for (ch1 = chr_block_head1; ch1; ch1 = ch1 -> next) { //sorting bs
-      ch1 -> bs_list = ga_mergesort_bs(ch1 -> bs_list);
-    }
-    for (ch2 = chr_block_head2; ch2; ch2 = ch2 -> next) { //sorting bs
-      ch2 -> bs_list = ga_mergesort_bs(ch2 -> bs_list);
-    }
-
+    chr_block_head1 = ga_sort_chr_block_bs(chr_block_head1); //sorting chr block and bs
+    chr_block_head2 = ga_sort_chr_block_bs(chr_block_head2); //sorting chr block and bs
 
+    chr_idx2 = ga_index_chr_block (chr_block_head2);
     for (ch1 = chr_block_head1; ch1; ch1 = ch1->next) {
-      for (ch2 = chr_block_head2; ch2; ch2 = ch2->next) {
-        if (!strcmp(ch1->chr, ch2->chr)) { //comparing peaks on the same chr
-          cmp_two_peaks (ch1->bs_list, ch2->bs_list, &output_head);
-          break;
-        }
+      if ((ch2 = chr_idx2[ch1->id]) != NULL) { //comparing peaks on the same chr
+        cmp_two_peaks (ch1->bs_list, ch2->bs_list, &output_head);
       }
       if (ch2 == NULL) { //if chr_block2 doesn't have ch1
         for (bs_nonov = ch1->bs_list; bs_nonov; bs_nonov = bs_nonov->next) {
-          if (add_one_val(ga_line_out, bs_nonov->line, "NA\tNA\n") < 0){
+          if (add_one_val(ga_line_out, ga_line(ga_line_in, bs_nonov->line, bs_nonov->line_len), "NA\tNA\n") < 0){
             LOG("error: output line was too long.");
             goto err; //making output link list with NA
           }
@@ -156,16 +148,14 @@ time:                            %s\n",\
     ga_free_chr_block(&chr_block_head2);
 
     ga_free_output(&output_head);
+    MYFREE (chr_idx2);
+    ga_free_chr_dict();
 
     return 0;
   } else if (!strcmp(mode, "isd")) { //mode == two or mode == isd
     ga_parse_chr_bs(file1, &chr_block_head1, col_chr1, col_smt1, col_smt1, -1, hf); //parsing each binding sites for each chromosome without strand info
 
-    chr_block_head1 = ga_mergesort_chr(chr_block_head1); //sorting chr block
-
-    for (ch1 = chr_block_head1; ch1; ch1 = ch1 -> next) { //sorting bs
-      ch1 -> bs_list = ga_mergesort_bs(ch1 -> bs_list);
-    }
+    chr_block_head1 = ga_sort_chr_block_bs(chr_block_head1); //sorting chr block and bs
 
     for (ch1 = chr_block_head1; ch1; ch1 = ch1->next) {
       for (bs1 = ch1->bs_list; bs1; bs1 = bs1->next) {
@@ -183,6 +173,7 @@ time:                            %s\n",\
     MYFREE (ga_header_line);
     ga_free_chr_block(&chr_block_head1);
     ga_free_output(&output_head);
+    ga_free_chr_dict();
 
     return 0;
   } else { //mode == two or isd
@@ -196,6 +187,8 @@ err:
   MYFREE (chr_block_head2);
 
   if (output_head) ga_free_output(&output_head);
+  MYFREE (chr_idx2);
+  ga_free_chr_dict();
   return -1;
 }
 
@@ -213,7 +206,7 @@ static void cmp_two_peaks (struct bs *bs1, struct bs *bs2, struct output **outpu
   for (i = bs1; i; i = i->next) {
     if (i->st <= bs2->st) { //if bs1 is the left side among all bs2
       sprintf(tmp, "%lu\t%lu\n", bs2->st - i->st, bs2->st); //distance and peak summit2
-      if (add_one_val(ga_line_out, i->line, tmp) < 0) {
+      if (add_one_val(ga_line_out, ga_line(ga_line_in, i->line, i->line_len), tmp) < 0) {
         LOG("error: output line was too long.");
         goto err;
       }
@@ -224,7 +217,7 @@ static void cmp_two_peaks (struct bs *bs1, struct bs *bs2, struct output **outpu
       if (i->st < j->st) { //if bs2 exceeds bs1
         if (j->st - i->st < i->st - j->prev->st) sprintf(tmp, "%lu\t%lu\n", j->st - i->st, j->st); //if bs1 is close to j->st than (j-1)->st
         else sprintf(tmp, "%lu\t%lu\n", i->st - j->prev->st, j->prev->st);
-        if (add_one_val(ga_line_out, i->line, tmp) < 0){
+        if (add_one_val(ga_line_out, ga_line(ga_line_in, i->line, i->line_len), tmp) < 0){
           LOG("error: output line was too long.");
           goto err;
         }
@@ -235,7 +228,7 @@ static void cmp_two_peaks (struct bs *bs1, struct bs *bs2, struct output **outpu
     }
     if (j == NULL) { //if i is the right side among all bs2
       sprintf(tmp, "%lu\t%lu\n", i->st - j_tmp->st, j_tmp->st); //distance and peak summit2
-      if (add_one_val(ga_line_out, i->line, tmp) < 0){
+      if (add_one_val(ga_line_out, ga_line(ga_line_in, i->line, i->line_len), tmp) < 0){
         goto err;
         LOG("error: output line was too long.");
       }
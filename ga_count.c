@@ -0,0 +1,318 @@
+#include "ga_count.h"
+#include "ga_my.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define COUNT_TASK_BS 256 //number of summits of one counting task
+#define COUNT_TRACK_MAX 3 //number of tracks counted together
+#define LOG(m) \
+  fprintf(stderr, \
+  "%s:line%d:%s(): " m "\n", \
+  __FILE__, __LINE__, __FUNCTION__)
+
+/*
+ * Structure of counting track.
+ * One sig counted around the summits. Windows of summits on plus strand are written in arr_p, and those on minus strand in arr_m.
+ */
+struct count_track {
+  struct chr_block **sig_idx; //sig addressed by chr ID
+  float *arr_p;
+  float *arr_m;
+};
+
+/*
+ * Structure of counting task.
+ * nb summits of one chr from bs, whose columns of arr start at c.
+ */
+struct count_task {
+  struct chr_block *ch_smt;
+  struct bs *bs;
+  long nb;
+  long c;
+  int first; //1 if bs is the first summit of the chr
+  int disjoint[COUNT_TRACK_MAX]; //1 if sig of the track are sorted and don't overlap each other (ga_sig_disjoint)
+};
+
+/*
+ * Structure of counting job.
+ * Tasks are shared by threads, and each thread scans sig of a task with its own j1_tmp of each track.
+ */
+struct count_job {
+  struct count_task *task;
+  long task_nb;
+  long next; //next task to be counted
+  struct count_track track[COUNT_TRACK_MAX]; //sig, minus strand sig and denominator
+  int track_nb;
+  int anti; //1 if track[1] is minus strand sig
+  long smtNb;
+  int hw; //half window size
+  int step; //step size
+  int win; //window size
+  int slide; //1 if window sums are calculated by sliding window
+  pthread_mutex_t mutex;
+};
+
+void ga_count_sig (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_m, struct chr_block *chr_block_headsig_d, float arr[], float arr_a[], float arr_d[], const long smtNb, const int hw, const int step, const int win, const int slide);
+static void count_track_add (struct count_job *job, struct chr_block *chr_block_headsig, float arr_p[], float arr_m[]);
+static void *count_worker (void *arg);
+static unsigned long count_cursor (const struct count_job *job, const struct chr_block *ch_sig, const struct bs *bs);
+static void count_bs (const struct count_job *job, const struct count_task *t, double slide_sum[]);
+static void count_win (const struct count_job *job, const struct chr_block *ch_sig, const struct bs *bs, long st, long ed, unsigned long *j1_tmp, const int sl, float arr_p[], float arr_m[], const long c, double slide_sum[]);
+
+//the structure of arr is [win1:peak1,peak2...peakN|win2:peak1,peak2...peakN|...|winN:peak1,peak2...peakN]
+//the structure of arr_r is [r1:peak1,peak2...peakN|r2:peak1,peak2...peakN|...|rN:peak1,peak2...peakN]
+/*
+ * This counts sig of all tracks around each summit by ga_thread_nb threads.
+ * The summit list is walked once: windows of each summit are computed once, and the tracks are filled side by side.
+ * Summits are split into tasks of COUNT_TASK_BS summits of one chr, and each summit only writes its own column c of arr.
+ * A task which doesn't start a chr begins the scan from the sig found by binary search instead of j1_tmp of the summits before it,
+ * so summits of chr whose sig overlap each other are not split, where the scan may depend on j1_tmp. The result doesn't depend on the threads.
+ * *chr_block_headsig_m: minus strand sig, or NULL. If given, sense reads are written in arr and anti-sense reads in arr_a.
+ * *chr_block_headsig_d: sig of denominator, or NULL. If given, it is written in arr_d.
+ * hw, step, win: half range, step size and window size of the windows around each summit
+ * slide: 1 if window sums are calculated by ga_sig_slide
+ */
+void ga_count_sig (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_m, struct chr_block *chr_block_headsig_d, float arr[], float arr_a[], float arr_d[], const long smtNb, const int hw, const int step, const int win, const int slide)
+{
+  struct count_job job;
+  struct count_task *task = NULL;
+  struct chr_block *ch_smt, *ch_sig;
+  struct bs *bs;
+  pthread_t *th = NULL;
+  long n, c = 0, task_len = 0;
+  int i, k, thread_nb, split, disjoint[COUNT_TRACK_MAX];
+
+  job.track_nb = 0;
+  job.anti = chr_block_headsig_m != NULL;
+  count_track_add (&job, chr_block_headsig, arr, job.anti ? arr_a : arr);
+  if (chr_block_headsig_m) count_track_add (&job, chr_block_headsig_m, arr_a, arr);
+  if (chr_block_headsig_d) count_track_add (&job, chr_block_headsig_d, arr_d, arr_d);
+  job.smtNb = smtNb;
+  job.hw = hw;
+  job.step = step;
+  job.win = win;
+  job.slide = slide;
+  job.task_nb = 0;
+  job.next = 0;
+
+  for (ch_smt = chr_block_headsmt; ch_smt; ch_smt = ch_smt->next) {
+    for (k = 0, split = 1; k < job.track_nb; k++) {
+      ch_sig = job.track[k].sig_idx[ch_smt->id];
+      disjoint[k] = ch_sig && !SIG_DIRECT(ch_sig) ? ga_sig_disjoint (ch_sig) : 1;
+      split = split && disjoint[k];
+    }
+    for (bs = ch_smt->bs_list, n = 0; bs; bs = bs->next, n++, c++) {
+      if (n == 0 || (split && n % COUNT_TASK_BS == 0)) { //new task
+        if (job.task_nb == task_len) {
+          task_len = task_len ? task_len * 2 : 64;
+          task = (struct count_task *)my_realloc(task, task_len * sizeof(struct count_task));
+        }
+        task[job.task_nb].ch_smt = ch_smt;
+        task[job.task_nb].bs = bs;
+        task[job.task_nb].nb = 0;
+        task[job.task_nb].c = c;
+        task[job.task_nb].first = n == 0;
+        for (k = 0; k < job.track_nb; k++) task[job.task_nb].disjoint[k] = disjoint[k];
+        job.task_nb++;
+      }
+      task[job.task_nb - 1].nb++;
+    }
+  }
+  job.task = task;
+  pthread_mutex_init(&job.mutex, NULL);
+
+  thread_nb = ga_thread_nb < job.task_nb ? ga_thread_nb : (int)job.task_nb;
+  if (thread_nb > 1) {
+    th = (pthread_t *)my_malloc(thread_nb * sizeof(pthread_t));
+    for (i = 0; i < thread_nb; i++) {
+      if (pthread_create(&th[i], NULL, count_worker, &job) != 0) {
+        LOG("error: thread cannot be created.");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (i = 0; i < thread_nb; i++) pthread_join(th[i], NULL);
+  } else {
+    count_worker (&job); //counting on this thread
+  }
+
+  pthread_mutex_destroy(&job.mutex);
+  MYFREE(th);
+  MYFREE(task);
+  for (k = 0; k < job.track_nb; k++) MYFREE(job.track[k].sig_idx);
+  return;
+}
+
+/*pointer which must be freed: job->track[].sig_idx */
+/*
+ * This adds a track to the counting job.
+ * arr_p: windows of summits on plus strand are written in it
+ * arr_m: windows of summits on minus strand are written in it
+ */
+static void count_track_add (struct count_job *job, struct chr_block *chr_block_headsig, float arr_p[], float arr_m[])
+{
+  struct count_track *tr = &job->track[job->track_nb++];
+
+  tr->sig_idx = ga_index_chr_block (chr_block_headsig); //sig addressed by chr ID
+  tr->arr_p = arr_p;
+  tr->arr_m = arr_m;
+}
+
+/*
+ * This is the thread function of ga_count_sig. It takes the next task until all tasks are counted.
+ * *arg: pointer to struct count_job
+ */
+static void *count_worker (void *arg)
+{
+  struct count_job *job = (struct count_job *)arg;
+  double *slide_sum; //window sums of a bs by ga_sig_slide
+  long i;
+
+  slide_sum = (double *)my_malloc(((2 * job->hw) / job->step + 1) * sizeof(double));
+  while (1) {
+    pthread_mutex_lock(&job->mutex);
+    i = job->next++;
+    pthread_mutex_unlock(&job->mutex);
+    if (i >= job->task_nb) break;
+
+    count_bs (job, &job->task[i], slide_sum);
+  }
+
+  MYFREE(slide_sum);
+  return NULL;
+}
+
+/*
+ * This finds the sig which the scan of a task starts from: the first sig which ends after the left most window of bs.
+ * Summits after bs are not on the left of bs, so the scan doesn't miss sig which overlaps their windows if sig don't overlap each other.
+ */
+static unsigned long count_cursor (const struct count_job *job, const struct chr_block *ch_sig, const struct bs *bs)
+{
+  unsigned long lo, hi, m;
+  long st = bs->st - job->hw - job->win / 2;
+
+  if (ch_sig == NULL || st < 0) return 0;
+  for (lo = 0, hi = ch_sig->sig_nb; lo < hi; ) {
+    m = (lo + hi) / 2;
+    if (SIG_ED(ch_sig, m) <= (unsigned long)st) lo = m + 1;
+    else hi = m;
+  }
+  return lo;
+}
+
+/*
+ * This counts sig of all tracks in windows of the summits of task t.
+ * Each track keeps its own j1_tmp, so the windows of a summit are filled for all tracks before the next summit.
+ * slide_sum[]: buffer of window sums of ga_sig_slide
+ */
+static void count_bs (const struct count_job *job, const struct count_task *t, double slide_sum[])
+{
+  const struct chr_block *ch[COUNT_TRACK_MAX];
+  const struct bs *bs = t->bs;
+  unsigned long j1_tmp[COUNT_TRACK_MAX]; //j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
+  int k, sl[COUNT_TRACK_MAX];
+  long n, c = t->c, st, ed;
+
+  for (k = 0; k < job->track_nb; k++) {
+    ch[k] = job->track[k].sig_idx[t->ch_smt->id];
+    if (k == 1 && job->anti && ch[0] == NULL) ch[k] = NULL; //if chr in smt is not included in plus strand sig, anti-sense reads are 0 as well.
+    j1_tmp[k] = t->first ? 0 : count_cursor (job, ch[k], bs);
+    sl[k] = job->slide && ch[k] && !SIG_DIRECT(ch[k]) && t->disjoint[k]; //overlapping sig are scanned
+  }
+
+  for (n = 0; n < t->nb; n++, bs = bs->next, c++) {
+    if (bs->strand == '-') {//if the summit is on minus strand
+      st = bs->ed - job->hw - job->win / 2; //start pos
+      ed = bs->ed - job->hw + job->win / 2; //end pos
+    } else {
+      st = bs->st - job->hw - job->win / 2; //start pos
+      ed = bs->st - job->hw + job->win / 2; //end pos
+    }
+    for (k = 0; k < job->track_nb; k++)
+      count_win (job, ch[k], bs, st, ed, &j1_tmp[k], sl[k], job->track[k].arr_p, job->track[k].arr_m, c, slide_sum);
+  }
+}
+
+/*
+ * This counts sig of ch_sig in the windows of bs, the first of which is st-ed, and writes them in column c.
+ * Summits on plus strand are written in arr_p, and summits on minus strand in arr_m with windows in reverse order.
+ * *ch_sig     : sig of the chr, or NULL. All windows are 0 if NULL.
+ * *j1_tmp     : index of sig which the scan starts from. It is moved by the summits on plus strand.
+ * sl          : 1 if window sums are calculated by ga_sig_slide
+ * slide_sum[] : buffer of window sums of ga_sig_slide
+ */
+static void count_win (const struct count_job *job, const struct chr_block *ch_sig, const struct bs *bs, long st, long ed, unsigned long *j1_tmp, const int sl, float arr_p[], float arr_m[], const long c, double slide_sum[])
+{
+  unsigned long j1; //j1 is the index of sig arrays of ch_sig which is counted in the window.
+  const long smtNb = job->smtNb;
+  const int step = job->step, win = job->win;
+  int i, fl = 0, winNb = (2 * job->hw) / step + 1;
+  long tmp_st, tmp_ed;
+  float val_tmp;
+  double sum;
+
+  if (ch_sig == NULL) { //if chr in smt is not included in sig...
+    for (i = 0; i < winNb; i++) { //assigning value 0.0 if chr in smt is not included in sig.
+      if (bs->strand == '-') arr_m[i * smtNb + c] = 0.0;
+      else arr_p[i * smtNb + c] = 0.0;
+    }
+    return;
+  }
+
+  if (sl) { //window sums by sliding window. j1_tmp is moved only by the bs on plus strand like the scan
+    j1 = *j1_tmp;
+    ga_sig_slide (ch_sig, bs->strand == '-' ? &j1 : j1_tmp, st, ed - st, step, winNb, slide_sum);
+    for (i = 0; i < winNb; i++) {
+      if (bs->strand == '-') arr_m[(winNb -1 - i) * smtNb + c] = (float)slide_sum[i] / (float)win;
+      else arr_p[i * smtNb + c] = (float)slide_sum[i] / (float)win;
+    }
+    return;
+  }
+
+  for (i = 0; i < winNb; i++) {
+    if (SIG_DIRECT(ch_sig)) { //window sum by prefix-sum index or dense sig blocks
+      ga_sig_sum (ch_sig, st, ed, &sum);
+      if (bs->strand == '-') arr_m[(winNb -1 - i) * smtNb + c] = (float)sum / (float)win;
+      else arr_p[i * smtNb + c] = (float)sum / (float)win;
+      st += step;
+      ed += step;
+      continue;
+    }
+    for (j1 = *j1_tmp; j1 < ch_sig->sig_nb; j1++) { //here's the slowest part...
+      if (st < SIG_ED(ch_sig, j1) && SIG_ST(ch_sig, j1) < ed) {
+        break; //if one of sig block is inside the win
+      } else if (SIG_ST(ch_sig, j1) >= ed) { //if there's no chance for j1 to overlap win
+        j1 = ch_sig->sig_nb;
+        break;
+      }
+    }
+
+    if (j1 == ch_sig->sig_nb) { //if the win is the right side of the most right sig block
+      if (bs->strand == '-') arr_m[(winNb -1 - i) * smtNb + c] = 0.0; //assigning value 0.0
+      else arr_p[i * smtNb + c] = 0.0; //assigning value 0.0
+      st += step;
+      ed += step;
+      continue;
+    }
+
+    if (!fl && bs->strand != '-') { //if j1_tmp is not set for the bs (fl == 0) and the strand is not minus.
+      *j1_tmp = j1;
+      fl = 1;
+    }
+
+    val_tmp = 0;
+    for (; j1 < ch_sig->sig_nb; j1++) {
+      if (SIG_ST(ch_sig, j1) >= ed) break; //if the sig pos is out of the win
+      if (st > SIG_ST(ch_sig, j1)) tmp_st = st; //if st of sig block is up-stream pos of st
+      else tmp_st = SIG_ST(ch_sig, j1);
+      if (SIG_ED(ch_sig, j1) > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
+      else tmp_ed = SIG_ED(ch_sig, j1);
+      val_tmp += SIG_VAL(ch_sig, j1) * (tmp_ed - tmp_st); //adding the val*len of sig block
+    }
+    if (bs->strand == '-') arr_m[(winNb -1 - i) * smtNb + c] = val_tmp / (float)win;
+    else arr_p[i * smtNb + c] = val_tmp / (float)win;
+    st += step;
+    ed += step;
+  }
+}
@@ -0,0 +1,8 @@
+#ifndef _GA_COUNT_H_
+#define _GA_COUNT_H_
+
+#include "parse_chr.h"
+
+void ga_count_sig (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_m, struct chr_block *chr_block_headsig_d, float arr[], float arr_a[], float arr_d[], const long smtNb, const int hw, const int step, const int win, const int slide);
+
+#endif
@@ -211,6 +211,7 @@ time:                            %s\n",\
   ga_free_chr_block_fa(&chr_block_head);
   ga_free_chr_block(&chr_block_head_gt);
   MYFREE(frag);
+  ga_free_chr_dict();
   return 0;
 
 err:
@@ -218,6 +219,7 @@ err:
   if (chr_block_head) ga_free_chr_block_fa(&chr_block_head);
   if (chr_block_head_gt) ga_free_chr_block(&chr_block_head_gt);
   MYFREE(frag);
+  ga_free_chr_dict();
   return -1;
 }
 
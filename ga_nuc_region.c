@@ -46,6 +46,7 @@ static char *rgn = NULL; //region file
 static char *fa = NULL; //fasta
 static char *gt = NULL; //genome table
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line with nucleotide composition
+static char ga_line_in[LINE_STR_LEN] = {0}; //input line made by ga_line
 static int col_chr = 0;
 static int col_st = 1;
 static int col_ed = 2;
@@ -81,6 +82,7 @@ int main (int argc, char *argv[])
   struct chr_block *chr_block_head_gt = NULL; //for parsing genome table
   struct chr_block_fa *chr_block_head_fa = NULL; //for parsing fasta
   struct chr_block_fa *ch2; //for
+  struct chr_block_fa **fa_idx = NULL; //fasta addressed by chr ID
   struct bs *bs; //for
   struct output *out_head; //output header
 
@@ -104,10 +106,9 @@ time:                            %s\n",\
 
   ga_parse_chr_bs (rgn, &chr_block_head_rgn, col_chr, col_st, col_ed, -1, hf); //parsing region file
   // sorting summit and sig
-  chr_block_head_rgn = ga_mergesort_chr(chr_block_head_rgn);
+  chr_block_head_rgn = ga_sort_chr_block_bs(chr_block_head_rgn);
 
   for (ch1 = chr_block_head_rgn; ch1; ch1 = ch1 -> next) {
-    ch1 -> bs_list = ga_mergesort_bs(ch1 -> bs_list);
     for (bs = ch1 -> bs_list; bs; bs = bs -> next) { //finding the max region length
       if (max_len < bs->ed - bs->st) max_len = bs->ed - bs->st;
     }
@@ -122,10 +123,9 @@ time:                            %s\n",\
   ga_parse_file_path (rgn, path, fn, ext); //parsing input file name into path, file name, and extension
 
   frag = (char *)my_malloc(sizeof(char) * (max_len + 2)); //fragment DNA from genome
+  fa_idx = ga_index_chr_block_fa (chr_block_head_fa);
   for (ch1 = chr_block_head_rgn; ch1; ch1 = ch1->next) {
-    for (ch2 = chr_block_head_fa; ch2; ch2 = ch2->next) {
-      if (!(strcmp(ch1->chr, ch2->chr))) break;
-    }
+    ch2 = fa_idx[ch1->id];
 
     if (ch2 == NULL) {
       printf("warning: chromosome %s was not found in the fasta file, skipped\n", ch1->chr);
@@ -156,7 +156,7 @@ time:                            %s\n",\
         i++;
       }
       sprintf(tmp, "%lu\t%lu\t%lu\t%lu\t%.3lf\n", c_A, c_T, c_C, c_G, (double)(c_A + c_T)/(double)(c_A + c_T + c_C + c_G));
-      if (add_one_val (ga_line_out, bs->line, tmp) != 0) {
+      if (add_one_val (ga_line_out, ga_line(ga_line_in, bs->line, bs->line_len), tmp) != 0) {
         LOG("error: error in add_one_val function.");
         goto err;
       }
@@ -180,6 +180,8 @@ time:                            %s\n",\
   ga_free_chr_block(&chr_block_head_rgn);
   ga_free_chr_block(&chr_block_head_gt);
   MYFREE (frag);
+  MYFREE (fa_idx);
+  ga_free_chr_dict();
   return 0;
 
 err:
@@ -188,6 +190,8 @@ err:
   if (chr_block_head_rgn) ga_free_chr_block(&chr_block_head_rgn);
   if (chr_block_head_gt) ga_free_chr_block(&chr_block_head_gt);
   MYFREE (frag);
+  MYFREE (fa_idx);
+  ga_free_chr_dict();
   return -1;
 }
 
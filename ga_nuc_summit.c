@@ -97,8 +97,9 @@ int main (int argc, char *argv[])
   struct chr_block *chr_block_head_gt = NULL; //for parsing genome table
   struct chr_block_fa *chr_block_head_fa = NULL; //for parsing fasta
   struct chr_block_fa *ch2; //for
+  struct chr_block_fa **fa_idx = NULL; //fasta addressed by chr ID
   struct bs *bs; //for
-  struct output *out_head; //output header
+  struct output *out_head = NULL; //output header
 
   unsigned long i, c_A, c_T, c_G, c_C; //count of ATCG
   long s; //start position of the window (can be negative if summit is close to position 0 and hw is too large...)
@@ -125,11 +126,7 @@ time:                            %s\n",\
  "ga_nuc_smt", fa, smt, gt, n_flag, hfs, col_chr, col_st, col_ed, col_strand, hw, step, win, ctime(&timer) );
 
   ga_parse_chr_bs (smt, &chr_block_head_smt, col_chr, col_st, col_ed, col_strand, hf); //parsing summit file
-  chr_block_head_smt = ga_mergesort_chr(chr_block_head_smt); // sorting summit chr
-
-  for (ch1 = chr_block_head_smt; ch1; ch1 = ch1 -> next) {
-    ch1 -> bs_list = ga_mergesort_bs(ch1 -> bs_list); //sorting bs
-  }
+  chr_block_head_smt = ga_sort_chr_block_bs(chr_block_head_smt); // sorting summit chr and bs
 
   ga_parse_chr_bs (gt, &chr_block_head_gt, 0, 1, 1, -1, 0); //parsing genome tible
   if (ga_parse_chr_fa(fa, &chr_block_head_fa, chr_block_head_gt) != 0){ //parsing fasta
@@ -141,10 +138,9 @@ time:                            %s\n",\
   frag = (char *)my_malloc(sizeof(char) * (win + 1)); //allocating memory for fragment DNA from genome
   winNb = (2 * hw) / step + 1; //window number
 
+  fa_idx = ga_index_chr_block_fa (chr_block_head_fa);
   for (ch1 = chr_block_head_smt; ch1; ch1 = ch1->next) {
-    for (ch2 = chr_block_head_fa; ch2; ch2 = ch2->next) {
-      if (!(strcmp(ch1->chr, ch2->chr))) break;
-    }
+    ch2 = fa_idx[ch1->id];
 
     if (ch2 == NULL) {
       printf("warning: chromosome %s was not found in the fasta file, skipped\n", ch1->chr);
@@ -253,6 +249,8 @@ time:                            %s\n",\
   ga_free_chr_block(&chr_block_head_smt);
   ga_free_chr_block(&chr_block_head_gt);
   MYFREE (frag);
+  MYFREE (fa_idx);
+  ga_free_chr_dict();
   return 0;
 
 err:
@@ -261,6 +259,8 @@ err:
   if (chr_block_head_smt) ga_free_chr_block(&chr_block_head_smt);
   if (chr_block_head_gt) ga_free_chr_block(&chr_block_head_gt);
   MYFREE (frag);
+  MYFREE (fa_idx);
+  ga_free_chr_dict();
   return -1;
 }
 
@@ -64,6 +64,7 @@ static int col_st1 = 1, col_st2 = 1;
 static int col_ed1 = 2, col_ed2 = 2;
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line with overlapping flag
+static char ga_line_in[LINE_STR_LEN] = {0}; //input line made by ga_line
 static char line2[LINE_STR_LEN] = {0}; //line for file2
 static double totnb = 0.0, ovnb = 0.0, novnb = 0.0; //peak numbers
 
@@ -97,6 +98,7 @@ int main (int argc, char *argv[])
   struct output *nonov_head = NULL; //for non-overlapping peaks
 
   struct chr_block *ch1, *ch2; //for "for loop of chr"
+  struct chr_block **chr_idx2 = NULL; //peak2 addressed by chr ID
   struct bs *bs_nonov; //for bs of file1 of which chr is not in file2
 
   /*path, filename, and extension*/
@@ -141,7 +143,7 @@ time:                            %s\n",\
   //making "tab" line for non-overlapping...
   if (p2) {
     bs_nonov = chr_block_head2 -> bs_list; //the very first line
-    while(bs_nonov -> line [i] != '\0'){
+    while(i < bs_nonov -> line_len){
       if (bs_nonov -> line [i] == '\t'){
         if (strlen(line2) + strlen("NA\t") + 1 < LINE_STR_LEN) strncat(line2, "NA\t", strlen("NA\t"));
       }
@@ -151,21 +153,19 @@ time:                            %s\n",\
   }
   //
 
+  chr_idx2 = ga_index_chr_block (chr_block_head2);
   for (ch1 = chr_block_head1; ch1; ch1 = ch1->next) {
-    for (ch2 = chr_block_head2; ch2; ch2 = ch2->next) {
-      if (!strcmp(ch1->chr, ch2->chr)) { //comparing peaks on the same chr
-        if(cmp_overlap (ch1->bs_list, ch2->bs_list, &output_head, &ov_head, &nonov_head) != 0){
-          LOG("error: error in cmp_overlap function.");
-          goto err;
-        }
-        break;
+    if ((ch2 = chr_idx2[ch1->id]) != NULL) { //comparing peaks on the same chr
+      if(cmp_overlap (ch1->bs_list, ch2->bs_list, &output_head, &ov_head, &nonov_head) != 0){
+        LOG("error: error in cmp_overlap function.");
+        goto err;
       }
     }
     if (ch2 == NULL) { //if chr_block2 doesn't have ch1
       for (bs_nonov = ch1->bs_list; bs_nonov; bs_nonov = bs_nonov->next) {
-        ga_output_add (&nonov_head, bs_nonov->line); //caution: the order is reversed 
+        ga_output_add (&nonov_head, ga_line(ga_line_in, bs_nonov->line, bs_nonov->line_len)); //caution: the order is reversed 
 
-        sprintf(ga_line_out, "%s", bs_nonov->line);
+        ga_line(ga_line_out, bs_nonov->line, bs_nonov->line_len);
         ga_line_out[strlen(ga_line_out) - 1] = '\t'; //\n was replaced by \t
 
         if (p2) {
@@ -249,6 +249,8 @@ time:                            %s\n",\
   ga_free_output(&output_head);
   ga_free_output(&ov_head);
   ga_free_output(&nonov_head);
+  MYFREE (chr_idx2);
+  ga_free_chr_dict();
 
   return 0;
 
@@ -261,6 +263,8 @@ err:
   if (output_head) ga_free_output(&output_head);
   if (ov_head) ga_free_output(&ov_head);
   if (nonov_head) ga_free_output(&nonov_head);
+  MYFREE (chr_idx2);
+  ga_free_chr_dict();
   return -1;
 }
 
@@ -292,16 +296,16 @@ static int cmp_overlap (struct bs *bs1, struct bs *bs2, struct output **output_h
     for (j = bs2; j; j = j->next) {
       if (ed1 >= j->st && st1 <= j->ed) { //checking the overlapping
         if (!c) { //ov_head is added only once
-          ga_output_add(ov_head, i->line); //caution: the order is reversed
+          ga_output_add(ov_head, ga_line(ga_line_in, i->line, i->line_len)); //caution: the order is reversed
           ovnb += 1.0; //overlapping peak number
         }
         c++;
         if(!cf) {
-          sprintf(ga_line_out, "%s", i->line);
+          ga_line(ga_line_out, i->line, i->line_len);
           ga_line_out[strlen(ga_line_out) - 1] = '\t'; //\n was replaced by \t
 
           if (p2) {
-            if (strlen(ga_line_out) + strlen(j->line) + 1 < LINE_STR_LEN) strncat(ga_line_out, j->line, strlen(j->line));
+            if (strlen(ga_line_out) + j->line_len + 1 < LINE_STR_LEN) strncat(ga_line_out, j->line, j->line_len);
             ga_line_out[strlen(ga_line_out) - 1] = '\t'; //\n was replaced by \t
           }
 
@@ -314,11 +318,11 @@ static int cmp_overlap (struct bs *bs1, struct bs *bs2, struct output **output_h
       } //if overlap
     } //for j
     if (cf && c) { //if at least one peak was overlapped for i
-      sprintf(ga_line_out, "%s", i->line);
+      ga_line(ga_line_out, i->line, i->line_len);
       ga_line_out[strlen(ga_line_out) - 1] = '\t';
 
       if (p2) {
-        if (strlen(ga_line_out) + strlen(j_tmp->line) + 1 < LINE_STR_LEN) strncat(ga_line_out, j_tmp->line, strlen(j_tmp->line));
+        if (strlen(ga_line_out) + j_tmp->line_len + 1 < LINE_STR_LEN) strncat(ga_line_out, j_tmp->line, j_tmp->line_len);
         ga_line_out[strlen(ga_line_out) - 1] = '\t';
       }
 
@@ -328,10 +332,10 @@ static int cmp_overlap (struct bs *bs1, struct bs *bs2, struct output **output_h
       ga_output_add(output_head, ga_line_out); //caution: the order is reversed
     } //if cf && c
     if (!c) { //if i is not overlapped with any bs2
-      ga_output_add(nonov_head, i->line); //caution: the order is reversed
+      ga_output_add(nonov_head, ga_line(ga_line_in, i->line, i->line_len)); //caution: the order is reversed
       novnb += 1.0; //non-overlapping peak number
 
-      sprintf(ga_line_out, "%s", i->line);
+      ga_line(ga_line_out, i->line, i->line_len);
       ga_line_out[strlen(ga_line_out) - 1] = '\t'; //\n was replaced by \t
 
       if (p2) {
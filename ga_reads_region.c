@@ -21,13 +21,15 @@
 
 //static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d, struct output **output_head, const int hw, const char *region_mode);
 static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d, struct output **output_head);
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb);
+static int smt_run (char *filesmt, struct chr_block **chr_block_headsmt, const char *header, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d);
 
 static void usage()
 {
   printf("Tool:    ga_reads_region\n\n\
 Summary: report the amount of reads inside regions\n\n\
-Usage:   ga_reads_region [options] --smt <summit file> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz> --mode smt --col_smt <int: column of summit>\n\
-   or:   ga_reads_region [options] --smt <region file> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz> --mode <region mode: region | up-tss | tss-dw | up-tss-dw | up-tes | tes-dw | up-tes-dw>\n\n\
+Usage:   ga_reads_region [options] --smt <summit file[,summit file...]> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig> --mode smt --col_smt <int: column of summit>\n\
+   or:   ga_reads_region [options] --smt <region file[,region file...]> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig> --mode <region mode: region | up-tss | tss-dw | up-tss-dw | up-tes | tes-dw | up-tes-dw>\n\n\
 Options:\n\
          -v: output version information and exit.\n\
          -h, --help: display this help and exit.\n\
@@ -39,7 +41,13 @@ Options:\n\
          --header: the header of summit file is preserved (default:off).\n\
          --norm_len: normalization by region length (default:off).\n\
          --sig_d: signal denominator file like input (default:NULL)\n\
-         --hw: <int> half range size (default:1000)\n");
+         With summit or region files separated by comma, the signal is loaded once and calculated against each of them, and the output of each file is written with its own header. Signal of any format is read only around the regions of all files.\n\
+         --hw: <int> half range size (default:1000)\n\
+         --threads: <int> number of threads for loading input files (default:4)\n\
+         --pipe_stat: print waiting time of reading and parsing threads for each input file (default:off)\n\
+         --sig_index: window sums are calculated from prefix-sum index of signal, so the time doesn't depend on window size. The last digit may differ by rounding (default:off)\n\
+         --compact: adjacent signal records with the same value are merged on loading, so the scan of signal is shorter. The last digit may differ by rounding (default:off)\n\
+         --sig_quant <none | half | int16>: signal values are stored in 16 bits to save memory. half keeps about 3 significant digits, and int16 keeps 1/32767 of the max value of each chr (default:none)\n");
   exit(0);
 }
 
@@ -52,6 +60,11 @@ static void version()
 
 static int hf = 0;
 static char hfs[4] = "off\0";
+static int sig_index = 0; //if 1, window sums are calculated by prefix-sum index
+static char sig_indexs[4] = "off\0";
+static int compact = 0; //if 1, adjacent sig with the same value are merged on loading
+static char compacts[4] = "off\0";
+static char *sig_quant = "none"; //none | half | int16
 static int nf = 0;
 static char nfs[4] = "off\0";
 static char *filesmt = NULL;
@@ -66,6 +79,7 @@ static int col_strand = -1;
 static int hw = 1000; //half window size
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line including relative pos, smt_mean, CI95.00percent_U, CI95.00percent_L, smtNb, Centered, Signal
+static char ga_line_in[LINE_STR_LEN] = {0}; //input line made by ga_line
 
 static const Argument args[] = {
   {"-h"           , ARGUMENT_TYPE_FUNCTION, usage        },
@@ -77,6 +91,11 @@ static const Argument args[] = {
   {"--sig"        , ARGUMENT_TYPE_STRING  , &filesig     },
   {"--sig_d"      , ARGUMENT_TYPE_STRING  , &filesig_d   },
   {"--sigfmt"     , ARGUMENT_TYPE_STRING  , &sigfmt      },
+  {"--threads"    , ARGUMENT_TYPE_INTEGER , &ga_thread_nb},
+  {"--pipe_stat"  , ARGUMENT_TYPE_FLAG_ON , &ga_pipe_stat},
+  {"--sig_index"  , ARGUMENT_TYPE_FLAG_ON , &sig_index   },
+  {"--compact"    , ARGUMENT_TYPE_FLAG_ON , &compact     },
+  {"--sig_quant"  , ARGUMENT_TYPE_STRING  , &sig_quant   },
   {"--mode"       , ARGUMENT_TYPE_STRING  , &region_mode },
   {"--col_chr"    , ARGUMENT_TYPE_INTEGER , &col_chr     },
   {"--col_start"  , ARGUMENT_TYPE_INTEGER , &col_st      },
@@ -93,28 +112,19 @@ int main (int argc, char *argv[])
   argument_read(&argc, argv, args);//reading arguments
   if (filesmt == NULL || filesig == NULL || sigfmt == NULL || region_mode == NULL) usage();
 
-  struct chr_block *chr_block_headsmt = NULL; //for summit
+  struct chr_block **smt_head = NULL; //for summit or region of each set
   struct chr_block *chr_block_headsig = NULL; //for signal
   struct chr_block *chr_block_headsig_d = NULL; //for signal of denominator
 
-  struct chr_block *ch; //for "for loop of chr"
-  struct output *output_head = NULL; //for output
-
-  /*path, filename, and extension*/
-  char path_smt[PATH_STR_LEN] = {0};
-  char fn_smt[FILE_STR_LEN] = {0};
-  char ext_smt[EXT_STR_LEN] = {0};
-  char path_sig[PATH_STR_LEN] = {0};
-  char fn_sig[FILE_STR_LEN] = {0};
-  char ext_sig[EXT_STR_LEN] = {0};
-  char path_sig_d[PATH_STR_LEN] = {0};
-  char fn_sig_d[FILE_STR_LEN] = {0};
-  char ext_sig_d[EXT_STR_LEN] = {0};
-  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
+  char **smt_list = NULL; //file names of the summits or regions
+  char **smt_header = NULL; //header line of each set, or NULL
+  int k, smt_nb = 0;
 
   time_t timer;
 
   if(hf) strcpy(hfs, "on\0");
+  if(sig_index) strcpy(sig_indexs, "on\0");
+  if(compact) strcpy(compacts, "on\0");
   if(nf) strcpy(nfs, "on\0");
   time(&timer);
   printf("Tool:                            %s\n\n\
@@ -122,6 +132,7 @@ Input file summit:               %s\n\
 Input file signal:               %s\n\
 Input file signal denominator:   %s\n\
 signal format:                   %s\n\
+threads:                         %d\n\
 region mode:                     %s\n\
 summit col of chr, start, end:   %d, %d, %d\n\
 summit col of summit:            %d\n\
@@ -129,58 +140,118 @@ summit col strand?:              %d\n\
 half range:                      %d\n\
 header flag:                     %s\n\
 norm by length flag:             %s\n\
+signal index:                    %s\n\
+signal compaction:               %s\n\
+signal quantization:             %s\n\
 time:                            %s\n",\
- "ga_reads_region", filesmt, filesig, filesig_d, sigfmt, region_mode, col_chr, col_st, col_ed, col_st, col_strand, hw, hfs, nfs, ctime(&timer) );
+ "ga_reads_region", filesmt, filesig, filesig_d, sigfmt, ga_thread_nb, region_mode, col_chr, col_st, col_ed, col_st, col_strand, hw, hfs, nfs, sig_indexs, compacts, sig_quant, ctime(&timer) );
 
-  ga_parse_file_path (filesmt, path_smt, fn_smt, ext_smt); //parsing input file name into path, file name, and extension
-  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig);
+  smt_nb = ga_file_list (filesmt, &smt_list); //summits or regions separated by comma
 
-  ga_parse_chr_bs(filesmt, &chr_block_headsmt, col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+  smt_head = (struct chr_block **)my_calloc(smt_nb, sizeof(struct chr_block *));
+  smt_header = (char **)my_calloc(smt_nb, sizeof(char *));
+  for (k = 0; k < smt_nb; k++) { //each file is parsed once, and is kept until it is counted
+    ga_parse_chr_bs(smt_list[k], &smt_head[k], col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+    smt_header[k] = ga_header_line; //the header of each set is written in its output
+    ga_header_line = NULL;
+  }
 
   // reading signal file
-  if (!strcmp(sigfmt, "bedgraph")) {
-    ga_parse_bedgraph (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "sepwiggz")) {
-    ga_parse_sepwiggz (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "onewiggz")) {
-    ga_parse_onewiggz (filesig, &chr_block_headsig);
-  } else {
-    LOG("error: invalid signal file format.");
-    goto err;
+  if (sig_load (filesig, &chr_block_headsig, smt_head, smt_nb) != 0) goto err;
+  if (filesig_d) {//if denominator
+    if (sig_load (filesig_d, &chr_block_headsig_d, smt_head, smt_nb) != 0) goto err;
   }
 
-  // sorting summit and sig
-  chr_block_headsmt = ga_mergesort_chr(chr_block_headsmt);
-  chr_block_headsig = ga_mergesort_chr(chr_block_headsig);
+  for (k = 0; k < smt_nb; k++) { //the loaded signal is counted against all region sets
+    if (smt_nb > 1) printf("summit %d/%d: %s\n", k + 1, smt_nb, smt_list[k]);
+    if (smt_run (smt_list[k], &smt_head[k], smt_header[k], chr_block_headsig, chr_block_headsig_d) != 0) goto err;
+  }
 
-  for (ch = chr_block_headsmt; ch; ch = ch -> next) {
-    ch -> bs_list = ga_mergesort_bs(ch -> bs_list);
+  for (k = 0; k < smt_nb; k++) MYFREE (smt_header[k]);
+  MYFREE (smt_header);
+  MYFREE (smt_head);
+  MYFREE (smt_list);
+  MYFREE (ga_header_line);
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  ga_free_chr_dict();
+
+  return 0;
+
+err:
+  for (k = 0; smt_head && k < smt_nb; k++) {
+    if (smt_head[k]) ga_free_chr_block(&smt_head[k]);
+    MYFREE (smt_header[k]);
   }
-  for (ch = chr_block_headsig; ch; ch = ch -> next) {
-    ch -> sig_list = ga_mergesort_sig(ch -> sig_list);
+  MYFREE (smt_header);
+  MYFREE (smt_head);
+  MYFREE (smt_list);
+  MYFREE (ga_header_line);
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  ga_free_chr_dict();
+  return -1;
+}
+
+/*
+ * This loads signal file: parsing, sorting, and compaction, quantization and index if they are on.
+ * *filesig       : signal file
+ * **chr_block_head: pointer of pointer to struct chr_block
+ *region_head[] : summits or regions of each set. They are passed to the parser of every format (bedgraph, sepwiggz, onewiggz, sigbin, sigshm, bigwig), so signal out of bs +- 2 * hw is dropped on parsing
+ * region_nb      : number of the sets
+ * This returns 0 if the signal is loaded, otherwise -1.
+ */
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb)
+{
+  if (ga_parse_sig_regions (filesig, sigfmt, chr_block_head, region_head, region_nb, 2 * hw, 0) != 0) { //regions of all modes (smt, region, up-tss, ...) lie within 2 * hw of bs
+    LOG("error: error in ga_parse_sig_regions function.");
+    return -1;
   }
 
-  if (filesig_d) {//if denominator
-    ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
-
-    if (!strcmp(sigfmt, "bedgraph")) {
-      ga_parse_bedgraph (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "sepwiggz")) {
-      ga_parse_sepwiggz (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "onewiggz")) {
-      ga_parse_onewiggz (filesig_d, &chr_block_headsig_d);
-    } else {
-      LOG("error: invalid signal file format.");
-      goto err;
-    }
+  *chr_block_head = ga_sort_chr_block_sig(*chr_block_head); //sorting chr and sig
 
-    chr_block_headsig_d = ga_mergesort_chr(chr_block_headsig_d); //sorting chr of sig
-    for (ch = chr_block_headsig_d; ch; ch = ch -> next) {
-      ch -> sig_list = ga_mergesort_sig(ch -> sig_list); //sorting sig
-    }
+  if (compact) ga_compact_sig (*chr_block_head, 0);
+  if (ga_quantize_sig (*chr_block_head, sig_quant) != 0) {
+    LOG("error: error in ga_quantize_sig function.");
+    return -1;
   }
+  if (sig_index) ga_index_sig (*chr_block_head);
+  return 0;
+}
+
+/*
+ * This calculates the signal inside the regions of one summit or region set, and writes the output file.
+ * *filesmt           : summit or region file
+ * **chr_block_headsmt: summits parsed from filesmt. They are freed before return.
+ * *header            : header line of filesmt, or NULL
+ * *chr_block_headsig : loaded signal
+ * *chr_block_headsig_d: loaded signal denominator, or NULL
+ * This returns 0 if the output is written, otherwise -1.
+ */
+static int smt_run (char *filesmt, struct chr_block **chr_block_headsmt, const char *header, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d)
+{
+  struct output *output_head = NULL; //for output
+
+  /*path, filename, and extension*/
+  char path_smt[PATH_STR_LEN] = {0};
+  char fn_smt[FILE_STR_LEN] = {0};
+  char ext_smt[EXT_STR_LEN] = {0};
+  char path_sig[PATH_STR_LEN] = {0};
+  char fn_sig[FILE_STR_LEN] = {0};
+  char ext_sig[EXT_STR_LEN] = {0};
+  char path_sig_d[PATH_STR_LEN] = {0};
+  char fn_sig_d[FILE_STR_LEN] = {0};
+  char ext_sig_d[EXT_STR_LEN] = {0};
+  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
 
-  if (sig_count (chr_block_headsmt, chr_block_headsig, chr_block_headsig_d, &output_head) != 0) {
+  ga_parse_file_path (filesmt, path_smt, fn_smt, ext_smt); //parsing input file name into path, file name, and extension
+  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig);
+  if (!strcmp(sigfmt, "sigshm")) path_sig[0] = '\0'; //signal store has no directory, so the output is written in the current directory
+  if (filesig_d) ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
+
+  *chr_block_headsmt = ga_sort_chr_block_bs(*chr_block_headsmt); //sorting summit
+
+  if (sig_count (*chr_block_headsmt, chr_block_headsig, chr_block_headsig_d, &output_head) != 0) {
     LOG("error: in sig_count function.");
     goto err;
   }
@@ -193,31 +264,27 @@ time:                            %s\n",\
     else sprintf(output_name, "%s%s_around_%s_halfwid%d_mode_%s.txt", path_sig, fn_sig, fn_smt, hw, region_mode);
   }
 
-  if (ga_header_line != NULL) { //if header line
-    if (add_one_val(ga_line_out, ga_header_line, "signal_region\n") < 0) {
+  if (header != NULL) { //if header line
+    if (add_one_val(ga_line_out, header, "signal_region\n") < 0) {
       LOG("error: output line was too long.");
       goto err; //adding one extra column
     }
-    ga_write_lines (output_name, output_head, ga_line_out); //note that header is line_out, not ga_header_line
+    ga_write_lines (output_name, output_head, ga_line_out); //note that header is line_out, not header
   }
-  else ga_write_lines (output_name, output_head, ga_header_line);
+  else ga_write_lines (output_name, output_head, NULL);
 
   goto rtfree;
 
 rtfree:
-  MYFREE (ga_header_line);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (*chr_block_headsmt) ga_free_chr_block(chr_block_headsmt);
+  *chr_block_headsmt = NULL;
   if (output_head) ga_free_output(&output_head);
 
   return 0;
 
 err:
-  MYFREE (ga_header_line);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (*chr_block_headsmt) ga_free_chr_block(chr_block_headsmt);
+  *chr_block_headsmt = NULL;
   if (output_head) ga_free_output(&output_head);
   return -1;
 }
@@ -225,41 +292,39 @@ err:
 //static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d, struct output **output_head, const int hw, const char *region_mode)
 static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d, struct output **output_head)
 {
-  struct chr_block *ch_smt, *ch_sig, *ch_sig_d = NULL;
+  struct chr_block *ch_smt, *ch_sig, *ch_sig_d = NULL, **sig_idx, **sig_idx_d = NULL;
   struct bs *bs;
-  struct sig *j1, *j1_tmp = NULL, *j1_d, *j1_tmp_d = NULL; //j1 is the pointer to chr_block_headsig which is counted in the window. j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
-  int fl, fl_d;
+  unsigned long j1 = 0, j1_tmp = 0, j1_d = 0, j1_tmp_d = 0; //j1 is the index of sig arrays of chr_block_headsig which is counted in the window. j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
+  int fl, fl_d, ov; //ov is 1 if one of sig overlaps the region
   long st, ed, tmp_st, tmp_ed;
   float val_tmp, val_tmp_d;
+  double sum;
   char tmp[64] = {0}, tag[10] = {0};
 
+  sig_idx = ga_index_chr_block (chr_block_headsig); //sig addressed by chr ID
+  if (chr_block_headsig_d) sig_idx_d = ga_index_chr_block (chr_block_headsig_d);
+
   for (ch_smt = chr_block_headsmt; ch_smt; ch_smt = ch_smt->next) {
-    for (ch_sig = chr_block_headsig; ch_sig; ch_sig = ch_sig->next) {
-      if (!strcmp(ch_smt->chr, ch_sig->chr)) break; //if the same chr is included in smt and sig
-    }
-    if (chr_block_headsig_d) {
-      for (ch_sig_d = chr_block_headsig_d; ch_sig_d; ch_sig_d = ch_sig_d->next) {
-        if (!strcmp(ch_smt->chr, ch_sig_d->chr)) break; //if the same chr is included in smt and sig
-      }
-    }
+    ch_sig = sig_idx[ch_smt->id]; //if the same chr is included in smt and sig
+    if (chr_block_headsig_d) ch_sig_d = sig_idx_d[ch_smt->id];
 
     if (ch_sig == NULL) { //if chr in smt is not included in sig...
       for (bs = ch_smt->bs_list; bs; bs = bs->next) {
         sprintf(tmp, "%f\n", 0.0);
-        if (add_one_val(ga_line_out, bs->line, tmp) != 0){
+        if (add_one_val(ga_line_out, ga_line(ga_line_in, bs->line, bs->line_len), tmp) != 0){
           LOG("error: output line was too long.");
-          return -1;
+          goto err;
         }
         ga_output_append (output_head, ga_line_out);
       }
       continue;
     } else if (chr_block_headsig_d && ch_sig_d == NULL) {
       printf("error: %s is not found in signal denominator.\n", ch_smt->chr);
-      return -1;
+      goto err;
     }
 
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
-    j1_tmp_d = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
+    j1_tmp = 0; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
+    j1_tmp_d = 0; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
     for (bs = ch_smt->bs_list; bs; bs = bs->next) {
       fl = 0; //init of flag
       fl_d = 0; //init of flag
@@ -328,26 +393,28 @@ static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr
         sprintf(tag, "tes"); //tag
       } else {
         printf("error: input correct region_mode. Your mode: %s\n", region_mode);
-        return -1;
+        goto err;
       }
 
-      if (j1_tmp == NULL) j1 = ch_sig->sig_list;
-      else j1 = j1_tmp;
-
-      for (; j1; j1=j1->next) { //here's the slowest part...
-        if (st < j1->ed && j1->st < ed) {
-          break; //if one of sig block is inside the win
-        } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-          j1 = NULL;
-          break;
+      if (SIG_DIRECT(ch_sig)) { //sum by prefix-sum index or dense sig blocks
+        ov = ga_sig_sum (ch_sig, st, ed, &sum);
+      } else {
+        for (j1 = j1_tmp; j1 < ch_sig->sig_nb; j1++) { //here's the slowest part...
+          if (st < SIG_ED(ch_sig, j1) && SIG_ST(ch_sig, j1) < ed) {
+            break; //if one of sig block is inside the win
+          } else if (SIG_ST(ch_sig, j1) >= ed) { //if there's no chance for j1 to overlap win
+            j1 = ch_sig->sig_nb;
+            break;
+          }
         }
+        ov = j1 < ch_sig->sig_nb;
       }
 
-      if (j1 == NULL) { //if the win is the right side of the most right sig block
+      if (!ov) { //if the win is the right side of the most right sig block
         sprintf(tmp, "%f\n", 0.0);
-        if (add_one_val(ga_line_out, bs->line, tmp) != 0){
+        if (add_one_val(ga_line_out, ga_line(ga_line_in, bs->line, bs->line_len), tmp) != 0){
           LOG("error: output line was too long.");
-          return -1; //making output link list with NA
+          goto err; //making output link list with NA
         }
         ga_output_append (output_head, ga_line_out);
         continue;
@@ -362,33 +429,36 @@ static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr
       }
       
       val_tmp = 0.0;
-      for (;j1 ; j1 = j1->next) {
-        if (j1->st >= ed) break; //if the sig pos is out of the win
-        if (st > j1->st) tmp_st = st; //if st of sig block is up-stream pos of st
-        else tmp_st = j1->st;
-        if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-        else tmp_ed = j1->ed;
-        val_tmp += (j1->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
+      if (SIG_DIRECT(ch_sig)) val_tmp = sum;
+      else for (; j1 < ch_sig->sig_nb; j1++) {
+        if (SIG_ST(ch_sig, j1) >= ed) break; //if the sig pos is out of the win
+        if (st > SIG_ST(ch_sig, j1)) tmp_st = st; //if st of sig block is up-stream pos of st
+        else tmp_st = SIG_ST(ch_sig, j1);
+        if (SIG_ED(ch_sig, j1) > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
+        else tmp_ed = SIG_ED(ch_sig, j1);
+        val_tmp += SIG_VAL(ch_sig, j1) * (tmp_ed - tmp_st); //adding the val*len of sig block
       }
 
       if (chr_block_headsig_d) { //signal for denominator
-        if (j1_tmp_d == NULL) j1_d = ch_sig_d->sig_list;
-        else j1_d = j1_tmp_d;
-
-        for (; j1_d; j1_d = j1_d->next) { //here's the slowest part...
-          if (st < j1_d->ed && j1_d->st < ed) {
-            break; //if one of sig block is inside the win
-          } else if (j1_d->st >= ed) { //if there's no chance for j1 to overlap win
-            j1_d = NULL;
-            break;
+        if (SIG_DIRECT(ch_sig_d)) { //sum by prefix-sum index or dense sig blocks
+          ov = ga_sig_sum (ch_sig_d, st, ed, &sum);
+        } else {
+          for (j1_d = j1_tmp_d; j1_d < ch_sig_d->sig_nb; j1_d++) { //here's the slowest part...
+            if (st < SIG_ED(ch_sig_d, j1_d) && SIG_ST(ch_sig_d, j1_d) < ed) {
+              break; //if one of sig block is inside the win
+            } else if (SIG_ST(ch_sig_d, j1_d) >= ed) { //if there's no chance for j1 to overlap win
+              j1_d = ch_sig_d->sig_nb;
+              break;
+            }
           }
+          ov = j1_d < ch_sig_d->sig_nb;
         }
 
-        if (j1_d == NULL) { //if the win is the right side of the most right sig block
+        if (!ov) { //if the win is the right side of the most right sig block
           printf("warning: signal denominator for region %lu-%lu on %s is zero. NA is returned.\n", st, ed, ch_smt->chr);
-          if (add_one_val(ga_line_out, bs->line, "NA\n") != 0){
+          if (add_one_val(ga_line_out, ga_line(ga_line_in, bs->line, bs->line_len), "NA\n") != 0){
             LOG("error: output line was too long.");
-            return -1; //making output link list with NA
+            goto err; //making output link list with NA
           }
           ga_output_append (output_head, ga_line_out);
           continue;
@@ -403,13 +473,14 @@ static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr
         }
         
         val_tmp_d = 0.0;
-        for (;j1_d ; j1_d = j1_d->next) {
-          if (j1_d->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1_d->st) tmp_st = st; //if st of sig block is up-stream pos of st
-          else tmp_st = j1_d->st;
-          if (j1_d->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-          else tmp_ed = j1_d->ed;
-          val_tmp_d += (j1_d->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
+        if (SIG_DIRECT(ch_sig_d)) val_tmp_d = sum;
+        else for (; j1_d < ch_sig_d->sig_nb; j1_d++) {
+          if (SIG_ST(ch_sig_d, j1_d) >= ed) break; //if the sig pos is out of the win
+          if (st > SIG_ST(ch_sig_d, j1_d)) tmp_st = st; //if st of sig block is up-stream pos of st
+          else tmp_st = SIG_ST(ch_sig_d, j1_d);
+          if (SIG_ED(ch_sig_d, j1_d) > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
+          else tmp_ed = SIG_ED(ch_sig_d, j1_d);
+          val_tmp_d += SIG_VAL(ch_sig_d, j1_d) * (tmp_ed - tmp_st); //adding the val*len of sig block
         }
       }
 
@@ -427,13 +498,20 @@ static int sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr
         else sprintf(tmp, "%.3f\n", val_tmp );
       }
 
-      if (add_one_val(ga_line_out, bs->line, tmp) != 0){
+      if (add_one_val(ga_line_out, ga_line(ga_line_in, bs->line, bs->line_len), tmp) != 0){
         LOG("error: output line was too long.");
-        return -1; //making output link list with NA
+        goto err; //making output link list with NA
       }
       ga_output_append (output_head, ga_line_out);
     } //bs
   } //chr
 
+  MYFREE(sig_idx);
+  MYFREE(sig_idx_d);
   return 0;
+
+err:
+  MYFREE(sig_idx);
+  MYFREE(sig_idx_d);
+  return -1;
 }
@@ -9,6 +9,7 @@
 #include "sort_list.h"
 #include "argument.h"
 #include "ga_math.h"
+#include "ga_count.h"
 #include "ga_my.h"
 
 #include <stdio.h>
@@ -20,16 +21,30 @@
   "%s:line%d:%s(): " m "\n", \
   __FILE__, __LINE__, __FUNCTION__)
 
+/*
+ * Structure of summit set.
+ * One summit file, which is parsed and sorted once and counted against each signal.
+ */
+struct smt_set {
+  struct chr_block *head;
+  long nb; //number of summits
+  char path[PATH_STR_LEN];
+  char fn[FILE_STR_LEN];
+};
+
 //static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb, const int hw, const int step, const int win);
 //static void sig_count_anti (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig_p, struct chr_block *chr_block_headsig_m, float arr[], float arr_a[], const long smtNb, const int hw, const int step, const int win);
-static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb);
-static void sig_count_anti (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig_p, struct chr_block *chr_block_headsig_m, float arr[], float arr_a[], const long smtNb);
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct smt_set smt[], const int smt_nb);
+static int long_add (struct output **output_long, struct output *output_head, const char *profile);
+static void smt_free (struct smt_set smt[], const int smt_nb);
+static int sig_run (struct smt_set smt[], const int smt_nb, struct chr_block *chr_block_headg, char *filesig, const char *filesig_m, char *filesig_d, struct chr_block *chr_block_headsig_d_in, struct output **output_long);
+static int smt_run (struct smt_set *smt, struct chr_block *chr_block_headg, char *filesig, const char *filesig_m, char *filesig_d, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_m, struct chr_block *chr_block_headsig_d, struct output **output_long);
 
 static void usage()
 {
   printf("Tool:    ga_reads_summit\n\n\
 Summary: report the average distribution of signals around summits\n\n\
-Usage:   ga_reads_summit [options] --smt <summit file> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz>\n\n\
+Usage:   ga_reads_summit [options] --smt <summit file[,summit file...]> --sig <signal file[,signal file...]> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig>\n\n\
 Options:\n\
          -v: output version information and exit.\n\
          -h, --help: display this help and exit.\n\
@@ -41,10 +56,19 @@ Options:\n\
          --gt: genome table file (default:NULL)\n\
          --sig_minus: signal file from minus strand. With this argument, the program calculates not only sense reads, but also anti-sense reads. (default:NULL)\n\
          --sig_d: signal denominator file like input (default:NULL)\n\
+         With signal files separated by comma, all of them are calculated against the summits loaded once, and signals_around_<summit>_*.txt, a long format table of all of them, is written in addition. Signals are loaded one by one. --sig_minus needs the same number of files, and --sig_d one file for all or the same number.\n\
+         With summit files separated by comma, each signal is loaded once and calculated against all of them, and signals_around_summits_*.txt, a long format table of all signals and summits, is written in the directory of the first summit file. Signal of any format is read only around the summits of all files.\n\
          --hw: <int> half range size (default:1000)\n\
          --step: <int> step size (default: 10)\n\
          --win: <int> window size (default:25)\n\
-         --rand: <int> random simulation number. If more than 0, the simulation is performed. (default:0)\n");
+         --rand: <int> random simulation number. If more than 0, the simulation is performed. (default:0)\n\
+         --threads: <int> number of threads for loading input files and counting signal. The result is the same whatever the number is (default:4)\n\
+         --pipe_stat: print waiting time of reading and parsing threads for each input file (default:off)\n\
+         --sig_index: window sums are calculated from prefix-sum index of signal, so the time doesn't depend on window size. The last digit may differ by rounding (default:off)\n\
+         --slide: window sums are calculated by sliding the window along signal, adding the entering span and subtracting the leaving span, so signal is walked once per summit. Signal which overlaps each other is scanned as before. The last digit may differ by rounding (default:off)\n\
+         --compact: adjacent signal records with the same value are merged and records with value 0 are removed on loading, so the scan of signal is shorter. The last digit may differ by rounding (default:off)\n\
+         --sig_quant <none | half | int16>: signal values are stored in 16 bits to save memory. half keeps about 3 significant digits, and int16 keeps 1/32767 of the max value of each chr (default:none)\n\
+         --zoom: windows are calculated from zoom level summaries of bigWig if win is much larger than the zoom level (default:off)\n");
   exit(0);
 }
 
@@ -57,6 +81,13 @@ static void version()
 
 static int hf = 0;
 static char hfs[4] = "off\0";
+static int sig_index = 0; //if 1, window sums are calculated by prefix-sum index
+static char sig_indexs[4] = "off\0";
+static int slide = 0; //if 1, window sums are calculated by sliding window
+static char slides[4] = "off\0";
+static int compact = 0; //if 1, adjacent sig with the same value are merged on loading
+static char compacts[4] = "off\0";
+static char *sig_quant = "none"; //none | half | int16
 static char *filesmt = NULL;
 static char *filesig = NULL;
 static char *filesig_d = NULL;
@@ -71,6 +102,8 @@ static int hw = 1000; //half window size
 static int step = 10; //step size
 static int win = 25; //window size
 static int randnb = 0;
+static int zoom = 0; //if 1, bigWig zoom level is used
+static char zooms[4] = "off\0";
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line including relative pos, smt_mean, CI95.00percent_U, CI95.00percent_L, smtNb, Centered, Signal
 
@@ -93,6 +126,13 @@ static const Argument args[] = {
   {"--step"       , ARGUMENT_TYPE_INTEGER , &step        },
   {"--win"        , ARGUMENT_TYPE_INTEGER , &win         },
   {"--rand"       , ARGUMENT_TYPE_INTEGER , &randnb      },
+  {"--threads"    , ARGUMENT_TYPE_INTEGER , &ga_thread_nb},
+  {"--pipe_stat"  , ARGUMENT_TYPE_FLAG_ON , &ga_pipe_stat},
+  {"--zoom"       , ARGUMENT_TYPE_FLAG_ON , &zoom        },
+  {"--sig_index"  , ARGUMENT_TYPE_FLAG_ON , &sig_index   },
+  {"--slide"      , ARGUMENT_TYPE_FLAG_ON , &slide       },
+  {"--compact"    , ARGUMENT_TYPE_FLAG_ON , &compact     },
+  {"--sig_quant"  , ARGUMENT_TYPE_STRING  , &sig_quant   },
   {NULL           , ARGUMENT_TYPE_NONE    , NULL         },
 };
 
@@ -102,41 +142,25 @@ int main (int argc, char *argv[])
   argument_read(&argc, argv, args);//reading arguments
   if (filesmt == NULL || filesig == NULL || sigfmt == NULL) usage();
 
-  struct chr_block *chr_block_headsmt = NULL; //for summit
-  struct chr_block *chr_block_headsig = NULL; //for signal
-  struct chr_block *chr_block_headsig_m = NULL; //for signal
-  struct chr_block *chr_block_headsig_d = NULL; //for signal of denominator
-  struct chr_block *chr_block_headr = NULL; //for random simulation
+  struct chr_block *chr_block_headsig_d = NULL; //for signal of denominator shared by all signals
   struct chr_block *chr_block_headg = NULL; //for genome table
+  struct output *output_long = NULL; //for combined output of all signals and summit sets
+  struct smt_set *smt = NULL; //summit sets
 
-  struct chr_block *ch; //for "for loop of chr"
-  struct output *output_head = NULL; //for output
-  struct output *output_headr = NULL; //for output
-  struct output *output_head_a = NULL; //for output
-  struct output *output_headr_a = NULL; //for output
-
-  int rel, i, r;
-  float t, t2, mu_x, mu_y, ustd_y, var_x, var_y, var_xy;
-  float *arr=NULL, *arr_tmp=NULL, *arr_d=NULL, *arr_tmp_d=NULL, *arr_a, *arr_tmp_a;
-  float *arr_r=NULL, *arr_r_tmp=NULL, *arr_r_d=NULL, *arr_r_d_tmp=NULL, *arr_r_a=NULL, *arr_r_a_tmp=NULL;
-
-  long smtNb, c;
+  char **smt_list = NULL, **sig_list = NULL, **sig_m_list = NULL, **sig_d_list = NULL; //file names of the summits and signals
+  int k, smt_nb = 0, sig_nb, sig_m_nb = 0, sig_d_nb = 0;
 
   /*path, filename, and extension*/
-  char path_smt[PATH_STR_LEN] = {0};
-  char fn_smt[FILE_STR_LEN] = {0};
   char ext_smt[EXT_STR_LEN] = {0};
-  char path_sig[PATH_STR_LEN] = {0};
-  char fn_sig[FILE_STR_LEN] = {0};
-  char ext_sig[EXT_STR_LEN] = {0};
-  char path_sig_d[PATH_STR_LEN] = {0};
-  char fn_sig_d[FILE_STR_LEN] = {0};
-  char ext_sig_d[EXT_STR_LEN] = {0};
   char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
 
   time_t timer;
 
   if(hf) strcpy(hfs, "on\0");
+  if(sig_index) strcpy(sig_indexs, "on\0");
+  if(slide) strcpy(slides, "on\0");
+  if(compact) strcpy(compacts, "on\0");
+  if(zoom) strcpy(zooms, "on\0");
   time(&timer);
   printf("Tool:                            %s\n\n\
 Input file summit:               %s\n\
@@ -144,6 +168,7 @@ Input file signal:               %s\n\
 Input file signal denominator:   %s\n\
 Input file signal minus:         %s\n\
 signal format:                   %s\n\
+threads:                         %d\n\
 Genome file:                     %s\n\
 summit col of chr, start, end:   %d, %d, %d\n\
 summit col strand?:              %d\n\
@@ -152,41 +177,232 @@ step size:                       %d\n\
 win size:                        %d\n\
 header flag:                     %s\n\
 random simulation?:              %d\n\
+bigWig zoom:                     %s\n\
+signal index:                    %s\n\
+sliding window:                  %s\n\
+signal compaction:               %s\n\
+signal quantization:             %s\n\
 time:                            %s\n",\
- "ga_reads_summit", filesmt, filesig, filesig_d, filesig_m, sigfmt, filegenome, col_chr, col_st, col_ed, col_strand, hw, step, win, hfs, randnb, ctime(&timer) );
+ "ga_reads_summit", filesmt, filesig, filesig_d, filesig_m, sigfmt, ga_thread_nb, filegenome, col_chr, col_st, col_ed, col_strand, hw, step, win, hfs, randnb, zooms, sig_indexs, slides, compacts, sig_quant, ctime(&timer) );
+
+  smt_nb = ga_file_list (filesmt, &smt_list); //summits separated by comma
+  sig_nb = ga_file_list (filesig, &sig_list); //signals separated by comma
+  if (filesig_m) sig_m_nb = ga_file_list (filesig_m, &sig_m_list);
+  if (filesig_d) sig_d_nb = ga_file_list (filesig_d, &sig_d_list);
+  if ((sig_m_nb && sig_m_nb != sig_nb) || (sig_d_nb > 1 && sig_d_nb != sig_nb)) {
+    LOG("error: the number of signal minus files must be that of signal files, and the number of signal denominator files must be 1 or that of signal files.");
+    goto err;
+  }
 
-  ga_parse_file_path (filesmt, path_smt, fn_smt, ext_smt); //parsing input file name into path, file name, and extension
-  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig);
-  if(filesig_d) ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
+  smt = (struct smt_set *)my_calloc(smt_nb, sizeof(struct smt_set));
+  for (k = 0; k < smt_nb; k++) { //summit sets are kept during the run, and each signal is counted against all of them
+    ga_parse_file_path (smt_list[k], smt[k].path, smt[k].fn, ext_smt); //parsing input file name into path, file name, and extension
 
-  ga_parse_chr_bs(filesmt, &chr_block_headsmt, col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+    ga_parse_chr_bs(smt_list[k], &smt[k].head, col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+    smt[k].head = ga_sort_chr_block_bs(smt[k].head); //sorting summit
 
-  // reading signal file
-  if (!strcmp(sigfmt, "bedgraph")) {
-    ga_parse_bedgraph (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "sepwiggz")) {
-    ga_parse_sepwiggz (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "onewiggz")) {
-    ga_parse_onewiggz (filesig, &chr_block_headsig);
-  } else {
-    LOG("error: invalid signal file format.");
-    goto err;
+    smt[k].nb = ga_count_peaks (smt[k].head); //counting smt number
+    if (smt_nb > 1) printf("summit %d/%d: %s\n", k + 1, smt_nb, smt_list[k]);
+    printf("smtnb:%ld\n", smt[k].nb);
   }
 
-  // sorting summit and sig
-  chr_block_headsmt = ga_mergesort_chr(chr_block_headsmt);
-  chr_block_headsig = ga_mergesort_chr(chr_block_headsig);
+  if (randnb) ga_parse_chr_bs(filegenome, &chr_block_headg, 0, 1, 1, -1, 0); //reading genome table for the random simulation
 
-  for (ch = chr_block_headsmt; ch; ch = ch -> next) {
-    ch -> bs_list = ga_mergesort_bs(ch -> bs_list);
+  if (sig_nb > 1 && sig_d_nb == 1) { //one denominator for all signals is loaded once
+    if (sig_load (sig_d_list[0], &chr_block_headsig_d, smt, randnb ? 0 : smt_nb) != 0) goto err;
   }
-  for (ch = chr_block_headsig; ch; ch = ch -> next) {
-    ch -> sig_list = ga_mergesort_sig(ch -> sig_list);
+
+  for (k = 0; k < sig_nb; k++) { //signals are loaded one by one, so only one signal is in memory at a time
+    if (sig_nb > 1) printf("signal %d/%d: %s\n", k + 1, sig_nb, sig_list[k]);
+    if (sig_run (smt, smt_nb, chr_block_headg, sig_list[k], sig_m_nb ? sig_m_list[k] : NULL, sig_d_nb ? sig_d_list[sig_d_nb > 1 ? k : 0] : NULL,
+         chr_block_headsig_d, (sig_nb > 1 || smt_nb > 1) ? &output_long : NULL) != 0) goto err;
   }
 
+  if (sig_nb > 1 || smt_nb > 1) { //combined long format table of all signals and summit sets
+    sprintf(output_name, "%ssignals_around_%s_halfwid%dwinsize%dstep%d.txt", smt[0].path, smt_nb > 1 ? "summits" : smt[0].fn, hw, win, step);
+    ga_write_lines (output_name, output_long, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\tProfile\n");
+  }
+
+  smt_free (smt, smt_nb);
+  MYFREE(smt_list);
+  MYFREE(sig_list);
+  MYFREE(sig_m_list);
+  MYFREE(sig_d_list);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (chr_block_headg) ga_free_chr_block(&chr_block_headg);
+  if (output_long) ga_free_output(&output_long);
+  MYFREE(ga_header_line);
+  ga_free_chr_dict();
+
+  return 0;
 
-  smtNb = ga_count_peaks (chr_block_headsmt); //counting smt number
-  printf("smtnb:%ld\n", smtNb);
+err:
+  smt_free (smt, smt_nb);
+  MYFREE(smt_list);
+  MYFREE(sig_list);
+  MYFREE(sig_m_list);
+  MYFREE(sig_d_list);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (chr_block_headg) ga_free_chr_block(&chr_block_headg);
+  if (output_long) ga_free_output(&output_long);
+  MYFREE(ga_header_line);
+  ga_free_chr_dict();
+  return -1;
+}
+
+/*
+ * This loads signal file: parsing, sorting, and compaction, quantization and index if they are on.
+ * *filesig       : signal file
+ * **chr_block_head: pointer of pointer to struct chr_block
+ * *smt          : summit sets. The summits of all sets are passed to the parser of every format (bedgraph, sepwiggz, onewiggz, sigbin, sigshm, bigwig), so signal out of summit +- (hw + win / 2) is dropped on parsing
+ * smt_nb         : number of summit sets, or 0 for all signal
+ * This returns 0 if the signal is loaded, otherwise -1.
+ */
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct smt_set smt[], const int smt_nb)
+{
+  struct chr_block **region_head;
+  int k, ret;
+
+  region_head = (struct chr_block **)my_malloc((smt_nb ? smt_nb : 1) * sizeof(struct chr_block *));
+  for (k = 0; k < smt_nb; k++) region_head[k] = smt[k].head;
+  ret = ga_parse_sig_regions (filesig, sigfmt, chr_block_head, region_head, smt_nb, hw + win / 2, zoom ? win : 0); //the outermost window is centred at +-hw and extends win / 2 further
+  MYFREE(region_head);
+  if (ret != 0) {
+    LOG("error: error in ga_parse_sig_regions function.");
+    return -1;
+  }
+
+  *chr_block_head = ga_sort_chr_block_sig(*chr_block_head); //sorting chr and sig
+
+  if (compact) ga_compact_sig (*chr_block_head, 1);
+  if (ga_quantize_sig (*chr_block_head, sig_quant) != 0) {
+    LOG("error: error in ga_quantize_sig function.");
+    return -1;
+  }
+  if (sig_index) ga_index_sig (*chr_block_head);
+  return 0;
+}
+
+/*
+ * This adds the lines of output of one signal to the combined long format table with the name of the profile in the last column.
+ */
+static int long_add (struct output **output_long, struct output *output_head, const char *profile)
+{
+  struct output *o;
+  char val[FILE_STR_LEN];
+
+  if (output_long == NULL) return 0;
+  sprintf(val, "%s\n", profile);
+  for (o = output_head; o; o = o->next) {
+    if (add_one_val (ga_line_out, o->line, val) < 0) return -1;
+    ga_output_append (output_long, ga_line_out);
+  }
+  return 0;
+}
+
+/*pointer which must be freed: smt[] (smt_free) */
+/*
+ * This frees summit sets.
+ */
+static void smt_free (struct smt_set smt[], const int smt_nb)
+{
+  int k;
+
+  if (smt == NULL) return;
+  for (k = 0; k < smt_nb; k++) {
+    if (smt[k].head) ga_free_chr_block(&smt[k].head);
+  }
+  MYFREE(smt);
+}
+
+/*
+ * This loads one signal, and calculates the average distribution of it around the summits of each summit set by smt_run.
+ * *smt               : summit sets
+ * *chr_block_headg   : genome table for the random simulation, or NULL
+ * *filesig_m         : signal file from minus strand, or NULL
+ * *filesig_d         : signal denominator file, or NULL
+ * *chr_block_headsig_d_in: loaded signal denominator shared by signals, or NULL. If given, filesig_d is not loaded.
+ * **output_long      : combined long format table which the output lines are added to, or NULL
+ * This returns 0 if the outputs are written, otherwise -1.
+ */
+static int sig_run (struct smt_set smt[], const int smt_nb, struct chr_block *chr_block_headg, char *filesig, const char *filesig_m, char *filesig_d, struct chr_block *chr_block_headsig_d_in, struct output **output_long)
+{
+  struct chr_block *chr_block_headsig = NULL; //for signal
+  struct chr_block *chr_block_headsig_m = NULL; //for signal
+  struct chr_block *chr_block_headsig_d = NULL; //for signal of denominator
+  int region_nb; //number of summit sets around which signal is read
+  int k, ret = 0;
+
+  // reading signal file. Random positions of simulation are anywhere, so signal is read only around summits without simulation.
+  region_nb = randnb ? 0 : smt_nb;
+  if (sig_load (filesig, &chr_block_headsig, smt, region_nb) != 0) goto err;
+  if (filesig_m) { //letting calculation of anti-strand reads mode on
+    if (sig_load (filesig_m, &chr_block_headsig_m, smt, region_nb) != 0) goto err;
+  }
+  if (filesig_d && !chr_block_headsig_d_in) {//if denominator
+    if (sig_load (filesig_d, &chr_block_headsig_d, smt, region_nb) != 0) goto err;
+  }
+
+  for (k = 0; k < smt_nb && ret == 0; k++) { //the loaded signal is counted against all summit sets
+    ret = smt_run (&smt[k], chr_block_headg, filesig, filesig_m, filesig_d, chr_block_headsig, chr_block_headsig_m,
+             chr_block_headsig_d_in ? chr_block_headsig_d_in : chr_block_headsig_d, output_long);
+  }
+
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_m) ga_free_chr_block(&chr_block_headsig_m);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  return ret;
+
+err:
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_m) ga_free_chr_block(&chr_block_headsig_m);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  return -1;
+}
+
+/*
+ * This calculates the average distribution of one loaded signal around the summits of one summit set, and writes the output files.
+ * *smt               : sorted summits
+ * *chr_block_headg   : genome table for the random simulation, or NULL
+ * *filesig           : signal file, which gives the output names
+ * *filesig_m         : signal file from minus strand, or NULL
+ * *filesig_d         : signal denominator file, or NULL
+ * *chr_block_headsig_m: loaded minus strand signal if filesig_m is given
+ * *chr_block_headsig_d: loaded signal denominator if filesig_d is given
+ * **output_long      : combined long format table which the output lines are added to, or NULL
+ * This returns 0 if the outputs are written, otherwise -1.
+ */
+static int smt_run (struct smt_set *smt, struct chr_block *chr_block_headg, char *filesig, const char *filesig_m, char *filesig_d, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_m, struct chr_block *chr_block_headsig_d, struct output **output_long)
+{
+  struct chr_block *chr_block_headsmt = smt->head; //for summit
+  struct chr_block *chr_block_headr = NULL; //for random simulation
+
+  struct output *output_head = NULL; //for output
+  struct output *output_headr = NULL; //for output
+  struct output *output_head_a = NULL; //for output
+  struct output *output_headr_a = NULL; //for output
+
+  int rel, i, r;
+  float t, t2, mu_x, mu_y, ustd_y, var_x, var_y, var_xy;
+  float *arr=NULL, *arr_tmp=NULL, *arr_d=NULL, *arr_tmp_d=NULL, *arr_a=NULL, *arr_tmp_a=NULL;
+  float *arr_r=NULL, *arr_r_tmp=NULL, *arr_r_d=NULL, *arr_r_d_tmp=NULL, *arr_r_a=NULL, *arr_r_a_tmp=NULL;
+
+  const long smtNb = smt->nb;
+  const char *fn_smt = smt->fn;
+  long c;
+
+  /*path, filename, and extension*/
+  char path_sig[PATH_STR_LEN] = {0};
+  char fn_sig[FILE_STR_LEN] = {0};
+  char ext_sig[EXT_STR_LEN] = {0};
+  char path_sig_d[PATH_STR_LEN] = {0};
+  char fn_sig_d[FILE_STR_LEN] = {0};
+  char ext_sig_d[EXT_STR_LEN] = {0};
+  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
+
+  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig); //parsing input file name into path, file name, and extension
+  if (!strcmp(sigfmt, "sigshm")) path_sig[0] = '\0'; //signal store has no directory, so the output is written in the current directory
+  if(filesig_d) ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
 
   //allocating arrays
   arr = (float*)my_malloc((((2 * hw) / step + 1) * smtNb)*sizeof(float)); //output arr, 1d
@@ -198,48 +414,11 @@ time:                            %s\n",\
   }
 
   if (filesig_m) { //letting calculation of anti-strand reads mode on
-    if (!strcmp(sigfmt, "bedgraph")) {
-      ga_parse_bedgraph (filesig_m, &chr_block_headsig_m);
-    } else if (!strcmp(sigfmt, "sepwiggz")) {
-      ga_parse_sepwiggz (filesig_m, &chr_block_headsig_m);
-    } else if (!strcmp(sigfmt, "onewiggz")) {
-      ga_parse_onewiggz (filesig_m, &chr_block_headsig_m);
-    } else {
-      LOG("error: invalid signal file format.");
-      goto err;
-    }
-
-    chr_block_headsig_m = ga_mergesort_chr(chr_block_headsig_m); //sorting chr of sig
-    for (ch = chr_block_headsig_m; ch; ch = ch -> next) {
-      ch -> sig_list = ga_mergesort_sig(ch -> sig_list); //sorting sig
-    }
-
-    //allocating arrays
     arr_a = (float*)my_malloc((((2 * hw) / step + 1) * smtNb)*sizeof(float)); //output arr, 1d
     arr_tmp_a = (float*)my_malloc(smtNb*sizeof(float)); //output arr, 1d
-    sig_count_anti (chr_block_headsmt, chr_block_headsig, chr_block_headsig_m, arr, arr_a, smtNb); //counting the signal. This process is the heart of the program!
-  } else {
-    sig_count (chr_block_headsmt, chr_block_headsig, arr, smtNb); //counting the signal. This process is the heart of the program!
   }
 
-  if (filesig_d) {//if denominator
-    if (!strcmp(sigfmt, "bedgraph")) {
-      ga_parse_bedgraph (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "sepwiggz")) {
-      ga_parse_sepwiggz (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "onewiggz")) {
-      ga_parse_onewiggz (filesig_d, &chr_block_headsig_d);
-    } else {
-      LOG("error: invalid signal file format.");
-      goto err;
-    }
-
-    chr_block_headsig_d = ga_mergesort_chr(chr_block_headsig_d); //sorting chr of sig
-    for (ch = chr_block_headsig_d; ch; ch = ch -> next) {
-      ch -> sig_list = ga_mergesort_sig(ch -> sig_list); //sorting sig
-    }
-    sig_count (chr_block_headsmt, chr_block_headsig_d, arr_d, smtNb);
-  }
+  ga_count_sig (chr_block_headsmt, chr_block_headsig, chr_block_headsig_m, chr_block_headsig_d, arr, arr_a, arr_d, smtNb, hw, step, win, slide); //counting the signal of all tracks. This process is the heart of the program!
 
   rel = hw; //relative pos
   t = ga_t_table (smtNb - 1); //97.5 percentile for t-dist with ddf = N -1
@@ -291,6 +470,7 @@ time:                            %s\n",\
     else sprintf(output_name, "%s%s_around_%s_halfwid%dwinsize%dstep%d.txt", path_sig, fn_sig, fn_smt, hw, win, step);
   }
   ga_write_lines (output_name, output_head, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\n");
+  if (long_add (output_long, output_head, filesig_m ? "sense" : (filesig_d ? "divided" : "signal")) != 0) goto err;
 
   if (filesig_m) {
     rel = hw; //relative pos
@@ -313,6 +493,7 @@ time:                            %s\n",\
 
     sprintf(output_name, "%s%s_around_%s_halfwid%dwinsize%dstep%d_anti.txt", path_sig, fn_sig, fn_smt, hw, win, step);
     ga_write_lines (output_name, output_head_a, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\n");
+    if (long_add (output_long, output_head_a, "anti") != 0) goto err;
   } //if (filesig_m)
 
   if (!randnb) { //if no random simulation, the program ends.
@@ -320,8 +501,6 @@ time:                            %s\n",\
   }
 
   //the random simulation starts here.
-  ga_parse_chr_bs(filegenome, &chr_block_headg, 0, 1, 1, -1, 0); //reading genome table
-
   arr_r = (float*)my_malloc((((2 * hw) / step + 1) * randnb)*sizeof(float)); //output arr, 1d
   arr_r_tmp = (float*)my_malloc(randnb * sizeof(float)); //output arr, 1d
 
@@ -345,18 +524,9 @@ time:                            %s\n",\
 
     ga_parse_chr_bs_rand (&chr_block_headr, chr_block_headsmt, chr_block_headg, hw); //picking up random positions
 
-    chr_block_headr = ga_mergesort_chr(chr_block_headr);
-    for (ch = chr_block_headr; ch; ch = ch -> next) {
-      ch -> bs_list = ga_mergesort_bs(ch -> bs_list); //sorting
-    }
+    chr_block_headr = ga_sort_chr_block_bs(chr_block_headr);
 
-    if (filesig_m) {
-      sig_count_anti (chr_block_headr, chr_block_headsig, chr_block_headsig_m, arr, arr_a, smtNb); //calculating signals around random postions
-    } else {
-      sig_count (chr_block_headr, chr_block_headsig, arr, smtNb); //calculating signals around random postions
-    }
-    if (filesig_d)
-      sig_count (chr_block_headr, chr_block_headsig_d, arr_d, smtNb);
+    ga_count_sig (chr_block_headr, chr_block_headsig, chr_block_headsig_m, chr_block_headsig_d, arr, arr_a, arr_d, smtNb, hw, step, win, slide); //calculating signals around random postions
 
     for (i = 0; i < (2 * hw) / step + 1; i++) { //calculating mean
       for (c = 0; c < smtNb; c++)
@@ -427,10 +597,12 @@ time:                            %s\n",\
     ga_write_lines (output_name, output_headr, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\n");
     sprintf(output_name, "%s%s_around_%s_halfwid%dwinsize%dstep%d_anti_random%d.txt", path_sig, fn_sig, fn_smt, hw, win, step, randnb);
     ga_write_lines (output_name, output_headr_a, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\n");
+    if (long_add (output_long, output_headr, "sense_random") != 0 || long_add (output_long, output_headr_a, "anti_random") != 0) goto err;
   } else {
     if (filesig_d) sprintf(output_name, "%s%s_divided_%s_around_%s_halfwid%dwinsize%dstep%d_random%d.txt", path_sig, fn_sig, fn_sig_d, fn_smt, hw, win, step, randnb);
     else sprintf(output_name, "%s%s_around_%s_halfwid%dwinsize%dstep%d_random%d.txt", path_sig, fn_sig, fn_smt, hw, win, step, randnb);
     ga_write_lines (output_name, output_headr, "relative_pos\tsmt_mean\tCI95.00percent_U\tCI95.00percent_L\tsmtNb\tCentered\tSignal\n");
+    if (long_add (output_long, output_headr, filesig_d ? "divided_random" : "random") != 0) goto err;
   }
 
   goto rtfree;
@@ -448,17 +620,11 @@ rtfree:
   MYFREE(arr_r_d_tmp);
   MYFREE(arr_r_a);
   MYFREE(arr_r_a_tmp);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
-  if (chr_block_headsig_m) ga_free_chr_block(&chr_block_headsig_m);
   if (chr_block_headr) ga_free_chr_block(&chr_block_headr);
-  if (chr_block_headg) ga_free_chr_block(&chr_block_headg);
   if (output_head) ga_free_output(&output_head);
   if (output_headr) ga_free_output(&output_headr);
   if (output_head_a) ga_free_output(&output_head_a);
   if (output_headr_a) ga_free_output(&output_headr_a);
-  MYFREE(ga_header_line);
 
   return 0;
 
@@ -475,288 +641,10 @@ err:
   MYFREE(arr_r_d_tmp);
   MYFREE(arr_r_a);
   MYFREE(arr_r_a_tmp);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
-  if (chr_block_headsig_m) ga_free_chr_block(&chr_block_headsig_m);
   if (chr_block_headr) ga_free_chr_block(&chr_block_headr);
-  if (chr_block_headg) ga_free_chr_block(&chr_block_headg);
   if (output_head) ga_free_output(&output_head);
   if (output_headr) ga_free_output(&output_headr);
   if (output_head_a) ga_free_output(&output_head_a);
   if (output_headr_a) ga_free_output(&output_headr_a);
-  MYFREE(ga_header_line);
   return -1;
 }
-
-//the structure of arr is [win1:peak1,peak2...peakN|win2:peak1,peak2...peakN|...|winN:peak1,peak2...peakN]
-//the structure of arr_r is [r1:peak1,peak2...peakN|r2:peak1,peak2...peakN|...|rN:peak1,peak2...peakN]
-static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb)
-{
-  struct chr_block *ch_smt, *ch_sig;
-  struct bs *bs;
-  struct sig *j1, *j1_tmp = NULL; //j1 is the pointer to chr_block_headsig which is counted in the window. j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
-  int i, fl, winNb = (2 * hw) / step + 1;
-  long c=0, st, ed, tmp_st, tmp_ed;
-  float val_tmp;
-
-  for (ch_smt = chr_block_headsmt; ch_smt; ch_smt = ch_smt->next) {
-//    printf("calculating reads on %s\n", ch_smt->chr);
-    for (ch_sig = chr_block_headsig; ch_sig; ch_sig = ch_sig->next) {
-      if (!strcmp(ch_smt->chr, ch_sig->chr)) break; //if the same chr is included in smt and sig
-    }
-
-    if (ch_sig == NULL) { //if chr in smt is not included in sig...
-      for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-        for (i = 0; i < winNb; i++) arr[i * smtNb + c] = 0.0; //assigning value 0.0 if chr in smt is not included in sig. 
-        c++; //counting up for each bs
-      }
-      continue;
-    }
-
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
-    for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-      fl = 0; //init of flag
-      if (bs->strand == '-') {//if the summit is on minus strand
-        st = bs->ed - hw - win / 2; //start pos
-        ed = bs->ed - hw + win / 2; //end pos
-      } else {
-        st = bs->st - hw - win / 2; //start pos
-        ed = bs->st - hw + win / 2; //end pos
-      }
-      for (i = 0; i < winNb; i++) {
-        if (j1_tmp == NULL) {
-          for (j1 = ch_sig->sig_list; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-        else {
-          for (j1 = j1_tmp; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-
-        if (j1 == NULL) { //if the win is the right side of the most right sig block
-          if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = 0.0; //assigning value 0.0
-          else arr[i * smtNb + c] = 0.0; //assigning value 0.0
-          st += step;
-          ed += step;
-          continue;
-        }
-
-        if (j1_tmp == NULL && bs->strand != '-') { //if j1_tmp is not set for the chr
-          j1_tmp = j1;
-          fl = 1;
-        }
-        else if (!fl && bs->strand != '-') { //if j1_tmp is not set for the bs (fl == 0) and the strand is not minus.
-          j1_tmp = j1;
-          fl = 1;
-        }
-        
-        val_tmp = 0;
-        for (;j1 ; j1 = j1->next) {
-          if (j1->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1->st) tmp_st = st; //if st of sig block is up-stream pos of st
-          else tmp_st = j1->st;
-          if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-          else tmp_ed = j1->ed;
-          val_tmp += (j1->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
-        }
-        if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = val_tmp / (float)win;
-        else arr[i * smtNb + c] = val_tmp / (float)win;
-        st += step;
-        ed += step;
-      }
-      c++; //counting up for each bs
-    }
-  }
-
-  return;
-}
-
-
-static void sig_count_anti (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig_p, struct chr_block *chr_block_headsig_m, float arr[], float arr_a[], const long smtNb)
-{
-  struct chr_block *ch_smt, *ch_sig;
-  struct bs *bs;
-  struct sig *j1, *j1_tmp = NULL; //j1 is the pointer to chr_block_headsig which is counted in the window. j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
-  int i, fl, winNb = (2 * hw) / step + 1;
-  long c=0, c_tmp=0, st, ed, tmp_st, tmp_ed;
-  float val_tmp;
-
-  for (ch_smt = chr_block_headsmt; ch_smt; ch_smt = ch_smt->next) {
-//    printf("calculating reads on %s\n", ch_smt->chr);
-    for (ch_sig = chr_block_headsig_p; ch_sig; ch_sig = ch_sig->next) {
-      if (!strcmp(ch_smt->chr, ch_sig->chr)) break; //if the same chr is included in smt and sig
-    }
-
-    if (ch_sig == NULL) { //if chr in smt is not included in sig...
-      for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-        for (i = 0; i < winNb; i++) {
-          arr[i * smtNb + c] = 0.0; //assigning value 0.0 if chr in smt is not included in sig. 
-          arr_a[i * smtNb + c] = 0.0; //assigning value 0.0 if chr in smt is not included in sig. 
-        }
-        c++; //counting up for each bs
-      }
-      continue;
-    }
-
-    c_tmp = c; //memory of c
-
-    //calculating for plus strand reads
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
-    for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-      fl = 0; //init of flag
-      if (bs->strand == '-') {//if the summit is on minus strand
-        st = bs->ed - hw - win / 2; //start pos
-        ed = bs->ed - hw + win / 2; //end pos
-      } else {
-        st = bs->st - hw - win / 2; //start pos
-        ed = bs->st - hw + win / 2; //end pos
-      }
-      for (i = 0; i < winNb; i++) {
-        if (j1_tmp == NULL) {
-          for (j1 = ch_sig->sig_list; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-        else {
-          for (j1 = j1_tmp; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-
-        if (j1 == NULL) { //if the win is the right side of the most right sig block
-          if (bs->strand == '-') arr_a[(winNb -1 - i) * smtNb + c] = 0.0; //assigning value 0.0
-          else arr[i * smtNb + c] = 0.0; //assigning value 0.0
-          st += step;
-          ed += step;
-          continue;
-        }
-
-        if (j1_tmp == NULL && bs->strand != '-') { //if j1_tmp is not set for the chr
-          j1_tmp = j1;
-          fl = 1;
-        }
-        else if (!fl && bs->strand != '-') { //if j1_tmp is not set for the bs (fl == 0) and the strand is not minus.
-          j1_tmp = j1;
-          fl = 1;
-        }
-
-        
-        val_tmp = 0;
-        for (;j1 ; j1 = j1->next) {
-          if (j1->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1->st) tmp_st = st; //if st of sig block is up-stream pos of st
-          else tmp_st = j1->st;
-          if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-          else tmp_ed = j1->ed;
-          val_tmp += (j1->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
-        }
-        if (bs->strand == '-') arr_a[(winNb -1 - i) * smtNb + c] = val_tmp / (float)win;
-        else arr[i * smtNb + c] = val_tmp / (float)win;
-        st += step;
-        ed += step;
-      }
-      c++; //counting up for each bs
-    } //bs
-
-    c = c_tmp; //memory of c
-    for (ch_sig = chr_block_headsig_m; ch_sig; ch_sig = ch_sig->next) {
-      if (!strcmp(ch_smt->chr, ch_sig->chr)) break; //if the same chr is included in smt and sig
-    }
-
-    //calculating for minus strand reads
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
-    for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-      fl = 0; //init of flag
-      if (bs->strand == '-') {//if the summit is on minus strand
-        st = bs->ed - hw - win / 2; //start pos
-        ed = bs->ed - hw + win / 2; //end pos
-      } else {
-        st = bs->st - hw - win / 2; //start pos
-        ed = bs->st - hw + win / 2; //end pos
-      }
-      for (i = 0; i < winNb; i++) {
-        if (j1_tmp == NULL) {
-          for (j1 = ch_sig->sig_list; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-        else {
-          for (j1 = j1_tmp; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-
-        if (j1 == NULL) { //if the win is the right side of the most right sig block
-          if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = 0.0; //assigning value 0.0
-          else arr_a[i * smtNb + c] = 0.0; //assigning value 0.0
-          st += step;
-          ed += step;
-          continue;
-        }
-
-        if (j1_tmp == NULL && bs->strand != '-') { //if j1_tmp is not set for the chr
-          j1_tmp = j1;
-          fl = 1;
-        }
-        else if (!fl && bs->strand != '-') { //if j1_tmp is not set for the bs (fl == 0) and the strand is not minus.
-          j1_tmp = j1;
-          fl = 1;
-        }
-        
-        val_tmp = 0;
-        for (;j1 ; j1 = j1->next) {
-          if (j1->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1->st) tmp_st = st; //if st of sig block is up-stream pos of st
-          else tmp_st = j1->st;
-          if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-          else tmp_ed = j1->ed;
-          val_tmp += (j1->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
-        }
-        if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = val_tmp / (float)win;
-        else arr_a[i * smtNb + c] = val_tmp / (float)win;
-        st += step;
-        ed += step;
-      }
-      c++; //counting up for each bs
-    } //bs
-
-  } //chr
-
-  return;
-}
-
-
-
@@ -8,6 +8,7 @@
 #include "write_tab.h"
 #include "sort_list.h"
 #include "argument.h"
+#include "ga_count.h"
 #include "ga_my.h"
 
 #include <stdio.h>
@@ -20,13 +21,14 @@
   __FILE__, __LINE__, __FUNCTION__)
 
 //static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb, const int hw, const int step, const int win);
-static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb);
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb);
+static int smt_run (char *filesmt, struct chr_block **chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d);
 
 static void usage()
 {
   printf("Tool:    ga_reads_summit_all\n\n\
 Summary: report the read distributions around ALL summits\n\n\
-Usage:   ga_reads_summit_all [options] --smt <summit file> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz>\n\n\
+Usage:   ga_reads_summit_all [options] --smt <summit file[,summit file...]> --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig>\n\n\
 Options:\n\
          -v: output version information and exit.\n\
          -h, --help: display this help and exit.\n\
@@ -37,9 +39,17 @@ Options:\n\
          --header: the first line of summit file is considered as header (default:off).\n\
          --gt: genome table file (default:NULL)\n\
          --sig_d: signal denominator file like input (default:NULL)\n\
+         With summit files separated by comma, the signal is loaded once and calculated against each of them, and the output of each summit file is written. Signal of any format is read only around the summits of all files.\n\
          --hw: <int> half range size (default:1000)\n\
          --step: <int> step size (default: 10)\n\
-         --win: <int> window size (default:25)\n");
+         --win: <int> window size (default:25)\n\
+         --threads: <int> number of threads for loading input files and counting signal. The result is the same whatever the number is (default:4)\n\
+         --pipe_stat: print waiting time of reading and parsing threads for each input file (default:off)\n\
+         --sig_index: window sums are calculated from prefix-sum index of signal, so the time doesn't depend on window size. The last digit may differ by rounding (default:off)\n\
+         --slide: window sums are calculated by sliding the window along signal, adding the entering span and subtracting the leaving span, so signal is walked once per summit. Signal which overlaps each other is scanned as before. The last digit may differ by rounding (default:off)\n\
+         --compact: adjacent signal records with the same value are merged and records with value 0 are removed on loading, so the scan of signal is shorter. The last digit may differ by rounding (default:off)\n\
+         --sig_quant <none | half | int16>: signal values are stored in 16 bits to save memory. half keeps about 3 significant digits, and int16 keeps 1/32767 of the max value of each chr (default:none)\n\
+         --zoom: windows are calculated from zoom level summaries of bigWig if win is much larger than the zoom level (default:off)\n");
   exit(0);
 }
 
@@ -52,6 +62,13 @@ static void version()
 
 static int hf = 0;
 static char hfs[4] = "off\0";
+static int sig_index = 0; //if 1, window sums are calculated by prefix-sum index
+static char sig_indexs[4] = "off\0";
+static int slide = 0; //if 1, window sums are calculated by sliding window
+static char slides[4] = "off\0";
+static int compact = 0; //if 1, adjacent sig with the same value are merged on loading
+static char compacts[4] = "off\0";
+static char *sig_quant = "none"; //none | half | int16
 static char *filesmt = NULL;
 static char *filesig = NULL;
 static char *filesig_d = NULL;
@@ -64,6 +81,8 @@ static int col_strand = -1;
 static int hw = 1000; //half window size
 static int step = 10; //step size
 static int win = 25; //window size
+static int zoom = 0; //if 1, bigWig zoom level is used
+static char zooms[4] = "off\0";
 char *ga_header_line = NULL; //header line. Note this is external global variable
 static char ga_line_out[LINE_STR_LEN] = {0}; //output line including relative pos, smt_mean, CI95.00percent_U, CI95.00percent_L, smtNb, Centered, Signal
 
@@ -77,6 +96,13 @@ static const Argument args[] = {
   {"--sig_d"      , ARGUMENT_TYPE_STRING  , &filesig_d   },
   {"--gt"         , ARGUMENT_TYPE_STRING  , &filegenome  },
   {"--sigfmt"     , ARGUMENT_TYPE_STRING  , &sigfmt      },
+  {"--threads"    , ARGUMENT_TYPE_INTEGER , &ga_thread_nb},
+  {"--pipe_stat"  , ARGUMENT_TYPE_FLAG_ON , &ga_pipe_stat},
+  {"--zoom"       , ARGUMENT_TYPE_FLAG_ON , &zoom        },
+  {"--sig_index"  , ARGUMENT_TYPE_FLAG_ON , &sig_index   },
+  {"--slide"      , ARGUMENT_TYPE_FLAG_ON , &slide       },
+  {"--compact"    , ARGUMENT_TYPE_FLAG_ON , &compact     },
+  {"--sig_quant"  , ARGUMENT_TYPE_STRING  , &sig_quant   },
   {"--col_chr"    , ARGUMENT_TYPE_INTEGER , &col_chr     },
   {"--col_start"  , ARGUMENT_TYPE_INTEGER , &col_st      },
   {"--col_end"    , ARGUMENT_TYPE_INTEGER , &col_ed      },
@@ -93,80 +119,145 @@ int main (int argc, char *argv[])
   argument_read(&argc, argv, args);//reading arguments
   if (filesmt == NULL || filesig == NULL || sigfmt == NULL) usage();
 
-  struct chr_block *chr_block_headsmt = NULL; //for summit
+  struct chr_block **smt_head = NULL; //for summit of each summit set
   struct chr_block *chr_block_headsig = NULL; //for signal
   struct chr_block *chr_block_headsig_d = NULL; //for signal of denominator
 
-  struct chr_block *ch; //for "for loop of chr"
-  struct output *output_head = NULL; //for output
-
-  int rel, i;
-  float *arr=NULL, *arr_d=NULL; //, *arr_a, *arr_tmp_a;
-
-  long smtNb, c;
-
-  /*path, filename, and extension*/
-  char path_smt[PATH_STR_LEN] = {0};
-  char fn_smt[FILE_STR_LEN] = {0};
-  char ext_smt[EXT_STR_LEN] = {0};
-  char path_sig[PATH_STR_LEN] = {0};
-  char fn_sig[FILE_STR_LEN] = {0};
-  char ext_sig[EXT_STR_LEN] = {0};
-  char path_sig_d[PATH_STR_LEN] = {0};
-  char fn_sig_d[FILE_STR_LEN] = {0};
-  char ext_sig_d[EXT_STR_LEN] = {0};
-  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
-  char str_tmp[32] = {0}; //for each value with \t
+  char **smt_list = NULL; //file names of the summits
+  int k, smt_nb = 0;
 
   time_t timer;
 
   if(hf) strcpy(hfs, "on\0");
+  if(sig_index) strcpy(sig_indexs, "on\0");
+  if(slide) strcpy(slides, "on\0");
+  if(compact) strcpy(compacts, "on\0");
+  if(zoom) strcpy(zooms, "on\0");
   time(&timer);
   printf("Tool:                            %s\n\n\
 Input file summit:               %s\n\
 Input file signal:               %s\n\
 Input file signal denominator:   %s\n\
 signal format:                   %s\n\
+threads:                         %d\n\
 summit col of chr, start, end:   %d, %d, %d\n\
 summit col strand?:              %d\n\
 half range:                      %d\n\
 step size:                       %d\n\
 win size:                        %d\n\
 header flag:                     %s\n\
+bigWig zoom:                     %s\n\
+signal index:                    %s\n\
+sliding window:                  %s\n\
+signal compaction:               %s\n\
+signal quantization:             %s\n\
 time:                            %s\n",\
- "ga_reads_summit_all", filesmt, filesig, filesig_d, sigfmt, col_chr, col_st, col_ed, col_strand, hw, step, win, hfs, ctime(&timer) );
+ "ga_reads_summit_all", filesmt, filesig, filesig_d, sigfmt, ga_thread_nb, col_chr, col_st, col_ed, col_strand, hw, step, win, hfs, zooms, sig_indexs, slides, compacts, sig_quant, ctime(&timer) );
 
-  ga_parse_file_path (filesmt, path_smt, fn_smt, ext_smt); //parsing input file name into path, file name, and extension
-  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig);
-  if(filesig_d) ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
+  smt_nb = ga_file_list (filesmt, &smt_list); //summits separated by comma
 
-  ga_parse_chr_bs(filesmt, &chr_block_headsmt, col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+  smt_head = (struct chr_block **)my_calloc(smt_nb, sizeof(struct chr_block *));
+  for (k = 0; k < smt_nb; k++) { //each summit file is parsed once, and is kept until it is counted
+    ga_parse_chr_bs(smt_list[k], &smt_head[k], col_chr, col_st, col_ed, col_strand, hf); //parsing each binding sites for each chromosome
+  }
 
   // reading signal file
-  if (!strcmp(sigfmt, "bedgraph")) {
-    ga_parse_bedgraph (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "sepwiggz")) {
-    ga_parse_sepwiggz (filesig, &chr_block_headsig);
-  } else if (!strcmp(sigfmt, "onewiggz")) {
-    ga_parse_onewiggz (filesig, &chr_block_headsig);
-  } else {
-    LOG("error: invalid signal file format.");
-    goto err;
+  if (sig_load (filesig, &chr_block_headsig, smt_head, smt_nb) != 0) goto err; //only around summits of all sets
+  if (filesig_d) {//if denominator
+    if (sig_load (filesig_d, &chr_block_headsig_d, smt_head, smt_nb) != 0) goto err;
   }
 
-  // sorting summit and sig
-  chr_block_headsmt = ga_mergesort_chr(chr_block_headsmt);
-  chr_block_headsig = ga_mergesort_chr(chr_block_headsig);
+  for (k = 0; k < smt_nb; k++) { //the loaded signal is counted against all summit sets
+    if (smt_nb > 1) printf("summit %d/%d: %s\n", k + 1, smt_nb, smt_list[k]);
+    if (smt_run (smt_list[k], &smt_head[k], chr_block_headsig, chr_block_headsig_d) != 0) goto err;
+  }
 
-  for (ch = chr_block_headsmt; ch; ch = ch -> next) {
-    ch -> bs_list = ga_mergesort_bs(ch -> bs_list);
+  MYFREE(smt_head);
+  MYFREE(smt_list);
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  MYFREE(ga_header_line);
+  ga_free_chr_dict();
+
+  return 0;
+
+err:
+  for (k = 0; smt_head && k < smt_nb; k++) {
+    if (smt_head[k]) ga_free_chr_block(&smt_head[k]);
   }
-  for (ch = chr_block_headsig; ch; ch = ch -> next) {
-    ch -> sig_list = ga_mergesort_sig(ch -> sig_list);
+  MYFREE(smt_head);
+  MYFREE(smt_list);
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  MYFREE(ga_header_line);
+  ga_free_chr_dict();
+  return -1;
+}
+
+/*
+ * This loads signal file: parsing, sorting, and compaction, quantization and index if they are on.
+ * *filesig       : signal file
+ * **chr_block_head: pointer of pointer to struct chr_block
+ *region_head[] : summits of each set. They are passed to the parser of every format (bedgraph, sepwiggz, onewiggz, sigbin, sigshm, bigwig), so signal out of summit +- (hw + win / 2) is dropped on parsing
+ * region_nb      : number of summit sets
+ * This returns 0 if the signal is loaded, otherwise -1.
+ */
+static int sig_load (const char *filesig, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb)
+{
+  if (ga_parse_sig_regions (filesig, sigfmt, chr_block_head, region_head, region_nb, hw + win / 2, zoom ? win : 0) != 0) { //the outermost window is centred at +-hw and extends win / 2 further
+    LOG("error: error in ga_parse_sig_regions function.");
+    return -1;
   }
 
+  *chr_block_head = ga_sort_chr_block_sig(*chr_block_head); //sorting chr and sig
+
+  if (compact) ga_compact_sig (*chr_block_head, 1);
+  if (ga_quantize_sig (*chr_block_head, sig_quant) != 0) {
+    LOG("error: error in ga_quantize_sig function.");
+    return -1;
+  }
+  if (sig_index) ga_index_sig (*chr_block_head);
+  return 0;
+}
+
+/*
+ * This calculates the signal around all summits of one summit set, and writes the output file.
+ * *filesmt           : summit file
+ * **chr_block_headsmt: summits parsed from filesmt. They are freed before return.
+ * *chr_block_headsig : loaded signal
+ * *chr_block_headsig_d: loaded signal denominator, or NULL
+ * This returns 0 if the output is written, otherwise -1.
+ */
+static int smt_run (char *filesmt, struct chr_block **chr_block_headsmt, struct chr_block *chr_block_headsig, struct chr_block *chr_block_headsig_d)
+{
+  struct output *output_head = NULL; //for output
+
+  int rel, i;
+  float *arr=NULL, *arr_d=NULL; //, *arr_a, *arr_tmp_a;
+
+  long smtNb, c;
+
+  /*path, filename, and extension*/
+  char path_smt[PATH_STR_LEN] = {0};
+  char fn_smt[FILE_STR_LEN] = {0};
+  char ext_smt[EXT_STR_LEN] = {0};
+  char path_sig[PATH_STR_LEN] = {0};
+  char fn_sig[FILE_STR_LEN] = {0};
+  char ext_sig[EXT_STR_LEN] = {0};
+  char path_sig_d[PATH_STR_LEN] = {0};
+  char fn_sig_d[FILE_STR_LEN] = {0};
+  char ext_sig_d[EXT_STR_LEN] = {0};
+  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
+  char str_tmp[32] = {0}; //for each value with \t
+
+  ga_parse_file_path (filesmt, path_smt, fn_smt, ext_smt); //parsing input file name into path, file name, and extension
+  ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig);
+  if (!strcmp(sigfmt, "sigshm")) path_sig[0] = '\0'; //signal store has no directory, so the output is written in the current directory
+  if(filesig_d) ga_parse_file_path (filesig_d, path_sig_d, fn_sig_d, ext_sig_d);
+
+  *chr_block_headsmt = ga_sort_chr_block_bs(*chr_block_headsmt); //sorting summit
 
-  smtNb = ga_count_peaks (chr_block_headsmt); //counting smt number
+  smtNb = ga_count_peaks (*chr_block_headsmt); //counting smt number
   printf("smtnb:%ld\n", smtNb);
 
   //allocating arrays
@@ -176,26 +267,7 @@ time:                            %s\n",\
     arr_d = (float*)my_malloc((((2 * hw) / step + 1) * smtNb)*sizeof(float)); //output arr, 1d
   }
 
-  sig_count (chr_block_headsmt, chr_block_headsig, arr, smtNb); //counting the signal. This process is the heart of the program!
-
-  if (filesig_d) {//if denominator
-    if (!strcmp(sigfmt, "bedgraph")) {
-      ga_parse_bedgraph (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "sepwiggz")) {
-      ga_parse_sepwiggz (filesig_d, &chr_block_headsig_d);
-    } else if (!strcmp(sigfmt, "onewiggz")) {
-      ga_parse_onewiggz (filesig_d, &chr_block_headsig_d);
-    } else {
-      LOG("error: invalid signal file format.");
-      goto err;
-    }
-
-    chr_block_headsig_d = ga_mergesort_chr(chr_block_headsig_d); //sorting chr of sig
-    for (ch = chr_block_headsig_d; ch; ch = ch -> next) {
-      ch -> sig_list = ga_mergesort_sig(ch -> sig_list); //sorting sig
-    }
-    sig_count (chr_block_headsmt, chr_block_headsig_d, arr_d, smtNb);
-  }
+  ga_count_sig (*chr_block_headsmt, chr_block_headsig, NULL, chr_block_headsig_d, arr, NULL, arr_d, smtNb, hw, step, win, slide); //counting the signal of all tracks. This process is the heart of the program!
 
   if (filesig_d) {
     for (c = smtNb - 1; c >= 0 ; c--) { 
@@ -300,10 +372,7 @@ time:                            %s\n",\
 
     ga_parse_chr_bs_rand (&chr_block_headr, chr_block_headsmt, chr_block_headg, hw); //picking up random positions
 
-    chr_block_headr = ga_mergesort_chr(chr_block_headr);
-    for (ch = chr_block_headr; ch; ch = ch -> next) {
-      ch -> bs_list = ga_mergesort_bs(ch -> bs_list); //sorting
-    }
+    chr_block_headr = ga_sort_chr_block_bs(chr_block_headr);
 
     sig_count (chr_block_headr, chr_block_headsig, arr, smtNb, hw, step, win); //calculating signals around random postions
 //    }
@@ -367,117 +436,17 @@ time:                            %s\n",\
 rtfree:
   MYFREE(arr);
   MYFREE(arr_d);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (*chr_block_headsmt) ga_free_chr_block(chr_block_headsmt);
+  *chr_block_headsmt = NULL;
   if (output_head) ga_free_output(&output_head);
-  MYFREE(ga_header_line);
 
   return 0;
 
 err:
   MYFREE(arr);
   MYFREE(arr_d);
-  if (chr_block_headsmt) ga_free_chr_block(&chr_block_headsmt);
-  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
-  if (chr_block_headsig_d) ga_free_chr_block(&chr_block_headsig_d);
+  if (*chr_block_headsmt) ga_free_chr_block(chr_block_headsmt);
+  *chr_block_headsmt = NULL;
   if (output_head) ga_free_output(&output_head);
-  MYFREE(ga_header_line);
   return -1;
 }
-
-//the structure of arr is [win1:peak1,peak2...peakN|win2:peak1,peak2...peakN|...|winN:peak1,peak2...peakN]
-//the structure of arr_r is [r1:peak1,peak2...peakN|r2:peak1,peak2...peakN|...|rN:peak1,peak2...peakN]
-static void sig_count (struct chr_block *chr_block_headsmt, struct chr_block *chr_block_headsig, float arr[], const long smtNb)
-{
-  struct chr_block *ch_smt, *ch_sig;
-  struct bs *bs;
-  struct sig *j1, *j1_tmp = NULL; //j1 is the pointer to chr_block_headsig which is counted in the window. j1_tmp is the 'memory' of j1 which act as the marker of the previous position of j1 to speed up the calculation. Thanks to j1_tmp, we don't have to search the signal position of 1 for each chr, rather we can start the searching from the previous position.
-  int i, fl, winNb = (2 * hw) / step + 1;
-  long c=0, st, ed, tmp_st, tmp_ed;
-  float val_tmp;
-
-  for (ch_smt = chr_block_headsmt; ch_smt; ch_smt = ch_smt->next) {
-//    printf("calculating reads on %s\n", ch_smt->chr);
-    for (ch_sig = chr_block_headsig; ch_sig; ch_sig = ch_sig->next) {
-      if (!strcmp(ch_smt->chr, ch_sig->chr)) break; //if the same chr is included in smt and sig
-    }
-
-    if (ch_sig == NULL) { //if chr in smt is not included in sig...
-      for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-        for (i = 0; i < winNb; i++) arr[i * smtNb + c] = 0.0; //assigning value 0.0 if chr in smt is not included in sig. 
-        c++; //counting up for each bs
-      }
-      continue;
-    }
-
-    j1_tmp = NULL; //the "marker" of signal position to speed up the calc. j1_tmp is the left most position for each bs.
-    for (bs = ch_smt->bs_list; bs; bs = bs->next) {
-      fl = 0; //init of flag
-      if (bs->strand == '-') {//if the summit is on minus strand
-        st = bs->ed - hw - win / 2; //start pos
-        ed = bs->ed - hw + win / 2; //end pos
-      } else {
-        st = bs->st - hw - win / 2; //start pos
-        ed = bs->st - hw + win / 2; //end pos
-      }
-      for (i = 0; i < winNb; i++) {
-        if (j1_tmp == NULL) {
-          for (j1 = ch_sig->sig_list; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-        else {
-          for (j1 = j1_tmp; j1; j1=j1->next) { //here's the slowest part...
-            if (st < j1->ed && j1->st < ed) {
-              break; //if one of sig block is inside the win
-            } else if (j1->st >= ed) { //if there's no chance for j1 to overlap win
-              j1 = NULL;
-              break;
-            }
-          }
-        }
-
-        if (j1 == NULL) { //if the win is the right side of the most right sig block
-          if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = 0.0; //assigning value 0.0
-          else arr[i * smtNb + c] = 0.0; //assigning value 0.0
-          st += step;
-          ed += step;
-          continue;
-        }
-
-        if (j1_tmp == NULL && bs->strand != '-') { //if j1_tmp is not set for the chr and the strand is not minus.
-          j1_tmp = j1;
-          fl = 1;
-        }
-        else if (!fl && bs->strand != '-') { //if j1_tmp is not set for the bs (fl == 0) and the strand is not minus.
-          j1_tmp = j1;
-          fl = 1;
-        }
-        
-        val_tmp = 0;
-        for (;j1 ; j1 = j1->next) {
-          if (j1->st >= ed) break; //if the sig pos is out of the win
-          if (st > j1->st) tmp_st = st; //if st of sig block is up-stream pos of st
-          else tmp_st = j1->st;
-          if (j1->ed > ed) tmp_ed = ed; //if ed of sig block is down-stream pos of ed
-          else tmp_ed = j1->ed;
-          val_tmp += (j1->val) * (tmp_ed - tmp_st); //adding the val*len of sig block
-        }
-        if (bs->strand == '-') arr[(winNb -1 - i) * smtNb + c] = val_tmp / (float)win;
-        else arr[i * smtNb + c] = val_tmp / (float)win;
-        st += step;
-        ed += step;
-      }
-      c++; //counting up for each bs
-    }
-  }
-
-  return;
-}
-
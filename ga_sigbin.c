@@ -0,0 +1,155 @@
+/*
+ * This program is one of the genome analysis tools.
+ * This program converts signal file (bedgraph, wig.gz) into binary signal file which is memory-mapped by ga_parse_sigbin.
+ * The binary signal file can be used with '--sigfmt sigbin' option of the other tools.
+ * With --shm, the same data is placed in POSIX shared memory as signal store, which the other tools attach with '--sigfmt sigshm'.
+ * See usage for detail.
+ */
+
+#include "parse_chr.h"
+#include "write_tab.h"
+#include "sort_list.h"
+#include "argument.h"
+#include "ga_my.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define LOG(m) \
+  fprintf(stderr, \
+  "%s:line%d:%s(): " m "\n", \
+  __FILE__, __LINE__, __FUNCTION__)
+
+static void usage()
+{
+  printf("Tool:    ga_sigbin\n\n\
+Summary: convert signal file into binary signal file for fast loading (--sigfmt sigbin)\n\n\
+Usage:   ga_sigbin [options] --sig <signal file> --sigfmt <sig format:bedgraph | sepwiggz | onewiggz | bigwig>\n\
+   or:   ga_sigbin [options] --sig <signal file> --sigfmt <sig format> --shm <name: e.g. /chip1>\n\
+   or:   ga_sigbin --shm_unlink <name>\n\n\
+Options:\n\
+         -v: output version information and exit.\n\
+         -h, --help: display this help and exit.\n\
+         -o <output file>: output file name (default:<path of signal file><signal file name>.sigbin)\n\
+         --shm <name>: place the signal in POSIX shared memory as signal store instead of the file. The tools attach it read-only with '--sig <name> --sigfmt sigshm', so concurrent tools share one copy. The store is kept until --shm_unlink or reboot. An existing store of the name is replaced for tools attaching later, while running tools keep reading the old one.\n\
+         --shm_unlink <name>: remove the signal store and exit.\n\
+         --threads <int>: number of threads for loading signal file (default:4)\n\
+         --pipe_stat: print waiting time of reading and parsing threads for the signal file (default:off)\n");
+  exit(0);
+}
+
+static void version()
+{
+  printf("'ga_sigbin' in genome analysis tools version: %d.%d.%d\n", VER_MAJOR, VER_MOD, VER_MINOR);
+  exit(0);
+}
+
+
+static char *filesig = NULL;
+static char *sigfmt = NULL;
+static char *fileout = NULL;
+static char *shm = NULL; //name of signal store
+static char *shm_rm = NULL; //name of signal store which is removed
+char *ga_header_line = NULL; //header line. Note this is external global variable
+
+static const Argument args[] = {
+  {"-h"           , ARGUMENT_TYPE_FUNCTION, usage        },
+  {"--help"       , ARGUMENT_TYPE_FUNCTION, usage        },
+  {"-v"           , ARGUMENT_TYPE_FUNCTION, version      },
+  {"--sig"        , ARGUMENT_TYPE_STRING  , &filesig     },
+  {"--sigfmt"     , ARGUMENT_TYPE_STRING  , &sigfmt      },
+  {"-o"           , ARGUMENT_TYPE_STRING  , &fileout     },
+  {"--shm"        , ARGUMENT_TYPE_STRING  , &shm         },
+  {"--shm_unlink" , ARGUMENT_TYPE_STRING  , &shm_rm      },
+  {"--threads"    , ARGUMENT_TYPE_INTEGER , &ga_thread_nb},
+  {"--pipe_stat"  , ARGUMENT_TYPE_FLAG_ON , &ga_pipe_stat},
+  {NULL           , ARGUMENT_TYPE_NONE    , NULL         },
+};
+
+
+int main (int argc, char *argv[])
+{
+  argument_read(&argc, argv, args);//reading arguments
+  if (shm_rm) {
+    if (shm_unlink(shm_rm) != 0) {
+      LOG("error: signal store cannot be removed.");
+      return -1;
+    }
+    printf("signal store removed: %s\n", shm_rm);
+    return 0;
+  }
+  if (filesig == NULL || sigfmt == NULL) usage();
+
+  struct chr_block *chr_block_headsig = NULL; //for signal
+
+  /*path, filename, and extension*/
+  char path_sig[PATH_STR_LEN] = {0};
+  char fn_sig[FILE_STR_LEN] = {0};
+  char ext_sig[EXT_STR_LEN] = {0};
+  char output_name[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}; //output file name
+
+  time_t timer;
+
+  time(&timer);
+  printf("Tool:                            %s\n\n\
+Input file signal:               %s\n\
+signal format:                   %s\n\
+threads:                         %d\n\
+Output file:                     %s\n\
+signal store:                    %s\n\
+time:                            %s\n",\
+ "ga_sigbin", filesig, sigfmt, ga_thread_nb, fileout, shm, ctime(&timer) );
+
+  if (!strcmp(sigfmt, "sigbin")) {
+    LOG("error: signal file is already binary signal file.");
+    goto err;
+  }
+
+  if (ga_parse_sig (filesig, sigfmt, &chr_block_headsig) != 0) { //reading signal file
+    LOG("error: error in ga_parse_sig function.");
+    goto err;
+  }
+
+  ga_expand_sig (chr_block_headsig); //fixedStep wig is written with start and end of each sig
+  // sorting sig so that the tools can use it without sorting
+  chr_block_headsig = ga_sort_chr_block_sig(chr_block_headsig);
+
+  if (shm) {
+    if (ga_write_sigshm (shm, chr_block_headsig) != 0) {
+      LOG("error: error in ga_write_sigshm function.");
+      goto err;
+    }
+    printf("signal store: %s (attach with --sig %s --sigfmt sigshm)\n", shm, shm);
+    if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+    ga_free_chr_dict();
+    return 0;
+  }
+
+  if (fileout) {
+    if (strlen(fileout) + 1 > sizeof(output_name)) {
+      LOG("error: output file name is too long.");
+      goto err;
+    }
+    strcpy(output_name, fileout);
+  } else {
+    ga_parse_file_path (filesig, path_sig, fn_sig, ext_sig); //parsing input file name into path, file name, and extension
+    sprintf(output_name, "%s%s.sigbin", path_sig, fn_sig);
+  }
+
+  if (ga_write_sigbin (output_name, chr_block_headsig) != 0) {
+    LOG("error: error in ga_write_sigbin function.");
+    goto err;
+  }
+  printf("binary signal file: %s\n", output_name);
+
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  ga_free_chr_dict();
+  return 0;
+
+err:
+  if (chr_block_headsig) ga_free_chr_block(&chr_block_headsig);
+  ga_free_chr_dict();
+  return -1;
+}
@@ -7,20 +7,195 @@
 
 #include "parse_chr.h"
 #include "ga_my.h"
+#include "read_gz.h"
+#include "read_bigwig.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
 
 #define LOG(m) \
   fprintf(stderr, \
   "%s:line%d:%s(): " m "\n", \
   __FILE__, __LINE__, __FUNCTION__)
 
-static char *extract_val_line (const char *line, int col, const char sep);
-static struct chr_block *chr_block_add (const char *chr, struct chr_block **chr_block_head);
-static int chr_block_append (const char *chr, struct chr_block **chr_block_head);
+#define FIELD_MAX 16 //max number of fields split from one line of wig
+#define WIG_VARIABLE 1 //variableStep
+#define WIG_FIXED 2 //fixedStep
+#define TEXT_SPLIT_MIN (1 << 20) //min bytes of byte range per thread for parsing one text file
+
+/*
+ * Structure of field.
+ * Span of one column in a line. The line is not copied nor modified, so the span is not null-terminated.
+ */
+struct field {
+  const char *p;
+  int len;
+};
+
+/*
+ * Structure of text source.
+ * Lines are read from a file (through gz reader), or from a byte range which starts at the head of a line,
+ * that is, a part of a mapped file or a chunk of gz reader.
+ */
+struct text_src {
+  struct gz_reader *gz; //file, or NULL for the byte range
+  const char *p; //current position of the byte range
+  const char *ed; //end of the byte range
+};
+
+/*
+ * Structure of text job.
+ * A text file is split into byte ranges at line boundaries, and each range is parsed by one thread into its own chr block list.
+ * parse() reads lines of src into list, so the same parser is used for a file and for a byte range.
+ */
+struct text_job {
+  struct text_src src;
+  struct text_map *map; //mapped file which src points into, or NULL if lines are copied
+  struct chr_block *list; //chr block list of the source
+  int ret; //0 if the source is parsed, otherwise -1
+  int (*parse) (struct text_job *job); //parser of lines
+  const struct region_set *rs; //bedgraph: query regions, or NULL
+  int col_chr, col_st, col_ed, col_strand; //bs: columns
+};
+
+/*
+ * Structure of text pipe.
+ * One thread reads (and inflates) a text file into chunks of whole lines, and parsing threads take the chunks.
+ * job[seq] is the result of chunk seq, which is merged in the order of seq after all chunks are parsed.
+ */
+struct text_pipe {
+  struct gz_reader *gz;
+  const struct text_job *tmpl;
+  struct text_job *job;
+  long job_nb; //number of chunks parsed
+  long job_len; //allocated length of job[]
+  pthread_mutex_t mutex;
+};
+
+/*
+ * Structure of chr index.
+ * Chr blocks of one track addressed by chr ID. blk[id] is NULL if the track doesn't have the chr.
+ * This is used while parsing, so each record finds its chr block without walking the chr block list.
+ */
+struct chr_index {
+  struct chr_block **blk;
+  int len; //allocated length of blk[]
+};
+
+/*
+ * Structure of query region.
+ * Summits (or regions) +- margin on one chr, which are sorted and merged, so regions don't overlap each other.
+ */
+struct region {
+  unsigned long st;
+  unsigned long ed;
+};
+
+/*
+ * Structure of region set.
+ * Query regions of all chrs addressed by chr ID. nb[id] is 0 if the chr is not queried.
+ * Signal loaders skip chrs which are not queried and records which don't overlap any region.
+ */
+struct region_set {
+  struct region **reg; //reg[id] is regions of the chr
+  int *nb; //nb[id] is number of regions of the chr
+  int len; //length of reg[] and nb[]
+};
+
+/*
+ * Structure of sepwiggz job.
+ * wig.gz files are shared by threads. Each file is parsed into its own chr block list, list[i].
+ */
+struct sepwiggz_job {
+  char **file; //file names
+  struct chr_block **list; //list[i] is chr block list of file[i]
+  int *ret; //ret[i] is 0 if file[i] is parsed, otherwise -1
+  int file_nb;
+  int next; //next file to be parsed
+  int inflate_nb; //number of inflate threads per file
+  const struct region_set *rs; //query regions, or NULL
+  pthread_mutex_t mutex;
+};
+
+static struct chr_dict chr_dict = {NULL, 0, 0, NULL, 0}; //chr dictionary shared by all tracks
+static pthread_mutex_t chr_dict_mutex = PTHREAD_MUTEX_INITIALIZER; //chr dictionary is used by parsing threads
+static pthread_mutex_t text_map_mutex = PTHREAD_MUTEX_INITIALIZER; //references of mapped files are taken by parsing threads
+int ga_thread_nb = 4; //number of threads for parsing input files
+int ga_pipe_stat = 0; //if 1, waiting time of reading and parsing threads is printed for each input file
+float ga_half_table[65536]; //value of each 16-bit float, made by ga_quantize_sig
+
+static char *text_gets (struct text_src *src, char *line, const int len);
+static int text_parse (const char *filename, const int hf, struct text_job *tmpl, struct chr_block **chr_block_head);
+static void *text_worker (void *arg);
+static void *text_pipe_worker (void *arg);
+static int text_merge (struct chr_block **chr_block_head, struct text_job *job, const long job_nb);
+static int is_gzip (const int fd);
+static struct text_map *text_map_open (const char *filename);
+static void text_map_hold (struct chr_block *ch, struct text_map *map);
+static void text_map_release (struct text_map *map);
+static void pipe_stat (const char *filename, const struct gz_reader *gz);
+static int bs_lines (struct text_job *job);
+static int bedgraph_lines (struct text_job *job);
+static int split_line (const char *line, const char sep, struct field fld[], const int fld_max);
+static char *field_str (const struct field *f, char *str, const size_t str_len);
+static int field_eq (const struct field *f, const char *str);
+static int field_key (const struct field fld[], const int nf, const char *key, struct field *val);
+static unsigned long field_ul (const struct field *f);
+static float field_f (const struct field *f);
+static int wig_header (const struct field fld[], const int nf, struct chr_block **chr_block_head, struct chr_index *idx, const struct region_set *rs, struct chr_block **ch, unsigned long *st, int *step_val, int *span_val);
+static unsigned int chr_hash (const char *chr);
+static void chr_dict_grow (void);
+static int chr_dict_find (const char *chr);
+static void chr_index_init (struct chr_index *idx, struct chr_block *chr_block_head);
+static void chr_index_set (struct chr_index *idx, struct chr_block *ch);
+static void chr_block_merge (struct chr_block **chr_block_head, struct chr_index *idx, struct chr_block *src);
+static struct chr_block *chr_block_new (const char *chr, struct chr_index *idx);
+static struct chr_block *chr_block_add (const char *chr, struct chr_block **chr_block_head, struct chr_index *idx);
+static struct chr_block *chr_block_append (const char *chr, struct chr_block **chr_block_head, struct chr_index *idx);
 static int chr_block_fa_append (struct chr_block_fa **chr_block_head, const char *chr, const char *letter);
-static struct bs *bs_add (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const char strand, const char *line);
-static struct sig *sig_add (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const float val);
-static int ref_append (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const char strand, const char *ex_st, const char *ex_ed, const char *gene, const char *line);
-static char *pickup_str (const char *str, const int st);
+static void *arena_alloc (struct chr_block *ch, const size_t size);
+static char *arena_strndup (struct chr_block *ch, const char *str, const size_t len);
+static void arena_move (struct chr_block *dst, struct chr_block *src);
+static struct bs *bs_add (struct chr_block *ch, const unsigned long st, const unsigned long ed, const char strand, const char *line, const unsigned int len, struct text_map *map);
+static void sig_add (struct chr_block *ch, const unsigned long st, const unsigned long ed, const float val);
+static void sig_reserve (struct chr_block *ch, const unsigned long nb);
+static void sig_trim (struct chr_block *chr_block_head);
+static void sig_set (struct chr_block *ch, const unsigned long i, const unsigned long st, const unsigned long ed);
+static void sig_resize (struct chr_block *ch, const unsigned long len);
+static void sig_widen (struct chr_block *ch);
+static void sig_attach (struct chr_block *ch, struct text_map *map, const uint64_t *st, const uint64_t *ed, const float *val, const unsigned long nb);
+static void sig_own (struct chr_block *ch);
+static void sig_block_add (struct chr_block *ch, const unsigned long st, const int step, const int span, const float val);
+static void sig_block_check (struct chr_block *chr_block_head);
+static void sig_expand (struct chr_block *ch);
+static int sig_block_sum (const struct chr_block *ch, const unsigned long st, const unsigned long ed, double *sum);
+static double sig_slide_cum (const struct chr_block *ch, unsigned long *k, double *cum, const unsigned long x);
+static uint16_t half_bits (const float f);
+static float half_float (const uint16_t h);
+static int ref_append (struct chr_block *ch, const unsigned long st, const unsigned long ed, const char strand, const struct field *ex_st, const struct field *ex_ed, const struct field *gene, const char *line, const unsigned int len, struct text_map *map);
+static int parse_sig (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, const struct region_set *rs, const int win);
+static void parse_bedgraph (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs);
+static void parse_sepwiggz (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs);
+static int parse_wiggz_file (const char *filename, struct chr_block **chr_block_head, const int inflate_nb, const struct region_set *rs);
+static void *sepwiggz_worker (void *arg);
+static void parse_onewiggz (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs);
+static int parse_sigbin (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs, const int shm);
+static int sigbin_fit (const uint64_t offset, const uint64_t nb, const uint64_t size, const uint64_t len);
+static int parse_bigwig (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs, const int win);
+static struct region_set *region_set_new (struct chr_block *region_head[], const int region_nb, const long margin);
+static void region_set_free (struct region_set *rs);
+static int region_chr (const struct region_set *rs, const char *chr);
+static int region_hit (const struct region_set *rs, const int id, const unsigned long st, const unsigned long ed);
+static int region_find (const struct region *reg, const int nb, const unsigned long st);
+static int region_make (struct chr_block *rc, const long margin, struct region **reg, int *reg_len, int nb);
+static int region_merge (struct region *reg, const int nb);
+static int region_cmp (const void *a, const void *b);
+static int bw_block_cmp (const void *a, const void *b);
 
 /*pointer which must be freed: char *ga_header_line */
 /*
@@ -34,18 +209,108 @@ static char *pickup_str (const char *str, const int st);
  * hf: header flag. If 1, header is obtained from the first line of input file and pointed by global variable, ga_header_line.
  */
 void ga_parse_chr_bs (const char *filename, struct chr_block **chr_block_head, int col_chr, int col_st, int col_ed, int col_strand, int hf)
+{
+  struct text_job job;
+
+  memset(&job, 0, sizeof(job));
+  job.parse = bs_lines;
+  job.col_chr = col_chr;
+  job.col_st = col_st;
+  job.col_ed = col_ed;
+  job.col_strand = col_strand;
+  text_parse (filename, hf, &job, chr_block_head);
+}
+
+/*pointer which must be freed: ch->arena */
+/*
+ * This parses lines of bs file into job->list. Columns are given by job->col_*.
+ * If job->map is given, lines of bs point into the mapping instead of being copied.
+ * *job: pointer to struct text_job
+ * This returns 0 if all lines are parsed, otherwise -1.
+ */
+static int bs_lines (struct text_job *job)
+{
+  char line[LINE_STR_LEN] = {0}, chr[LINE_STR_LEN] = {0};
+  const char *at; //head of the line in the mapping
+  struct field *fld = NULL;
+  struct chr_block *ch = NULL;
+  struct chr_index idx;
+  int col_max;
+
+  col_max = job->col_chr; //the line is split up to the right most column which is used
+  if (job->col_st > col_max) col_max = job->col_st;
+  if (job->col_ed > col_max) col_max = job->col_ed;
+  if (job->col_strand > col_max) col_max = job->col_strand;
+  fld = my_malloc(sizeof(struct field) * (col_max + 1));
+  chr_index_init (&idx, job->list);
+
+  for (at = job->src.p; text_gets(&job->src, line, LINE_STR_LEN * sizeof(char)) != NULL; at = job->src.p) {
+    if (strlen(line) >= LINE_STR_LEN -1) {
+      LOG("errer: line length is too long.");
+      goto err;
+    }
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (split_line(line, '\t', fld, col_max + 1) <= col_max) { //splitting chr, start, end positions (and strand)
+      LOG("error: column number is out of range.");
+      goto err;
+    }
+    if (ch == NULL || !field_eq(&fld[job->col_chr], ch->chr)) { //the chr block of the previous line is used as it is if chr is the same
+      ch = chr_block_add (field_str(&fld[job->col_chr], chr, sizeof(chr)), &job->list, &idx); //adding chr link list (if the chr is already linked, the linked one is returned)
+    }
+    if (job->col_strand >= 0 && fld[job->col_strand].len) {
+      bs_add (ch, field_ul(&fld[job->col_st]), field_ul(&fld[job->col_ed]), fld[job->col_strand].p[0], job->map ? at : line, strlen(line), job->map); //adding bs with strand info
+    } else {
+      bs_add (ch, field_ul(&fld[job->col_st]), field_ul(&fld[job->col_ed]), '.', job->map ? at : line, strlen(line), job->map); //adding bs
+    }
+  }
+
+  MYFREE(idx.blk);
+  MYFREE(fld);
+  return 0;
+
+err:
+  MYFREE(idx.blk);
+  MYFREE(fld);
+  return -1;
+}
+
+/*pointer which must be freed: char *ga_header_line */
+/*
+ * This parses a text file with job->parse.
+ * Plain file is mapped, and if it is large enough, it is split into byte ranges at line boundaries, and the ranges are parsed by ga_thread_nb threads.
+ * Otherwise (gzip or pipe), one thread reads the file into chunks of whole lines and ga_thread_nb - 1 threads parse the chunks.
+ * Chr block lists of the ranges (or chunks) are merged in the file order, so the result is the same as parsing the file on one thread.
+ * *filename       : input file name
+ * hf              : header flag. If 1, header is obtained from the first line of input file and pointed by global variable, ga_header_line.
+ * *tmpl           : template of struct text_job. parse and its parameters are copied to each job.
+ * **chr_block_head: pointer of pointer to struct chr_block.
+ * This returns 0 if the file is parsed, otherwise -1.
+ */
+static int text_parse (const char *filename, const int hf, struct text_job *tmpl, struct chr_block **chr_block_head)
 {
   char line[LINE_STR_LEN] = {0};
-  char *chr, *st, *ed, *strand, *e;
-  FILE *fp;
-  if ((fp = fopen (filename, "r")) == NULL) {
+  struct text_src src = {NULL, NULL, NULL};
+  struct text_job *job = NULL;
+  struct text_pipe pipe;
+  struct text_map *map = NULL;
+  pthread_t *th = NULL;
+  const char *p;
+  long thread_nb = 1;
+  int i, ret = 0;
+
+  if ((map = text_map_open (filename)) != NULL) { //plain text is mapped
+    src.p = map -> p;
+    src.ed = map -> p + map -> len;
+    thread_nb = map -> len / TEXT_SPLIT_MIN;
+    if (thread_nb > ga_thread_nb) thread_nb = ga_thread_nb;
+    if (thread_nb < 1) thread_nb = 1;
+  } else if ((src.gz = ga_gz_open (filename, ga_thread_nb > 1 ? 1 : 0)) == NULL) {
     LOG("errer: input file cannot be open.");
-//    goto err;
     exit(EXIT_FAILURE);
   }
 
   if (hf) {
-    if (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
+    if (text_gets(&src, line, LINE_STR_LEN * sizeof(char)) != NULL) {
       if (strlen(line) >= LINE_STR_LEN -1) {
         LOG("errer: line length is too long.");
         goto err;
@@ -56,34 +321,262 @@ void ga_parse_chr_bs (const char *filename, struct chr_block **chr_block_head, i
     }
   }
 
-  while (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
-    if (strlen(line) >= LINE_STR_LEN -1) {
-      LOG("errer: line length is too long.");
-      goto err;
+  if (map ? thread_nb == 1 : ga_thread_nb <= 2) { //parsing on this thread
+    tmpl -> src = src;
+    tmpl -> map = map;
+    tmpl -> list = *chr_block_head;
+    ret = tmpl -> parse (tmpl);
+    *chr_block_head = tmpl -> list;
+  } else if (map == NULL) { //parsing chunks on threads
+    pipe.gz = src.gz;
+    pipe.tmpl = tmpl;
+    pipe.job = NULL;
+    pipe.job_nb = 0;
+    pipe.job_len = 0;
+    pthread_mutex_init(&pipe.mutex, NULL);
+    thread_nb = ga_thread_nb - 1; //one thread reads the file
+    th = (pthread_t *)my_malloc(thread_nb * sizeof(pthread_t));
+    for (i = 0; i < thread_nb; i++) {
+      if (pthread_create(&th[i], NULL, text_pipe_worker, &pipe) != 0) {
+        LOG("error: thread cannot be created.");
+        exit(EXIT_FAILURE);
+      }
     }
-    if (line[0] == '#') continue;
-    chr = extract_val_line(line, col_chr, '\t'); //extracting chr, start, end positions
-    st  = extract_val_line(line, col_st , '\t');
-    ed  = extract_val_line(line, col_ed , '\t');
-    chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
-    if (col_strand >= 0) {
-      strand = extract_val_line(line, col_strand , '\t');
-      bs_add (chr, chr_block_head, strtoul(st, &e, 10), strtoul(ed, &e, 10), strand[0], line); //adding bs with strand info
-      MYFREE(strand);
-    } else {
-      bs_add (chr, chr_block_head, strtoul(st, &e, 10), strtoul(ed, &e, 10), '.', line); //adding bs
+    for (i = 0; i < thread_nb; i++) pthread_join(th[i], NULL);
+    pthread_mutex_destroy(&pipe.mutex);
+    ret = text_merge (chr_block_head, pipe.job, pipe.job_nb);
+    MYFREE(pipe.job);
+  } else { //parsing byte ranges on threads
+    job = (struct text_job *)my_malloc(thread_nb * sizeof(struct text_job));
+    for (i = 0, p = src.p; i < thread_nb; i++) { //ranges end after '\n' of the line across the boundary
+      job[i] = *tmpl;
+      job[i].map = map;
+      job[i].src.gz = NULL;
+      job[i].src.p = p;
+      if (i == thread_nb - 1) p = src.ed;
+      else if (p < src.p + (src.ed - src.p) * (i + 1) / thread_nb) {
+        p = src.p + (src.ed - src.p) * (i + 1) / thread_nb;
+        p = (p = memchr(p, '\n', src.ed - p)) ? p + 1 : src.ed;
+      }
+      job[i].src.ed = p;
+      job[i].list = NULL;
+      job[i].ret = 0;
     }
-    MYFREE(chr);
-    MYFREE(st);
-    MYFREE(ed);
+
+    th = (pthread_t *)my_malloc(thread_nb * sizeof(pthread_t));
+    for (i = 0; i < thread_nb; i++) {
+      if (pthread_create(&th[i], NULL, text_worker, &job[i]) != 0) {
+        LOG("error: thread cannot be created.");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (i = 0; i < thread_nb; i++) pthread_join(th[i], NULL);
+    ret = text_merge (chr_block_head, job, thread_nb);
+    MYFREE(job);
   }
 
-  fclose(fp);
-  return;
+  MYFREE(th);
+  if (map) text_map_release (map); //the mapping is kept if bs point into it
+  if (src.gz) {
+    pipe_stat (filename, src.gz);
+    if (ga_gz_close(src.gz) != 0) {
+      LOG("error: error in inflating the input file.");
+      ret = -1;
+    }
+  }
+  return ret;
 
 err:
-  fclose(fp);
-  return;
+  if (map) text_map_release (map);
+  if (src.gz) ga_gz_close(src.gz);
+  return -1;
+}
+
+/*
+ * This merges chr block lists of jobs into chr_block_head in the order of jobs.
+ * Lists after the job of error are not used, as if parsing stopped at the error.
+ * This returns 0, or -1 if a job had error.
+ */
+static int text_merge (struct chr_block **chr_block_head, struct text_job *job, const long job_nb)
+{
+  struct chr_index idx;
+  long i;
+  int ret = 0;
+
+  chr_index_init (&idx, *chr_block_head);
+  for (i = 0; i < job_nb; i++) {
+    if (ret == 0) chr_block_merge (chr_block_head, &idx, job[i].list);
+    else ga_free_chr_block (&job[i].list);
+    if (job[i].ret != 0) ret = -1;
+  }
+  MYFREE(idx.blk);
+
+  return ret;
+}
+
+/*
+ * This is the thread function of text_parse. It parses one byte range.
+ * *arg: pointer to struct text_job
+ */
+static void *text_worker (void *arg)
+{
+  struct text_job *job = (struct text_job *)arg;
+
+  job->ret = job->parse (job);
+  return NULL;
+}
+
+/*
+ * This is the thread function of text_parse for chunks. It takes the next chunk until all chunks are parsed.
+ * *arg: pointer to struct text_pipe
+ */
+static void *text_pipe_worker (void *arg)
+{
+  struct text_pipe *pipe = (struct text_pipe *)arg;
+  struct text_job job;
+  struct gz_chunk c;
+  long seq, len;
+
+  while (ga_gz_chunk(pipe->gz, &c, &seq) == 0) {
+    job = *pipe->tmpl;
+    job.map = NULL; //chunks are freed after parsing
+    job.src.gz = NULL;
+    job.src.p = c.buf;
+    job.src.ed = c.buf + c.len;
+    job.list = NULL;
+    job.ret = job.parse (&job);
+    MYFREE(c.buf);
+
+    pthread_mutex_lock(&pipe->mutex);
+    if (seq >= pipe->job_len) { //growing job[]
+      len = pipe->job_len;
+      pipe->job_len = 2 * (seq + 1);
+      pipe->job = (struct text_job *)my_realloc(pipe->job, pipe->job_len * sizeof(struct text_job));
+      memset(pipe->job + len, 0, (pipe->job_len - len) * sizeof(struct text_job));
+    }
+    pipe->job[seq] = job;
+    if (seq >= pipe->job_nb) pipe->job_nb = seq + 1;
+    pthread_mutex_unlock(&pipe->mutex);
+  }
+
+  return NULL;
+}
+
+/*
+ * This returns 1 if the file starts with gzip magic number. The file position is not changed.
+ */
+static int is_gzip (const int fd)
+{
+  unsigned char h[2];
+
+  return (pread(fd, h, 2, 0) == 2 && h[0] == 0x1f && h[1] == 0x8b);
+}
+
+/*pointer which must be freed: struct text_map *m (by text_map_release) */
+/*
+ * This maps plain text file. The caller holds the first reference.
+ * This returns NULL if the file cannot be mapped (gzip, pipe, empty file, or error), and then the file is read through gz reader.
+ */
+static struct text_map *text_map_open (const char *filename)
+{
+  struct text_map *m;
+  struct stat sb;
+  char *p;
+  int fd;
+
+  if (stat(filename, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0) return NULL;
+  if ((fd = open (filename, O_RDONLY)) < 0) return NULL;
+  if (is_gzip(fd) || (p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  m = (struct text_map *)my_malloc(sizeof(struct text_map));
+  m -> p = p;
+  m -> len = sb.st_size;
+  m -> ref = 1;
+
+  return m;
+}
+
+/*
+ * This makes chr block hold a reference to the mapping, so lines of its records can point into the mapping.
+ * The reference is held by an empty arena chunk, which is moved and freed with the other chunks.
+ */
+static void text_map_hold (struct chr_block *ch, struct text_map *map)
+{
+  struct arena_chunk *c;
+
+  if (ch -> map == map) return; //the chr block already holds it
+  pthread_mutex_lock(&text_map_mutex);
+  map -> ref++;
+  pthread_mutex_unlock(&text_map_mutex);
+
+  c = (struct arena_chunk *)my_malloc(sizeof(struct arena_chunk));
+  c -> len = 0;
+  c -> used = 0;
+  c -> map = map;
+  if (ch -> arena) { //the head is kept for bump allocation
+    c -> next = ch -> arena -> next;
+    ch -> arena -> next = c;
+  } else {
+    c -> next = NULL;
+    ch -> arena = c;
+  }
+  ch -> map = map;
+}
+
+/*
+ * This releases a reference to the mapping, and unmaps it if it was the last one.
+ */
+static void text_map_release (struct text_map *map)
+{
+  int ref;
+
+  pthread_mutex_lock(&text_map_mutex);
+  ref = --map -> ref;
+  pthread_mutex_unlock(&text_map_mutex);
+  if (ref > 0) return;
+
+  munmap(map -> p, map -> len);
+  MYFREE(map);
+}
+
+/*
+ * This prints waiting time of the reading thread and the parsing thread(s) if ga_pipe_stat is 1.
+ * If the reading thread waited, parsing is the bottleneck, and vice versa.
+ */
+static void pipe_stat (const char *filename, const struct gz_reader *gz)
+{
+  if (!ga_pipe_stat || !gz->thread_nb) return;
+  fprintf(stderr, "%s: reading thread waited %.3f s for parsing, parsing thread(s) waited %.3f s for reading\n", filename, gz->wait_put, gz->wait_get);
+}
+
+/*
+ * This reads one line from text source like fgets.
+ * At most len - 1 chars are read, and reading stops after '\n'.
+ * *src: pointer to struct text_src
+ * *line: buffer which receives the null-terminated line
+ * len : size of line
+ * This returns line, or NULL at the end of the source.
+ */
+static char *text_gets (struct text_src *src, char *line, const int len)
+{
+  const char *nl;
+  size_t n;
+
+  if (src->gz) return ga_gz_gets(src->gz, line, len);
+  if (src->p >= src->ed) return NULL;
+
+  n = (size_t)(src->ed - src->p);
+  if (n > (size_t)len - 1) n = (size_t)len - 1;
+  if ((nl = memchr(src->p, '\n', n)) != NULL) n = (size_t)(nl - src->p) + 1;
+  memcpy(line, src->p, n);
+  line[n] = '\0';
+  src->p += n;
+
+  return line;
 }
 
 /*pointer which must be freed: char *ga_header_line */
@@ -102,16 +595,35 @@ err:
  */
 int ga_parse_chr_ref (const char *filename, struct chr_block **chr_block_head, int col_chr, int col_st, int col_ed, int col_strand, int col_ex_st, int col_ex_ed, int col_gene, int hf)
 {
-  char line[LINE_STR_LEN] = {0};
-  char *chr, *st, *ed, *strand, *ex_st, *ex_ed, *gene, *e;
-  FILE *fp;
-  if ((fp = fopen (filename, "r")) == NULL) {
+  char line[LINE_STR_LEN] = {0}, chr[LINE_STR_LEN] = {0};
+  struct field *fld = NULL;
+  struct chr_block *ch = NULL;
+  struct chr_index idx;
+  int col_max;
+  struct text_src src = {NULL, NULL, NULL};
+  struct text_map *map;
+  const char *at; //head of the line in the mapping
+
+  if ((map = text_map_open (filename)) != NULL) { //plain text is mapped, so lines of ref point into it
+    src.p = map -> p;
+    src.ed = map -> p + map -> len;
+  } else if ((src.gz = ga_gz_open (filename, ga_thread_nb > 1 ? 1 : 0)) == NULL) { //reading on its own thread
     LOG("errer: input file cannot be open.");
     exit(EXIT_FAILURE);
   }
 
+  col_max = col_chr; //the line is split up to the right most column which is used
+  if (col_st > col_max) col_max = col_st;
+  if (col_ed > col_max) col_max = col_ed;
+  if (col_strand > col_max) col_max = col_strand;
+  if (col_ex_st > col_max) col_max = col_ex_st;
+  if (col_ex_ed > col_max) col_max = col_ex_ed;
+  if (col_gene > col_max) col_max = col_gene;
+  fld = my_malloc(sizeof(struct field) * (col_max + 1));
+  chr_index_init (&idx, *chr_block_head);
+
   if (hf) {
-    if (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
+    if (text_gets(&src, line, LINE_STR_LEN * sizeof(char)) != NULL) {
       if (strlen(line) >= LINE_STR_LEN -1) {
         LOG("errer: line length is too long.");
         goto err;
@@ -122,56 +634,53 @@ int ga_parse_chr_ref (const char *filename, struct chr_block **chr_block_head, i
     }
   }
 
-  while (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
+  for (at = src.p; text_gets(&src, line, LINE_STR_LEN * sizeof(char)) != NULL; at = src.p) {
     if (strlen(line) >= LINE_STR_LEN -1) {
       LOG("errer: line length is too long.");
       goto err;
     }
-    if (line[0] == '#') continue;
-    chr = extract_val_line(line, col_chr, '\t'); //extracting chr, start, end, ex_st, ex_ed positions
-    st  = extract_val_line(line, col_st , '\t');
-    ed  = extract_val_line(line, col_ed , '\t');
-    ex_st  = extract_val_line(line, col_ex_st , '\t');
-    ex_ed  = extract_val_line(line, col_ex_ed , '\t');
-    gene = extract_val_line(line, col_gene , '\t');
-    if(chr_block_append (chr, chr_block_head) != 0){ //appending chr link list (if the chr is already linked, the input chr is just ignored)
-      LOG("error: error in chr_block_append function.");
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (split_line(line, '\t', fld, col_max + 1) <= col_max) { //splitting chr, start, end, ex_st, ex_ed positions and so on
+      LOG("error: column number is out of range.");
       goto err;
     }
+    if (ch == NULL || !field_eq(&fld[col_chr], ch->chr)) { //the chr block of the previous line is used as it is if chr is the same
+      if((ch = chr_block_append (field_str(&fld[col_chr], chr, sizeof(chr)), chr_block_head, &idx)) == NULL){ //appending chr link list (if the chr is already linked, the linked one is returned)
+        LOG("error: error in chr_block_append function.");
+        goto err;
+      }
+    }
 
-    if (col_strand >= 0) {
-      strand = extract_val_line(line, col_strand , '\t');
-      if (ref_append (chr, chr_block_head, strtoul(st, &e, 10), strtoul(ed, &e, 10), strand[0], ex_st, ex_ed, gene, line) != 0){ //appending ref
+    if (col_strand >= 0 && fld[col_strand].len) {
+      if (ref_append (ch, field_ul(&fld[col_st]), field_ul(&fld[col_ed]), fld[col_strand].p[0], &fld[col_ex_st], &fld[col_ex_ed], &fld[col_gene], map ? at : line, strlen(line), map) != 0){ //appending ref
         LOG("error: error in ref_append function.");
         goto err;
       }
-      MYFREE(strand);
     } else {
-      if (ref_append (chr, chr_block_head, strtoul(st, &e, 10), strtoul(ed, &e, 10), '.', ex_st, ex_ed, gene, line) != 0){ //appending ref
+      if (ref_append (ch, field_ul(&fld[col_st]), field_ul(&fld[col_ed]), '.', &fld[col_ex_st], &fld[col_ex_ed], &fld[col_gene], map ? at : line, strlen(line), map) != 0){ //appending ref
         LOG("error: error in ref_append function.");
         goto err;
       }
     }
-    MYFREE(chr);
-    MYFREE(st);
-    MYFREE(ed);
-    MYFREE(ex_st);
-    MYFREE(ex_ed);
-    MYFREE(gene);
   }
 
-  fclose(fp);
+  MYFREE(idx.blk);
+  MYFREE(fld);
+  if (map) text_map_release (map); //the mapping is kept if ref point into it
+  if (src.gz) {
+    pipe_stat (filename, src.gz);
+    if (ga_gz_close(src.gz) != 0) {
+      LOG("error: error in inflating the input file.");
+      return -1;
+    }
+  }
   return 0;
 
 err:
-  fclose(fp);
-  MYFREE(chr);
-  MYFREE(st);
-  MYFREE(ed);
-  MYFREE(ex_st);
-  MYFREE(ex_ed);
-  MYFREE(gene);
-  MYFREE(strand);
+  MYFREE(idx.blk);
+  MYFREE(fld);
+  if (map) text_map_release (map);
+  if (src.gz) ga_gz_close(src.gz);
   return -1;
 }
 
@@ -185,16 +694,17 @@ err:
 int ga_parse_chr_fa (const char *filename, struct chr_block_fa **chr_block_head, struct chr_block *chr_block_head_gt)
 {
   char line[LINE_STR_LEN] = {0}, chr_tmp[LINE_STR_LEN] = {0}, *letter = NULL;
-  int i, init=0;
+  int i, id, init=0;
   unsigned long j = 0; //for letter position
-  struct chr_block *ch;
-  FILE *fp;
-  if ((fp = fopen (filename, "r")) == NULL) {
+  struct chr_block *ch, **gt_idx = NULL;
+  struct gz_reader *gfp;
+  if ((gfp = ga_gz_open (filename, ga_thread_nb > 1 ? 1 : 0)) == NULL) { //reading on its own thread
     LOG("errer: input file cannot be open.");
     exit(EXIT_FAILURE);
   }
+  gt_idx = ga_index_chr_block (chr_block_head_gt); //genome table addressed by chr ID
 
-  while (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
+  while (ga_gz_gets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) {
     if (strlen(line) >= LINE_STR_LEN -1) {
       LOG("errer: line length is too long.");
       goto err;
@@ -222,9 +732,7 @@ int ga_parse_chr_fa (const char *filename, struct chr_block_fa **chr_block_head,
       }
       chr_tmp[i] = '\0'; //null
 
-      for (ch = chr_block_head_gt; ch; ch = ch->next) {
-        if (!(strcmp(ch->chr, chr_tmp))) break;
-      }
+      ch = ((id = ga_chr_find(chr_tmp)) >= 0) ? gt_idx[id] : NULL;
       if (ch == NULL) {
         printf("error: chromosome '%s' is not found in genome table file.\n", chr_tmp);
         goto err;
@@ -267,13 +775,19 @@ int ga_parse_chr_fa (const char *filename, struct chr_block_fa **chr_block_head,
     goto err;
   }
 
+  MYFREE(gt_idx);
   MYFREE(letter);
-  fclose(fp);
+  pipe_stat (filename, gfp);
+  if (ga_gz_close(gfp) != 0) {
+    LOG("error: error in inflating the input file.");
+    return -1;
+  }
   return 0;
 
 err:
+  MYFREE(gt_idx);
   MYFREE(letter);
-  fclose(fp);
+  ga_gz_close(gfp);
   return -1;
 }
 
@@ -287,37 +801,43 @@ void ga_parse_chr_bs_rand (struct chr_block **chr_block_head, struct chr_block *
 {
   unsigned long i;
   int rvalue;
-  struct chr_block *ch, *c_table;
+  struct chr_block *ch, *c_table, *p, **table_idx;
+  struct chr_index idx;
   clock_t cl;
 
   cl=clock();
   srand((unsigned)time(NULL)*cl); //seeds
 
+  table_idx = ga_index_chr_block (chr_table); //genome table addressed by chr ID
+  chr_index_init (&idx, *chr_block_head);
+
   for (ch = chr_block_head_ori; ch; ch = ch -> next) {
-    for (c_table = chr_table; c_table; c_table = c_table -> next) { //checking ch is in c_table
-      if (!strcmp(ch->chr, c_table->chr)) break;
-    }
+    c_table = table_idx[ch->id]; //checking ch is in c_table
 
     if (c_table == NULL) {
       LOG("error: chr is not in the genome table.");
       goto err;
     }
 
-    chr_block_add (ch->chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
+    p = chr_block_add (ch->chr, chr_block_head, &idx); //adding chr link list (if the chr is already linked, the linked one is returned)
     for (i=0; i < ch->bs_nb; i++) {
       rvalue = (rand()) % (c_table->bs_list->st - hw) + hw + 1; //rvalue must be 1-chr length
       if (rvalue % 2) {
-        bs_add (ch->chr, chr_block_head, rvalue, rvalue, '+', "."); //adding bs
+        bs_add (p, rvalue, rvalue, '+', ".", 1, NULL); //adding bs
       }
       else {
-        bs_add (ch->chr, chr_block_head, rvalue, rvalue, '-', ".");
+        bs_add (p, rvalue, rvalue, '-', ".", 1, NULL);
       }
     }
   }
 
+  MYFREE(idx.blk);
+  MYFREE(table_idx);
   return;
 
 err:
+  MYFREE(idx.blk);
+  MYFREE(table_idx);
   return;
 }
 
@@ -328,203 +848,712 @@ err:
  */
 void ga_parse_bedgraph (const char *filename, struct chr_block **chr_block_head)
 {
-  char line[LINE_STR_LEN] = {0};
-  char *chr, *st, *ed, *val, *e;
-  FILE *fp;
-  if ((fp = fopen (filename, "r")) == NULL) {
-    LOG("errer: input file cannot be open.");
-//    goto err;
-    exit(EXIT_FAILURE);
-  }
+  parse_bedgraph (filename, chr_block_head, NULL);
+}
 
-  while (fgets(line, LINE_STR_LEN * sizeof(char), fp) != NULL) {
-    if (strlen(line) >= LINE_STR_LEN -1) {
-      LOG("errer: line length is too long.");
-      goto err;
-    }
-    if (line[0] == '#') continue;
-    chr = extract_val_line(line, 0, '\t'); //extracting chr, start, end positions and val
-    st  = extract_val_line(line, 1, '\t');
-    ed  = extract_val_line(line, 2, '\t');
-    val = extract_val_line(line, 3, '\t');
-    chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
-    sig_add (chr, chr_block_head, strtoul(st, &e, 10), strtoul(ed, &e, 10), atof(val)); //adding bs
-    MYFREE(chr);
-    MYFREE(st);
-    MYFREE(ed);
-    MYFREE(val);
-  }
-
-  fclose(fp);
-  return;
+/*
+ * This parses bedgraph. Lines of chrs which are not queried are skipped before their positions are parsed.
+ * *filename       : input file name
+ * **chr_block_head: pointer of pointer to struct chr_block.
+ * *rs             : query regions, or NULL for all lines
+ */
+static void parse_bedgraph (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs)
+{
+  struct text_job job;
 
-err:
-  fclose(fp);
-  return;
+  memset(&job, 0, sizeof(job));
+  job.parse = bedgraph_lines;
+  job.rs = rs;
+  text_parse (filename, 0, &job, chr_block_head);
 }
 
-/*pointer which must be freed: char *strtemp */
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
 /*
- * This extract a value from tab-delimited line
- * *line: input line
- * col  : column number for extraction
- * sep  : char that separates *line. Ex ' ' or '\t'.
+ * This parses lines of bedgraph into job->list.
+ * *job: pointer to struct text_job. Lines out of job->rs are skipped.
+ * This returns 0 if all lines are parsed, otherwise -1.
  */
-static char *extract_val_line (const char *line, int col, const char sep) {
-  int x = 0, i = 0, j = 0;
-  int len = strlen(line);
-  
-  char *strtemp = (char *)my_calloc (len, sizeof(char));
+static int bedgraph_lines (struct text_job *job)
+{
+  char line[LINE_STR_LEN] = {0}, chr[LINE_STR_LEN] = {0};
+  unsigned long st, ed;
+  int skip = 0;
+  struct field fld[4];
+  struct chr_block *ch = NULL;
+  struct chr_index idx;
+  const struct region_set *rs = job->rs;
+
+  chr_index_init (&idx, job->list);
 
-  while (line[i] != '\0' && line[i] != '\n' && x <= col) {
-    if (line[i] == sep) {
-      i++;
-      x++;
+  while (text_gets(&job->src, line, LINE_STR_LEN * sizeof(char)) != NULL) {
+    if (strlen(line) >= LINE_STR_LEN -1) {
+      LOG("errer: line length is too long.");
+      goto err;
     }
-    else if (col == x) { //copying the value
-      strtemp[j++] = line[i++];
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (split_line(line, '\t', fld, 4) < 4) { //splitting chr, start, end positions and val
+      LOG("error: column number is out of range.");
+      goto err;
     }
-    else {
-      i++;
+    if (chr[0] == '\0' || !field_eq(&fld[0], chr)) { //the chr block of the previous line is used as it is if chr is the same
+      field_str(&fld[0], chr, sizeof(chr));
+      skip = !region_chr (rs, chr);
+      ch = skip ? NULL : chr_block_add (chr, &job->list, &idx); //adding chr link list (if the chr is already linked, the linked one is returned)
     }
-  }
-  strtemp[j] = '\0';
+    if (skip) continue; //the chr is not queried
 
-  if (!strlen(strtemp)) {
-    LOG("error: column number is out of range.");
-    goto err;
+    st = field_ul(&fld[1]);
+    ed = field_ul(&fld[2]);
+    if (rs && !region_hit (rs, ch->id, st, ed)) continue;
+    sig_add (ch, st, ed, field_f(&fld[3])); //adding bs
   }
 
-  return (strtemp);
+  MYFREE(idx.blk);
+  return 0;
 
 err:
-  MYFREE(strtemp);
-  return (NULL);
+  MYFREE(idx.blk);
+  return -1;
 }
 
-/*pointer which must be freed: struct chr_block *p, p->chr*/
 /*
- * This adds new struct chr_block list
- * *chr: pointer to chromosome name
- * **chr_block_head: pointer of pointer to the head of the link
+ * This splits a line into fields in one pass without copying.
+ * Splitting stops at the end of line ('\n' or '\0') or when fld_max fields are obtained, so the last field does not contain the remaining columns.
+ * *line  : input line
+ * sep    : char that separates *line. Ex ' ' or '\t'.
+ * fld[]  : array of struct field which receives the spans
+ * fld_max: size of fld[]
+ * This returns the number of fields obtained.
  */
-static struct chr_block *chr_block_add (const char *chr, struct chr_block **chr_block_head)
+static int split_line (const char *line, const char sep, struct field fld[], const int fld_max)
 {
-  struct chr_block *p;
-  struct chr_block *ch;
-
-  for (ch = *chr_block_head; ch; ch = ch->next) {//checking chr is already in chr_block list
-    if (!strcmp(chr, ch->chr)) return (NULL);
+  const char *p = line;
+  int nf = 0;
+
+  while (nf < fld_max) {
+    fld[nf].p = p;
+    while (*p != sep && *p != '\n' && *p != '\0') p++;
+    fld[nf].len = (int)(p - fld[nf].p);
+    nf++;
+    if (*p != sep) break; //end of line
+    p++;
   }
 
-  p = my_malloc(sizeof(struct chr_block));
-  p -> chr = strdup(chr); //assigning chromosome name
-
-  /*initialization of bs and sig block*/
-  p -> bs_init = 0;
-  p -> sig_init = 0;
-  p -> ref_init = 0;
+  return nf;
+}
 
-  p -> next = *chr_block_head; //adding new chr block
-  *chr_block_head = p;
+/*
+ * This copies a field into null-terminated string.
+ * *f     : pointer to struct field
+ * *str   : buffer which receives the string. The string is truncated if it is longer than the buffer.
+ * str_len: size of str
+ */
+static char *field_str (const struct field *f, char *str, const size_t str_len)
+{
+  size_t len = (size_t)f->len < str_len ? (size_t)f->len : str_len - 1;
 
-  return (p);
+  memcpy(str, f->p, len);
+  str[len] = '\0';
+  return str;
+}
 
+/*
+ * This returns 1 if the field is the same as str, otherwise 0.
+ */
+static int field_eq (const struct field *f, const char *str)
+{
+  return (strlen(str) == (size_t)f->len && !memcmp(f->p, str, f->len));
 }
 
-/*pointer which must be freed: struct chr_block *p, p->chr*/
 /*
- * This appends new struct chr_block list
- * *chr: pointer to chromosome name
- * **chr_block_head: pointer of pointer to the head of the link
+ * This finds "key=value" field such as "chrom=chr1" in wig header, and gives the span of value.
+ * fld[]: fields of header line. fld[0] is "variableStep" or "fixedStep", so it is not searched.
+ * nf   : number of fields
+ * *key : key such as "chrom"
+ * *val : pointer to struct field which receives the value
+ * This returns 0 if key is found, otherwise -1.
  */
-static int chr_block_append (const char *chr, struct chr_block **chr_block_head)
+static int field_key (const struct field fld[], const int nf, const char *key, struct field *val)
 {
-  struct chr_block *p;
-  struct chr_block *ch;
+  int i, len = strlen(key);
 
-  for (ch = *chr_block_head; ch; ch = ch->next) {//checking chr is already in chr_block list
-    if (!strcmp(chr, ch->chr)) return 0;
+  for (i = 1; i < nf; i++) {
+    if (fld[i].len > len && fld[i].p[len] == '=' && !memcmp(fld[i].p, key, len)) {
+      val -> p = fld[i].p + len + 1;
+      val -> len = fld[i].len - len - 1;
+      return 0;
+    }
   }
 
-  p = my_malloc(sizeof(struct chr_block));
-  p -> chr = strdup(chr); //assigning chromosome name
+  return -1;
+}
 
-  /*initialization of bs and sig block*/
-  p -> bs_init = 0;
-  p -> sig_init = 0;
-  p -> ref_init = 0;
+/*
+ * This parses a field as decimal unsigned long like strtoul(str, &e, 10).
+ * Plain digits are converted directly, and the others (sign, space, etc.) are left to strtoul.
+ */
+static unsigned long field_ul (const struct field *f)
+{
+  char tmp[64];
+  unsigned long v = 0;
+  int i;
 
-  if (*chr_block_head == NULL) { //if chromosome is the first one
-    *chr_block_head = p;
-  } else {
-    (*chr_block_head) -> tail -> next = p; //if not parenthesis, *chr_block_head -> tail means "tail pointer" of "pointer of pointer chr_block_head", not "tail pointer" of "pointer of *chr_block_head"
+  if (f->len == 0 || f->len > 19) goto slow; //up to 19 digits never overflow
+  for (i = 0; i < f->len; i++) {
+    if (f->p[i] < '0' || f->p[i] > '9') goto slow;
+    v = v * 10 + (f->p[i] - '0');
   }
+  return v;
 
-  (*chr_block_head) -> tail = p;
-  p -> next = NULL;
-
-  return 0;
-
+slow:
+  return strtoul(field_str(f, tmp, sizeof(tmp)), NULL, 10);
 }
 
-/*pointer which must be freed: p(if needed), p->chr, p->letter*/
 /*
- * This appends new struct chr_block_fa list
- * **chr_block_head: pointer of pointer to the head of the link(structure chr_block_fa)
- * *chr: pointer to chromosome name
- * *letter: pointer to letter
+ * This parses a field as float like (float)atof(str).
+ * A number like "-12.345" with at most 15 digits is exactly held by double, and 10^n (n <= 15) as well,
+ * so one division gives the correctly rounded value which is the same as atof.
+ * The others (exponent, nan, long digits, etc.) are left to atof.
  */
-static int chr_block_fa_append (struct chr_block_fa **chr_block_head, const char *chr, const char *letter)
+static float field_f (const struct field *f)
 {
-  struct chr_block_fa *p;
-
-  p = my_malloc(sizeof(struct chr_block_fa));
-  p -> chr = strdup(chr); //assigning chromosome name
-  p -> letter = strdup(letter); //assigning letter for chromosome
-  p -> letter_len = (unsigned long)strlen(letter); //storing letter length
-  
-  if (*chr_block_head == NULL) { //if chromosome is the first one
-    *chr_block_head = p;
-  } else {
-    (*chr_block_head) -> tail -> next = p; //if not parenthesis, *chr_block_head -> tail means "tail pointer" of "pointer of pointer chr_block_head", not "tail pointer" of "pointer of *chr_block_head"
+  static const double pow10_tab[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+  char tmp[64];
+  unsigned long long m = 0; //mantissa
+  double v;
+  int i = 0, neg = 0, dig = 0, frac = 0, dot = 0;
+
+  if (i < f->len && (f->p[i] == '-' || f->p[i] == '+')) {
+    neg = (f->p[i] == '-');
+    i++;
+  }
+  for (; i < f->len; i++) {
+    if (f->p[i] >= '0' && f->p[i] <= '9') {
+      m = m * 10 + (f->p[i] - '0');
+      dig++;
+      if (dot) frac++;
+    } else if (f->p[i] == '.' && !dot) {
+      dot = 1;
+    } else {
+      goto slow;
+    }
   }
+  if (dig == 0 || dig > 15) goto slow;
 
-  (*chr_block_head) -> tail = p;
-  p -> next = NULL;
+  v = (double)m / pow10_tab[frac];
+  return (float)(neg ? -v : v);
 
-  return 0;
+slow:
+  return (float)atof(field_str(f, tmp, sizeof(tmp)));
 }
 
-/*pointer which must be freed: struct bs *p, p->line, */
 /*
- * This adds new struct bs list
- * *chr: pointer to chr name
- * **chr_block_head: pointer of pointer to the head of the link
- * st: start position
- * ed: end position
- * strand: strand either '+', '-' or '.'.
- * *line: pointer to each line which is read
+ * This returns FNV-1a hash of chr name.
  */
-static struct bs *bs_add (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const char strand, const char *line)
+static unsigned int chr_hash (const char *chr)
 {
-  struct bs *p;
-  struct chr_block *ch;
+  unsigned int h = 2166136261u;
 
-  p = my_malloc(sizeof(struct bs));
-  p -> st = st; //assigning start position
-  p -> ed = ed; //assigning end position
-  p -> strand = strand; //assigning strand info
-  p -> line = strdup(line); //assigning line
+  while (*chr) {
+    h ^= (unsigned char)*chr++;
+    h *= 16777619u;
+  }
+  return h;
+}
 
-  for (ch = *chr_block_head; ch; ch = ch->next) { //checking chr is already in chr_block list
-    if (!strcmp(chr, ch->chr)) break;
+/*
+ * This doubles the hash table of chr dictionary, and puts all IDs again.
+ */
+static void chr_dict_grow (void)
+{
+  int i, id;
+  unsigned int h, mask;
+
+  MYFREE(chr_dict.slot);
+  chr_dict.slot_len = chr_dict.slot_len ? chr_dict.slot_len * 2 : 256;
+  chr_dict.slot = (int *)my_malloc(chr_dict.slot_len * sizeof(int));
+  for (i = 0; i < chr_dict.slot_len; i++) chr_dict.slot[i] = -1;
+
+  mask = chr_dict.slot_len - 1;
+  for (id = 0; id < chr_dict.nb; id++) {
+    for (h = chr_hash(chr_dict.name[id]) & mask; chr_dict.slot[h] >= 0; h = (h + 1) & mask);
+    chr_dict.slot[h] = id;
   }
+}
 
-  if (ch == NULL) {
-    fprintf(stderr, "error: chr %s is not in the chr block list", chr);
-    goto err;
+/*
+ * This looks up chr ID of chr name.
+ * *chr: pointer to chromosome name
+ * This returns chr ID, or -1 if the chr has never been interned.
+ */
+int ga_chr_find (const char *chr)
+{
+  int id;
+
+  pthread_mutex_lock(&chr_dict_mutex);
+  id = chr_dict_find(chr);
+  pthread_mutex_unlock(&chr_dict_mutex);
+  return id;
+}
+
+/*
+ * This is ga_chr_find without lock.
+ */
+static int chr_dict_find (const char *chr)
+{
+  unsigned int h, mask;
+
+  if (chr_dict.slot_len == 0) return -1;
+  mask = chr_dict.slot_len - 1;
+  for (h = chr_hash(chr) & mask; chr_dict.slot[h] >= 0; h = (h + 1) & mask) { //linear probing
+    if (!strcmp(chr_dict.name[chr_dict.slot[h]], chr)) return chr_dict.slot[h];
+  }
+  return -1;
+}
+
+/*pointer which must be freed: chr dictionary (ga_free_chr_dict)*/
+/*
+ * This interns chr name to chr dictionary.
+ * *chr: pointer to chromosome name
+ * This returns chr ID. The same chr name always gets the same ID in the program.
+ */
+int ga_chr_id (const char *chr)
+{
+  int id;
+  unsigned int h, mask;
+
+  pthread_mutex_lock(&chr_dict_mutex);
+  if ((id = chr_dict_find(chr)) >= 0) goto end;
+
+  if (2 * (chr_dict.nb + 1) > chr_dict.slot_len) chr_dict_grow(); //load factor is kept at most 0.5
+  if (chr_dict.nb == chr_dict.name_len) {
+    chr_dict.name_len = chr_dict.name_len ? chr_dict.name_len * 2 : 64;
+    chr_dict.name = (char **)my_realloc(chr_dict.name, chr_dict.name_len * sizeof(char *));
+  }
+
+  id = chr_dict.nb++;
+  chr_dict.name[id] = strdup(chr);
+  mask = chr_dict.slot_len - 1;
+  for (h = chr_hash(chr) & mask; chr_dict.slot[h] >= 0; h = (h + 1) & mask);
+  chr_dict.slot[h] = id;
+
+end:
+  pthread_mutex_unlock(&chr_dict_mutex);
+  return id;
+}
+
+/*
+ * This returns the number of chr IDs, so IDs are 0 to ga_chr_nb() - 1.
+ */
+int ga_chr_nb (void)
+{
+  int nb;
+
+  pthread_mutex_lock(&chr_dict_mutex);
+  nb = chr_dict.nb;
+  pthread_mutex_unlock(&chr_dict_mutex);
+  return nb;
+}
+
+/*pointer which must be freed: return value*/
+/*
+ * This makes an array of chr blocks addressed by chr ID. The element is NULL if the track doesn't have the chr.
+ * The length is ga_chr_nb() at this point, so the array must be made after all tracks which are compared are parsed.
+ * *chr_block_head: pointer to struct chr_block
+ */
+struct chr_block **ga_index_chr_block (struct chr_block *chr_block_head)
+{
+  struct chr_block **blk, *ch;
+
+  blk = (struct chr_block **)my_calloc(chr_dict.nb ? chr_dict.nb : 1, sizeof(struct chr_block *));
+  for (ch = chr_block_head; ch; ch = ch->next) blk[ch->id] = ch;
+  return blk;
+}
+
+/*pointer which must be freed: return value*/
+/*
+ * This makes an array of chr_block_fa addressed by chr ID like ga_index_chr_block.
+ * *chr_block_head: pointer to struct chr_block_fa
+ */
+struct chr_block_fa **ga_index_chr_block_fa (struct chr_block_fa *chr_block_head)
+{
+  struct chr_block_fa **blk, *ch;
+
+  blk = (struct chr_block_fa **)my_calloc(chr_dict.nb ? chr_dict.nb : 1, sizeof(struct chr_block_fa *));
+  for (ch = chr_block_head; ch; ch = ch->next) blk[ch->id] = ch;
+  return blk;
+}
+
+/*
+ * This frees chr dictionary. chr IDs must not be used after this.
+ */
+void ga_free_chr_dict (void)
+{
+  int id;
+
+  for (id = 0; id < chr_dict.nb; id++) MYFREE(chr_dict.name[id]);
+  MYFREE(chr_dict.name);
+  MYFREE(chr_dict.slot);
+  chr_dict.nb = 0;
+  chr_dict.name_len = 0;
+  chr_dict.slot_len = 0;
+}
+
+/*pointer which must be freed: idx->blk*/
+/*
+ * This initializes chr index with chr blocks which are already in the list.
+ * *idx: pointer to struct chr_index
+ * *chr_block_head: pointer to the head of the link
+ */
+static void chr_index_init (struct chr_index *idx, struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+
+  idx -> len = ga_chr_nb() + 64; //some room for new chr
+  idx -> blk = (struct chr_block **)my_calloc(idx -> len, sizeof(struct chr_block *));
+  for (ch = chr_block_head; ch; ch = ch->next) idx -> blk[ch->id] = ch;
+}
+
+/*pointer which must be freed: struct chr_block *p, p->chr*/
+/*
+ * This makes new struct chr_block for chr, and registers it in chr index.
+ * *chr: pointer to chromosome name
+ * *idx: pointer to struct chr_index of the track
+ */
+static struct chr_block *chr_block_new (const char *chr, struct chr_index *idx)
+{
+  struct chr_block *p;
+
+  p = my_malloc(sizeof(struct chr_block));
+  p -> chr = strdup(chr); //assigning chromosome name
+  p -> id = ga_chr_id(chr); //assigning chr ID
+
+  /*initialization of bs and sig block*/
+  p -> bs_list = NULL;
+  p -> ref_list = NULL;
+  p -> sig_st = NULL;
+  p -> sig_ed = NULL;
+  p -> sig_st32 = NULL;
+  p -> sig_ed32 = NULL;
+  p -> sig_val = NULL;
+  p -> sig_q = NULL;
+  p -> sig_cum = NULL;
+  p -> sig_blk = NULL;
+  p -> arena = NULL;
+  p -> map = NULL;
+  p -> sig_map = NULL;
+  p -> sig_nb = 0;
+  p -> sig_len = 0;
+  p -> sig_blk_nb = 0;
+  p -> sig_blk_len = 0;
+  p -> sig_scale = 1;
+  p -> sig_quant = SIG_QUANT_NONE;
+  p -> sig_wide = 0;
+  p -> bs_init = 0;
+  p -> sig_init = 0;
+  p -> ref_init = 0;
+  p -> bs_order = LIST_ASC | LIST_DESC; //empty list is in any order
+  p -> sig_order = LIST_ASC;
+  p -> ref_order = LIST_ASC | LIST_DESC;
+
+  chr_index_set (idx, p);
+
+  return (p);
+}
+
+/*
+ * This registers chr block in chr index. The index grows if the chr ID is out of the index.
+ * *idx: pointer to struct chr_index of the track
+ * *ch : pointer to chr block
+ */
+static void chr_index_set (struct chr_index *idx, struct chr_block *ch)
+{
+  int len;
+
+  if (ch -> id >= idx -> len) { //growing chr index
+    len = idx -> len;
+    idx -> len = 2 * (ch -> id + 1);
+    idx -> blk = (struct chr_block **)my_realloc(idx -> blk, idx -> len * sizeof(struct chr_block *));
+    memset(idx -> blk + len, 0, (idx -> len - len) * sizeof(struct chr_block *));
+  }
+  idx -> blk[ch -> id] = ch;
+}
+
+/*
+ * This moves chr blocks of src list into chr_block_head list as if bs and sig of src were added after those of chr_block_head.
+ * New chr blocks are put in front of the list keeping the order of src, and if the chr is already linked,
+ * bs list of src is put in front of the linked one, because bs_add adds to the head,
+ * and sig arrays and sig blocks of src are put after the linked ones, because sig_add and sig_block_add append.
+ * **chr_block_head: pointer of pointer to the head of the link
+ * *idx           : pointer to struct chr_index of the link
+ * *src           : chr block list which is moved. src must not be used after this.
+ */
+static void chr_block_merge (struct chr_block **chr_block_head, struct chr_index *idx, struct chr_block *src)
+{
+  struct chr_block *ch, *ch_next, *p, *new_head = NULL, *new_tail = NULL;
+  struct bs *bs;
+
+  for (ch = src; ch; ch = ch_next) {
+    ch_next = ch -> next;
+    p = ch -> id < idx -> len ? idx -> blk[ch -> id] : NULL;
+
+    if (p == NULL) { //new chr
+      chr_index_set (idx, ch);
+      ch -> next = NULL;
+      if (new_tail) new_tail -> next = ch;
+      else new_head = ch;
+      new_tail = ch;
+      continue;
+    }
+
+    if (ch -> bs_init) {
+      if (p -> bs_init && p -> bs_list) {
+        for (bs = ch -> bs_list; bs -> next; bs = bs -> next); //tail of src bs
+        if (bs -> st > p -> bs_list -> st) ch -> bs_order &= ~LIST_ASC; //order of the joined list
+        if (bs -> st <= p -> bs_list -> st) ch -> bs_order &= ~LIST_DESC;
+        bs -> next = p -> bs_list;
+        p -> bs_list -> prev = bs;
+        p -> bs_order &= ch -> bs_order;
+        p -> bs_nb += ch -> bs_nb;
+      } else {
+        p -> bs_order = ch -> bs_order;
+        p -> bs_nb = ch -> bs_nb;
+      }
+      p -> bs_list = ch -> bs_list;
+      p -> bs_init = 1;
+    }
+    if (ch -> sig_init) {
+      if (ch -> sig_nb && p -> sig_blk_nb) sig_expand (p); //sig arrays and dense sig blocks are not mixed in a chr block
+      if (ch -> sig_blk_nb && p -> sig_nb) sig_expand (ch);
+      if (p -> sig_nb && ch -> sig_nb) {
+        if (SIG_ST(ch, 0) < SIG_ST(p, p -> sig_nb - 1)) p -> sig_order &= ~LIST_ASC; //order of the joined arrays
+        p -> sig_order &= ch -> sig_order;
+        if (ch -> sig_wide && !p -> sig_wide) sig_widen (p);
+        if (p -> sig_wide && !ch -> sig_wide) sig_widen (ch);
+        sig_reserve (p, ch -> sig_nb);
+        if (p -> sig_wide) {
+          memcpy(p -> sig_st + p -> sig_nb, ch -> sig_st, ch -> sig_nb * sizeof(unsigned long));
+          memcpy(p -> sig_ed + p -> sig_nb, ch -> sig_ed, ch -> sig_nb * sizeof(unsigned long));
+        } else {
+          memcpy(p -> sig_st32 + p -> sig_nb, ch -> sig_st32, ch -> sig_nb * sizeof(uint32_t));
+          memcpy(p -> sig_ed32 + p -> sig_nb, ch -> sig_ed32, ch -> sig_nb * sizeof(uint32_t));
+        }
+        memcpy(p -> sig_val + p -> sig_nb, ch -> sig_val, ch -> sig_nb * sizeof(float));
+        p -> sig_nb += ch -> sig_nb;
+        MYFREE(ch -> sig_st);
+        MYFREE(ch -> sig_ed);
+        MYFREE(ch -> sig_st32);
+        MYFREE(ch -> sig_ed32);
+        MYFREE(ch -> sig_val);
+      } else if (ch -> sig_nb) { //the arrays of src are moved as they are
+        MYFREE(p -> sig_st);
+        MYFREE(p -> sig_ed);
+        MYFREE(p -> sig_st32);
+        MYFREE(p -> sig_ed32);
+        MYFREE(p -> sig_val);
+        p -> sig_st = ch -> sig_st;
+        p -> sig_ed = ch -> sig_ed;
+        p -> sig_st32 = ch -> sig_st32;
+        p -> sig_ed32 = ch -> sig_ed32;
+        p -> sig_val = ch -> sig_val;
+        p -> sig_nb = ch -> sig_nb;
+        p -> sig_len = ch -> sig_len;
+        p -> sig_order = ch -> sig_order;
+        p -> sig_wide = ch -> sig_wide;
+      }
+      if (ch -> sig_blk_nb) {
+        if (p -> sig_blk_nb + ch -> sig_blk_nb > p -> sig_blk_len) {
+          p -> sig_blk_len = p -> sig_blk_nb + ch -> sig_blk_nb;
+          p -> sig_blk = (struct sig_block *)my_realloc(p -> sig_blk, p -> sig_blk_len * sizeof(struct sig_block));
+        }
+        memcpy(p -> sig_blk + p -> sig_blk_nb, ch -> sig_blk, ch -> sig_blk_nb * sizeof(struct sig_block)); //val of the blocks are moved with them
+        p -> sig_blk_nb += ch -> sig_blk_nb;
+        MYFREE(ch -> sig_blk);
+      }
+      p -> sig_init = 1;
+    }
+    arena_move (p, ch);
+    MYFREE(ch -> chr);
+    MYFREE(ch);
+  }
+
+  if (new_tail) {
+    new_tail -> next = *chr_block_head;
+    *chr_block_head = new_head;
+  }
+}
+
+/*pointer which must be freed: struct chr_block *p, p->chr*/
+/*
+ * This adds new struct chr_block list
+ * *chr: pointer to chromosome name
+ * **chr_block_head: pointer of pointer to the head of the link
+ * *idx: pointer to struct chr_index of the link
+ * This returns the chr block of chr. If the chr is already linked, the linked one is returned.
+ */
+static struct chr_block *chr_block_add (const char *chr, struct chr_block **chr_block_head, struct chr_index *idx)
+{
+  struct chr_block *p;
+  int id;
+
+  if ((id = ga_chr_find(chr)) >= 0 && id < idx->len && idx->blk[id]) return idx->blk[id]; //checking chr is already in chr_block list
+
+  p = chr_block_new (chr, idx);
+  p -> next = *chr_block_head; //adding new chr block
+  *chr_block_head = p;
+
+  return (p);
+
+}
+
+/*pointer which must be freed: struct chr_block *p, p->chr*/
+/*
+ * This appends new struct chr_block list
+ * *chr: pointer to chromosome name
+ * **chr_block_head: pointer of pointer to the head of the link
+ * *idx: pointer to struct chr_index of the link
+ * This returns the chr block of chr. If the chr is already linked, the linked one is returned.
+ */
+static struct chr_block *chr_block_append (const char *chr, struct chr_block **chr_block_head, struct chr_index *idx)
+{
+  struct chr_block *p;
+  int id;
+
+  if ((id = ga_chr_find(chr)) >= 0 && id < idx->len && idx->blk[id]) return idx->blk[id]; //checking chr is already in chr_block list
+
+  p = chr_block_new (chr, idx);
+
+  if (*chr_block_head == NULL) { //if chromosome is the first one
+    *chr_block_head = p;
+  } else {
+    (*chr_block_head) -> tail -> next = p; //if not parenthesis, *chr_block_head -> tail means "tail pointer" of "pointer of pointer chr_block_head", not "tail pointer" of "pointer of *chr_block_head"
+  }
+
+  (*chr_block_head) -> tail = p;
+  p -> next = NULL;
+
+  return (p);
+
+}
+
+/*pointer which must be freed: p(if needed), p->chr, p->letter*/
+/*
+ * This appends new struct chr_block_fa list
+ * **chr_block_head: pointer of pointer to the head of the link(structure chr_block_fa)
+ * *chr: pointer to chromosome name
+ * *letter: pointer to letter
+ */
+static int chr_block_fa_append (struct chr_block_fa **chr_block_head, const char *chr, const char *letter)
+{
+  struct chr_block_fa *p;
+
+  p = my_malloc(sizeof(struct chr_block_fa));
+  p -> chr = strdup(chr); //assigning chromosome name
+  p -> id = ga_chr_id(chr); //assigning chr ID
+  p -> letter = strdup(letter); //assigning letter for chromosome
+  p -> letter_len = (unsigned long)strlen(letter); //storing letter length
+  
+  if (*chr_block_head == NULL) { //if chromosome is the first one
+    *chr_block_head = p;
+  } else {
+    (*chr_block_head) -> tail -> next = p; //if not parenthesis, *chr_block_head -> tail means "tail pointer" of "pointer of pointer chr_block_head", not "tail pointer" of "pointer of *chr_block_head"
+  }
+
+  (*chr_block_head) -> tail = p;
+  p -> next = NULL;
+
+  return 0;
+}
+
+/*pointer which must be freed: ch->arena */
+/*
+ * This allocates size bytes from arena of chr block. A new chunk is linked if the newest one is full.
+ * The memory is 8-byte aligned, and is freed with the chr block.
+ * *ch : pointer to chr block
+ * size: bytes
+ */
+static void *arena_alloc (struct chr_block *ch, const size_t size)
+{
+  struct arena_chunk *c = ch -> arena;
+  size_t need = (size + 7) & ~(size_t)7, len;
+  void *p;
+
+  if (c == NULL || c -> len - c -> used < need) {
+    len = c ? 2 * c -> len : ARENA_CHUNK_MIN;
+    if (len < ARENA_CHUNK_MIN) len = ARENA_CHUNK_MIN; //the head may be a chunk of mapping reference
+    if (len > ARENA_CHUNK_MAX) len = ARENA_CHUNK_MAX;
+    if (len < need) len = need; //a large record has its own chunk
+    c = (struct arena_chunk *)my_malloc(sizeof(struct arena_chunk) + len);
+    c -> len = len;
+    c -> used = 0;
+    c -> map = NULL;
+    c -> next = ch -> arena;
+    ch -> arena = c;
+  }
+  p = c -> data + c -> used;
+  c -> used += need;
+
+  return p;
+}
+
+/*
+ * This copies str of len bytes into arena of chr block, and terminates it.
+ */
+static char *arena_strndup (struct chr_block *ch, const char *str, const size_t len)
+{
+  char *p;
+
+  p = (char *)arena_alloc (ch, len + 1);
+  memcpy(p, str, len);
+  p[len] = '\0';
+
+  return p;
+}
+
+/*
+ * This moves arena chunks of src to dst, when records of src are moved to dst. The newest chunk of dst is kept at the head.
+ */
+static void arena_move (struct chr_block *dst, struct chr_block *src)
+{
+  struct arena_chunk *c;
+
+  if (src -> arena == NULL) return;
+  if (dst -> arena == NULL) {
+    dst -> arena = src -> arena;
+  } else {
+    for (c = src -> arena; c -> next; c = c -> next); //the oldest chunk of src
+    c -> next = dst -> arena -> next;
+    dst -> arena -> next = src -> arena;
+  }
+  src -> arena = NULL;
+}
+
+/*pointer which must be freed: ch->arena */
+/*
+ * This adds new struct bs list
+ * *ch: pointer to chr block which the bs is linked to
+ * st: start position
+ * ed: end position
+ * strand: strand either '+', '-' or '.'.
+ * *line: pointer to each line which is read
+ * len: length of line
+ * *map: mapping which line is in, or NULL. If NULL, line is copied.
+ */
+static struct bs *bs_add (struct chr_block *ch, const unsigned long st, const unsigned long ed, const char strand, const char *line, const unsigned int len, struct text_map *map)
+{
+  struct bs *p;
+
+  p = (struct bs *)arena_alloc (ch, sizeof(struct bs));
+  p -> st = st; //assigning start position
+  p -> ed = ed; //assigning end position
+  p -> strand = strand; //assigning strand info
+  if (map) {
+    text_map_hold (ch, map);
+    p -> line = line; //pointing to line in the mapping
+  } else {
+    p -> line = arena_strndup (ch, line, len); //assigning line
   }
+  p -> line_len = len;
 
   /*initialization of bs*/
   if (!ch -> bs_init) { //if the bs is the first one to be added.
@@ -534,6 +1563,10 @@ static struct bs *bs_add (const char *chr, struct chr_block **chr_block_head, co
   } else { //if the bs is not the first one to be added.
     ch -> bs_nb = ch -> bs_nb + 1;
   }
+  if (ch -> bs_list) { //the order is kept while adding, so the list which is already in order is not sorted
+    if (st > ch -> bs_list -> st) ch -> bs_order &= ~LIST_ASC;
+    if (st <= ch -> bs_list -> st) ch -> bs_order &= ~LIST_DESC;
+  }
 
   p -> prev = NULL;
   p -> next = ch -> bs_list; //adding new bs
@@ -541,395 +1574,1424 @@ static struct bs *bs_add (const char *chr, struct chr_block **chr_block_head, co
   ch -> bs_list = p;
 
   return (p);
+}
+
+/*pointer which must be freed: ch->arena */
+/*
+ * This appends new struct ref list
+ * *ch: pointer to chr block which the ref is linked to
+ * st: start position
+ * ed: end position
+ * strand: strand either '+', '-' or '.'.
+ * *ex_st: pointer to field of exon start positions
+ * *ex_ed: pointer to field of exon end positions
+ * *gene: pointer to field of gene name
+ * *line: pointer to each line which is read
+ * len: length of line
+ * *map: mapping which line is in, or NULL. If NULL, line is copied.
+ */
+static int ref_append (struct chr_block *ch, const unsigned long st, const unsigned long ed, const char strand, const struct field *ex_st, const struct field *ex_ed, const struct field *gene, const char *line, const unsigned int len, struct text_map *map)
+{
+  struct ref *p;
+
+  p = (struct ref *)arena_alloc (ch, sizeof(struct ref));
+  p -> st = st; //assigning start position
+  p -> ed = ed; //assigning end position
+  p -> strand = strand; //assigning strand info
+  p -> ex_st = arena_strndup (ch, ex_st->p, ex_st->len); //assigning exon start
+  p -> ex_ed = arena_strndup (ch, ex_ed->p, ex_ed->len); //assigning exon end
+  if (map) {
+    text_map_hold (ch, map);
+    p -> line = line; //pointing to line in the mapping
+  } else {
+    p -> line = arena_strndup (ch, line, len); //assigning line
+  }
+  p -> line_len = len;
+  p -> gene = arena_strndup (ch, gene->p, gene->len); //assigning gene
+  p -> rm_ex_st = NULL; //at this point, rm_ex_st is null.
+  p -> rm_ex_ed = NULL; //at this point, rm_ex_ed is null.
+  p -> ov_gene = NULL; //at this point, ov_gene is null.
+
+  /*initialization of bs*/
+  if (!(ch -> ref_init)) { //if the ref is the first one to be added.
+    ch -> ref_list = p;
+    p -> prev = NULL;
+    ch -> ref_init = 1; //initialization
+  } else { //if the bs is not the first one to be added.
+    if (ch -> ref_list -> tail -> st > st) ch -> ref_order &= ~LIST_ASC; //ref is appended to the tail
+    if (ch -> ref_list -> tail -> st <= st) ch -> ref_order &= ~LIST_DESC;
+    ch -> ref_list -> tail -> next = p;
+    p -> prev = ch -> ref_list -> tail;
+  }
+
+  p -> next = NULL;
+  ch -> ref_list -> tail = p;
+
+  return 0;
+}
+
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
+/*
+ * This appends new sig to the sig arrays of chr block.
+ * *ch: pointer to chr block which the sig is added to
+ * st: start position
+ * ed: end position
+ * val: signal value
+ */
+static void sig_add (struct chr_block *ch, const unsigned long st, const unsigned long ed, const float val)
+{
+  if (ch -> sig_blk_nb) sig_expand (ch); //sig arrays and dense sig blocks are not mixed in a chr block, so the order of sig is kept
+  if (ch -> sig_nb == ch -> sig_len) sig_reserve (ch, 1);
+  if (ch -> sig_nb && st < SIG_ST(ch, ch -> sig_nb - 1)) ch -> sig_order &= ~LIST_ASC; //the order is kept while adding, so the arrays which are already in order are not sorted
+
+  sig_set (ch, ch -> sig_nb, st, ed);
+  ch -> sig_val[ch -> sig_nb] = val;
+  ch -> sig_nb++;
+  ch -> sig_init = 1;
+}
+
+/*
+ * This makes room for nb more sig in the sig arrays of chr block. The arrays grow at least twice.
+ * *ch: pointer to chr block
+ * nb: number of sig which will be added
+ */
+static void sig_reserve (struct chr_block *ch, const unsigned long nb)
+{
+  unsigned long len;
+
+  if (ch -> sig_nb + nb <= ch -> sig_len) return;
+  len = 2 * ch -> sig_len > ch -> sig_nb + nb ? 2 * ch -> sig_len : ch -> sig_nb + nb;
+  sig_resize (ch, len < 1024 ? 1024 : len);
+}
+
+/*
+ * This shrinks the sig arrays of each chr block to the number of sig, after all sig are added.
+ * *chr_block_head: pointer to the head of the link
+ */
+static void sig_trim (struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+
+  struct sig_block *b;
+
+  for (ch = chr_block_head; ch; ch = ch -> next) {
+    for (b = ch -> sig_blk; b < ch -> sig_blk + ch -> sig_blk_nb; b++) {
+      if (b -> len == b -> nb) continue;
+      b -> len = b -> nb;
+      b -> val = (float *)my_realloc(b -> val, b -> len * sizeof(float));
+    }
+    if (ch -> sig_len == ch -> sig_nb || ch -> sig_nb == 0) continue;
+    sig_resize (ch, ch -> sig_nb);
+  }
+}
+
+/*
+ * This sets coordinates of i-th sig of chr block. The coordinates become 64-bit if one of them doesn't fit in 32 bits.
+ * *ch: pointer to chr block
+ * i: index of sig (i < sig_len)
+ * st, ed: start and end position
+ */
+static void sig_set (struct chr_block *ch, const unsigned long i, const unsigned long st, const unsigned long ed)
+{
+  if (!ch -> sig_wide && (st > UINT32_MAX || ed > UINT32_MAX)) sig_widen (ch);
+  if (ch -> sig_wide) {
+    ch -> sig_st[i] = st;
+    ch -> sig_ed[i] = ed;
+  } else {
+    ch -> sig_st32[i] = (uint32_t)st;
+    ch -> sig_ed32[i] = (uint32_t)ed;
+  }
+}
+
+/*
+ * This reallocates the sig arrays of chr block (coordinates of the current width and values) to len.
+ * *ch: pointer to chr block
+ * len: new length, which must be sig_nb or more
+ */
+static void sig_resize (struct chr_block *ch, const unsigned long len)
+{
+  if (ch -> sig_map) sig_own (ch); //the arrays of signal store are read-only
+  ch -> sig_len = len;
+  if (ch -> sig_wide) {
+    ch -> sig_st = (unsigned long *)my_realloc(ch -> sig_st, len * sizeof(unsigned long));
+    ch -> sig_ed = (unsigned long *)my_realloc(ch -> sig_ed, len * sizeof(unsigned long));
+  } else {
+    ch -> sig_st32 = (uint32_t *)my_realloc(ch -> sig_st32, len * sizeof(uint32_t));
+    ch -> sig_ed32 = (uint32_t *)my_realloc(ch -> sig_ed32, len * sizeof(uint32_t));
+  }
+  ch -> sig_val = (float *)my_realloc(ch -> sig_val, len * sizeof(float));
+}
+
+/*pointer which must be freed: ch->sig_st, ch->sig_ed */
+/*
+ * This changes coordinates of sig of chr block from 32-bit to 64-bit, for chr longer than 4 Gb.
+ * *ch: pointer to chr block
+ */
+static void sig_widen (struct chr_block *ch)
+{
+  unsigned long i;
+
+  ch -> sig_st = (unsigned long *)my_malloc(ch -> sig_len * sizeof(unsigned long));
+  ch -> sig_ed = (unsigned long *)my_malloc(ch -> sig_len * sizeof(unsigned long));
+  for (i = 0; i < ch -> sig_nb; i++) {
+    ch -> sig_st[i] = ch -> sig_st32[i];
+    ch -> sig_ed[i] = ch -> sig_ed32[i];
+  }
+  MYFREE(ch -> sig_st32);
+  MYFREE(ch -> sig_ed32);
+  ch -> sig_wide = 1;
+}
+
+/*pointer which must be freed: struct text_map *map (by text_map_release) */
+/*
+ * This makes sig arrays of chr block point into the mapped signal store, instead of copying nb sig.
+ * The arrays of the store are sorted and 64-bit, and the chr block holds a reference to the mapping.
+ * *ch: pointer to chr block which doesn't have sig yet
+ * *map: mapping of the store
+ * *st, *ed, *val: arrays of the chr in the store
+ */
+static void sig_attach (struct chr_block *ch, struct text_map *map, const uint64_t *st, const uint64_t *ed, const float *val, const unsigned long nb)
+{
+  pthread_mutex_lock(&text_map_mutex);
+  map -> ref++;
+  pthread_mutex_unlock(&text_map_mutex);
+
+  MYFREE(ch -> sig_st);
+  MYFREE(ch -> sig_ed);
+  MYFREE(ch -> sig_st32);
+  MYFREE(ch -> sig_ed32);
+  MYFREE(ch -> sig_val);
+  ch -> sig_st = (unsigned long *)st; //the store is mapped read-only, so the arrays must not be changed
+  ch -> sig_ed = (unsigned long *)ed;
+  ch -> sig_val = (float *)val;
+  ch -> sig_nb = nb;
+  ch -> sig_len = nb;
+  ch -> sig_wide = 1;
+  ch -> sig_order = LIST_ASC;
+  ch -> sig_init = 1;
+  ch -> sig_map = map;
+}
+
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
+/*
+ * This copies sig arrays attached from signal store into own arrays of chr block, so that they can be changed.
+ * Coordinates become 32-bit if they fit. Values are not copied if they are already quantized.
+ * *ch: pointer to chr block
+ */
+static void sig_own (struct chr_block *ch)
+{
+  struct text_map *map = ch -> sig_map;
+  const unsigned long *st = ch -> sig_st, *ed = ch -> sig_ed;
+  const float *val = ch -> sig_val;
+  unsigned long i, nb = ch -> sig_nb;
+
+  if (map == NULL) return;
+  ch -> sig_map = NULL;
+  ch -> sig_st = NULL;
+  ch -> sig_ed = NULL;
+  ch -> sig_val = NULL;
+  ch -> sig_wide = 0;
+  ch -> sig_nb = 0;
+  sig_resize (ch, nb);
+  for (i = 0; i < nb; i++) {
+    sig_set (ch, i, st[i], ed[i]);
+    if (val) ch -> sig_val[i] = val[i];
+    ch -> sig_nb = i + 1;
+  }
+  if (val == NULL) MYFREE(ch -> sig_val); //values are kept in sig_q
+  text_map_release (map);
+}
+
+/*pointer which must be freed: ch->sig_blk, ch->sig_blk[]->val */
+/*
+ * This appends new sig of fixedStep wig to the last dense sig block of chr block.
+ * If the sig doesn't follow the last block by the step, new block is started from it.
+ * sig which can't be in dense block (span > step), or sig of chr block which already has the sig arrays, is added to the sig arrays by sig_add.
+ * *ch: pointer to chr block which the sig is added to
+ * st: start position
+ * step, span: step and span of the wig
+ * val: signal value
+ */
+static void sig_block_add (struct chr_block *ch, const unsigned long st, const int step, const int span, const float val)
+{
+  struct sig_block *b;
+
+  if (span <= 0 || span > step || ch -> sig_nb) {
+    sig_add (ch, st, st + span, val);
+    return;
+  }
+
+  b = ch -> sig_blk_nb ? &ch -> sig_blk[ch -> sig_blk_nb - 1] : NULL;
+  if (b == NULL || b -> step != (unsigned long)step || b -> span != (unsigned long)span || b -> st + b -> nb * b -> step != st) { //new block
+    if (ch -> sig_blk_nb == ch -> sig_blk_len) {
+      ch -> sig_blk_len = ch -> sig_blk_len ? 2 * ch -> sig_blk_len : 16;
+      ch -> sig_blk = (struct sig_block *)my_realloc(ch -> sig_blk, ch -> sig_blk_len * sizeof(struct sig_block));
+    }
+    b = &ch -> sig_blk[ch -> sig_blk_nb++];
+    b -> st = st;
+    b -> step = step;
+    b -> span = span;
+    b -> nb = 0;
+    b -> len = 0;
+    b -> val = NULL;
+    b -> q = NULL;
+  }
+  if (b -> nb == b -> len) {
+    b -> len = b -> len ? 2 * b -> len : 64;
+    b -> val = (float *)my_realloc(b -> val, b -> len * sizeof(float));
+  }
+  b -> val[b -> nb++] = val;
+  ch -> sig_init = 1;
+}
+
+/*
+ * This keeps dense sig blocks only for chr whose blocks are sorted without overlap, so they can be summed by index arithmetic.
+ * The blocks of the other chr are expanded into the sig arrays.
+ * *chr_block_head: pointer to the head of the link
+ */
+static void sig_block_check (struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+  const struct sig_block *b;
+  unsigned long i;
+
+  for (ch = chr_block_head; ch; ch = ch -> next) {
+    if (!ch -> sig_blk_nb) continue;
+    for (i = 1; i < ch -> sig_blk_nb; i++) {
+      b = &ch -> sig_blk[i - 1];
+      if (b -> st + (b -> nb - 1) * b -> step + b -> span > ch -> sig_blk[i].st) break; //the block overlaps the next one
+    }
+    if (i < ch -> sig_blk_nb) sig_expand (ch);
+  }
+}
+
+/*
+ * This expands dense sig blocks of chr block into the sig arrays, and frees the blocks.
+ * *ch: pointer to chr block
+ */
+static void sig_expand (struct chr_block *ch)
+{
+  struct sig_block *blk = ch -> sig_blk, *b;
+  unsigned long i, nb = 0, blk_nb = ch -> sig_blk_nb;
+
+  ch -> sig_blk = NULL; //the blocks are detached first, because sig_add expands them
+  ch -> sig_blk_nb = 0;
+  ch -> sig_blk_len = 0;
+  for (b = blk; b < blk + blk_nb; b++) nb += b -> nb;
+  sig_reserve (ch, nb);
+  for (b = blk; b < blk + blk_nb; b++) {
+    for (i = 0; i < b -> nb; i++) sig_add (ch, b -> st + i * b -> step, b -> st + i * b -> step + b -> span, b -> val[i]);
+    MYFREE(b -> val);
+  }
+  MYFREE(blk);
+}
+
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
+/*
+ * This expands dense sig blocks of each chr block into the sig arrays, for the functions which need start and end of each sig.
+ * *chr_block_head: pointer to the head of the link
+ */
+void ga_expand_sig (struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+
+  for (ch = chr_block_head; ch; ch = ch -> next) {
+    if (ch -> sig_blk_nb) sig_expand (ch);
+  }
+}
+
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
+/*
+ * This parses separated wig.gz files.
+ * Files "filename_*.wig.gz" are parsed by ga_thread_nb threads, and each file is parsed into its own chr block list.
+ * The lists are merged in the order of file names, so the result is the same as parsing the files one by one.
+ * *filename       : file name
+ * **chr_block_head: pointer of pointer to struct chr_block
+ */
+void ga_parse_sepwiggz (const char *filename, struct chr_block **chr_block_head)
+{
+  parse_sepwiggz (filename, chr_block_head, NULL);
+}
+
+/*
+ * This is ga_parse_sepwiggz with query regions. Files of chrs which are not queried are closed after the header.
+ * *rs: query regions, or NULL for all lines
+ */
+static void parse_sepwiggz (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs)
+{
+  char pattern[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0};
+  glob_t gl;
+  pthread_t *th = NULL;
+  struct sepwiggz_job job;
+  struct chr_index idx;
+  int i, thread_nb, ret;
+
+  if (strlen(filename) + strlen("_*.wig.gz") + 1 > sizeof(pattern)) {
+    LOG("errer: filename is too long.");
+    return;
+  }
+  sprintf(pattern, "%s_*.wig.gz", filename); //list of wig.gz file
+  if ((ret = glob(pattern, 0, NULL, &gl)) != 0) {
+    if (ret == GLOB_NOMATCH) fprintf(stderr, "error: no file matches %s\n", pattern);
+    else LOG("error: glob error for 'filename_*.wig.gz'");
+    return;
+  }
+
+  job.file = gl.gl_pathv;
+  job.file_nb = (int)gl.gl_pathc;
+  job.next = 0;
+  job.rs = rs;
+  job.list = (struct chr_block **)my_calloc(job.file_nb, sizeof(struct chr_block *));
+  job.ret = (int *)my_calloc(job.file_nb, sizeof(int));
+  pthread_mutex_init(&job.mutex, NULL);
+
+  thread_nb = ga_thread_nb < job.file_nb ? ga_thread_nb : job.file_nb;
+  job.inflate_nb = thread_nb > 0 && ga_thread_nb / thread_nb > 1 ? ga_thread_nb / thread_nb - 1 : 0; //spare threads inflate each file
+  if (thread_nb > 1) {
+    th = (pthread_t *)my_malloc(thread_nb * sizeof(pthread_t));
+    for (i = 0; i < thread_nb; i++) {
+      if (pthread_create(&th[i], NULL, sepwiggz_worker, &job) != 0) {
+        LOG("error: thread cannot be created.");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (i = 0; i < thread_nb; i++) pthread_join(th[i], NULL);
+  } else {
+    sepwiggz_worker (&job); //parsing on this thread
+  }
+
+  chr_index_init (&idx, *chr_block_head);
+  for (i = 0; i < job.file_nb; i++) {
+    if (job.ret[i] != 0) fprintf(stderr, "error: error in parsing %s\n", job.file[i]);
+    chr_block_merge (chr_block_head, &idx, job.list[i]);
+  }
+
+  pthread_mutex_destroy(&job.mutex);
+  MYFREE(idx.blk);
+  MYFREE(th);
+  MYFREE(job.list);
+  MYFREE(job.ret);
+  globfree(&gl);
+  return;
+}
+
+/*
+ * This is the thread function of ga_parse_sepwiggz. It takes the next file until all files are parsed.
+ * *arg: pointer to struct sepwiggz_job
+ */
+static void *sepwiggz_worker (void *arg)
+{
+  struct sepwiggz_job *job = (struct sepwiggz_job *)arg;
+  int i;
+
+  while (1) {
+    pthread_mutex_lock(&job->mutex);
+    i = job->next++;
+    pthread_mutex_unlock(&job->mutex);
+    if (i >= job->file_nb) break;
+
+    job->ret[i] = parse_wiggz_file (job->file[i], &job->list[i], job->inflate_nb, job->rs);
+  }
+
+  return NULL;
+}
+
+/*pointer which must be freed: ch->sig_st32, ch->sig_ed32 (or ch->sig_st, ch->sig_ed), ch->sig_val */
+/*
+ * This parses one chr file of separated wig.gz files.
+ * *filename       : file name
+ * **chr_block_head: pointer of pointer to struct chr_block
+ * inflate_nb      : number of inflate threads (see ga_gz_open)
+ * *rs             : query regions, or NULL for all lines
+ * This returns 0 if the file is parsed, otherwise -1.
+ */
+static int parse_wiggz_file (const char *filename, struct chr_block **chr_block_head, const int inflate_nb, const struct region_set *rs)
+{
+  char line[LINE_STR_LEN] = {0};
+  struct field fld[FIELD_MAX];
+  int span_val=1, step_val=0, step=0;
+  unsigned long st=0;
+  struct chr_block *ch = NULL;
+  struct chr_index idx;
+  struct gz_reader *gfp = NULL;
+
+  if ((gfp = ga_gz_open (filename, inflate_nb)) == NULL) {
+    LOG("errer: input file cannot be open.");
+//    goto err;
+    exit(EXIT_FAILURE);
+  }
+  chr_index_init (&idx, *chr_block_head);
+
+  while (ga_gz_gets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line of the wig.gz
+    if (strlen(line) >= LINE_STR_LEN -1) {
+      LOG("errer: line length is too long.");
+      goto err;
+    }
+
+    step = wig_header (fld, split_line(line, '\t', fld, FIELD_MAX), chr_block_head, &idx, rs, &ch, &st, &step_val, &span_val); //extracting step, chr, and so on...
+    if (step < 0) {
+      LOG("error: chrom is not found in wig header.");
+      goto err;
+    } else if (step) break;
+  }
+  if (ch == NULL) step = 0; //the chr of this file is not queried, so the rest is not read
+
+  if (step == WIG_VARIABLE) {
+    while (ga_gz_gets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
+      if (line[0] == '\n') continue;
+      if (split_line(line, '\t', fld, 2) < 2) {
+        LOG("error: column number is out of range.");
+        goto err;
+      }
+      st = field_ul(&fld[0]);
+      if (rs && !region_hit (rs, ch->id, st, st + span_val)) continue;
+      sig_add (ch, st, st + span_val, field_f(&fld[1]));
+    }
+  } else if (step == WIG_FIXED) {
+    while (ga_gz_gets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
+      if (line[0] == '\n') continue;
+      if (rs == NULL || region_hit (rs, ch->id, st, st + span_val)) {
+        split_line(line, '\t', fld, 1);
+        sig_block_add (ch, st, step_val, span_val, field_f(&fld[0]));
+      }
+      st += step_val;
+    }
+  }
+
+  MYFREE(idx.blk);
+  pipe_stat (filename, gfp);
+  if (ga_gz_close(gfp) != 0) return -1; //broken gzip
+  return 0;
+
+err:
+  ga_gz_close(gfp);
+  MYFREE(idx.blk);
+  return -1;
+}
+
+/*
+ * This parses one wig.gz files.
+ * *filename       : file name
+ * **chr_block_head: pointer of pointer to struct chr_block
+ */
+void ga_parse_onewiggz (const char *filename, struct chr_block **chr_block_head)
+{
+  parse_onewiggz (filename, chr_block_head, NULL);
+}
+
+/*
+ * This is ga_parse_onewiggz with query regions. Values of chrs which are not queried are not parsed.
+ * *rs: query regions, or NULL for all lines
+ */
+static void parse_onewiggz (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs)
+{
+  char line[LINE_STR_LEN] = {0};
+
+  struct field fld[FIELD_MAX];
+  int span_val=1, step_val=0, step=0, stephold=0, nf;
+  unsigned long st=0;
+  struct chr_block *ch = NULL;
+  struct chr_index idx;
+  struct gz_reader *gfp = NULL;
+
+
+  if ((gfp = ga_gz_open (filename, ga_thread_nb > 1 ? ga_thread_nb - 1 : 0)) == NULL) {
+    LOG("errer: input file cannot be open.");
+//    goto err;
+    exit(EXIT_FAILURE);
+  }
+  chr_index_init (&idx, *chr_block_head);
+
+  while (ga_gz_gets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
+    if (strlen(line) >= LINE_STR_LEN -1) {
+      LOG("errer: line length is too long.");
+      goto err;
+    }
+    if (line[0] == '\n') continue;
+
+    nf = split_line(line, ' ', fld, FIELD_MAX);
+    step = wig_header (fld, nf, chr_block_head, &idx, rs, &ch, &st, &step_val, &span_val); //extracting step, chr, and so on...
+
+    if (step < 0) {
+      LOG("error: chrom is not found in wig header.");
+      goto err;
+    } else if (step) {
+      stephold = step; //with the stephold, the program can read the value.
+      continue;
+    } else if (ch == NULL) { //the chr is not queried
+      continue;
+    } else if (stephold == WIG_VARIABLE) {
+      if (nf < 2) {
+        LOG("error: column number is out of range.");
+        goto err;
+      }
+      st = field_ul(&fld[0]);
+      if (rs && !region_hit (rs, ch->id, st, st + span_val)) continue;
+      sig_add (ch, st, st + span_val, field_f(&fld[1]));
+    } else if (stephold == WIG_FIXED) {
+      if (rs == NULL || region_hit (rs, ch->id, st, st + span_val)) sig_block_add (ch, st, step_val, span_val, field_f(&fld[0]));
+      st += step_val;
+    }
+  }
+
+  MYFREE(idx.blk);
+  pipe_stat (filename, gfp);
+  if (ga_gz_close(gfp) != 0) LOG("error: error in inflating the wig.gz.");
+
+  return;
+
+err:
+  ga_gz_close(gfp);
+  MYFREE(idx.blk);
+  return;
+}
+
+/*
+ * This reads header line of wig such as "fixedStep chrom=chr1 start=1 step=10 span=10", and adds the chr to chr block list.
+ * start, step and span are updated only if they are in the header, so span is kept from the previous header otherwise.
+ * fld[], nf      : fields of the line
+ * **chr_block_head: pointer of pointer to struct chr_block
+ * *idx           : pointer to struct chr_index of chr_block_head
+ * *rs            : query regions, or NULL
+ * **ch           : pointer of pointer which receives chr block of the chr, or NULL if the chr is not queried
+ * *st, *step_val, *span_val: start, step and span
+ * This returns WIG_VARIABLE or WIG_FIXED for header line, 0 for the other line, and -1 if chrom is not found.
+ */
+static int wig_header (const struct field fld[], const int nf, struct chr_block **chr_block_head, struct chr_index *idx, const struct region_set *rs, struct chr_block **ch, unsigned long *st, int *step_val, int *span_val)
+{
+  char chr[LINE_STR_LEN] = {0};
+  struct field val;
+  int step;
+
+  if (field_eq(&fld[0], "variableStep")) step = WIG_VARIABLE;
+  else if (field_eq(&fld[0], "fixedStep")) step = WIG_FIXED;
+  else return 0;
+
+  if (field_key(fld, nf, "chrom", &val) != 0) return -1;
+  field_str(&val, chr, sizeof(chr));
+  *ch = region_chr (rs, chr) ? chr_block_add (chr, chr_block_head, idx) : NULL; //adding chr link list (if the chr is already linked, the linked one is returned)
+
+  if (step == WIG_FIXED) {
+    if (field_key(fld, nf, "start", &val) == 0) *st = field_ul(&val); //start pos (unsigned long)
+    if (field_key(fld, nf, "step", &val) == 0) *step_val = (int)field_ul(&val);
+  }
+  if (field_key(fld, nf, "span", &val) == 0) *span_val = (int)field_ul(&val);
+
+  return step;
+}
+
+/*
+ * This parses binary signal file made by ga_sigbin.
+ * The file is mapped to memory, and sig of each chr is taken from st, ed, val arrays.
+ * *filename       : file name
+ * **chr_block_head: pointer of pointer to struct chr_block
+ */
+int ga_parse_sigbin (const char *filename, struct chr_block **chr_block_head)
+{
+  return parse_sigbin (filename, chr_block_head, NULL, 0);
+}
+
+/*
+ * This attaches signal store which ga_sigbin --shm placed in POSIX shared memory.
+ * sig arrays of each chr point into the shared mapping read-only, so concurrent tools share one copy of the signal.
+ * *name           : name of shared memory object, e.g. /chip1
+ * **chr_block_head: pointer of pointer to struct chr_block
+ */
+int ga_parse_sigshm (const char *name, struct chr_block **chr_block_head)
+{
+  return parse_sigbin (name, chr_block_head, NULL, 1);
+}
+
+/*
+ * This checks that nb elements of size bytes from offset are inside the file of len bytes.
+ * It is written so that offset + nb * size is never calculated, which may overflow with a broken file.
+ * This returns 1 if they are inside, otherwise 0.
+ */
+static int sigbin_fit (const uint64_t offset, const uint64_t nb, const uint64_t size, const uint64_t len)
+{
+  return offset <= len && nb <= (len - offset) / size;
+}
+
+/*
+ * This is ga_parse_sigbin (or ga_parse_sigshm if shm) with query regions.
+ * If sig is sorted without overlap (SIGBIN_DISJOINT), sig around each region is found by binary search, so sig out of the regions is never touched.
+ * Otherwise each sig is checked against the regions, because a long sig which starts far before a region may overlap it.
+ * sig of signal store are attached as a whole for each queried chr instead of being copied.
+ * *rs: query regions, or NULL for all sig
+ * shm: if 1, filename is the name of shared memory object
+ */
+static int parse_sigbin (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs, const int shm)
+{
+  int fd, id, k;
+  struct stat sb;
+  char *map = NULL;
+  struct text_map *store = NULL;
+  const struct sigbin_header *hd;
+  const struct sigbin_chr *dir;
+  const uint64_t *st, *ed;
+  const float *val;
+  char chr[SIGBIN_CHR_LEN] = {0};
+  struct chr_block *ch;
+  struct chr_index idx = {NULL, 0};
+  const struct region *reg;
+  uint64_t c, i, lo, hi, m, from;
+
+  if ((fd = shm ? shm_open (filename, O_RDONLY, 0) : open (filename, O_RDONLY)) < 0) {
+    if (shm) LOG("errer: signal store cannot be open. It must be placed by ga_sigbin --shm.");
+    else LOG("errer: input file cannot be open.");
+    exit(EXIT_FAILURE);
+  }
+  if (fstat(fd, &sb) != 0 || sb.st_size < sizeof(struct sigbin_header)) {
+    LOG("error: input file is not binary signal file.");
+    goto err;
+  }
+  if ((map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    map = NULL;
+    LOG("error: input file cannot be mapped.");
+    goto err;
+  }
+  store = (struct text_map *)my_malloc(sizeof(struct text_map));
+  store -> p = map;
+  store -> len = sb.st_size;
+  store -> ref = 1;
+
+  hd = (const struct sigbin_header *)map;
+  if (memcmp(hd->magic, SIGBIN_MAGIC, sizeof(hd->magic)) || hd->version != SIGBIN_VERSION) {
+    LOG("error: input file is not binary signal file or the version is different.");
+    goto err;
+  }
+  if (!sigbin_fit (sizeof(struct sigbin_header), hd->chr_nb, sizeof(struct sigbin_chr), sb.st_size)) {
+    LOG("error: binary signal file is truncated.");
+    goto err;
+  }
+
+  chr_index_init (&idx, *chr_block_head);
+  dir = (const struct sigbin_chr *)(map + sizeof(struct sigbin_header));
+  for (c = 0; c < hd->chr_nb; c++) {
+    if (!sigbin_fit (dir[c].st_offset, dir[c].sig_nb, sizeof(uint64_t), sb.st_size) ||\
+        !sigbin_fit (dir[c].ed_offset, dir[c].sig_nb, sizeof(uint64_t), sb.st_size) ||\
+        !sigbin_fit (dir[c].val_offset, dir[c].sig_nb, sizeof(float), sb.st_size)) {
+      LOG("error: binary signal file is truncated.");
+      goto err;
+    }
+    if (dir[c].st_offset % sizeof(uint64_t) || dir[c].ed_offset % sizeof(uint64_t) || dir[c].val_offset % sizeof(float)) {
+      LOG("error: arrays of binary signal file are not aligned.");
+      goto err;
+    }
+    memcpy(chr, dir[c].chr, SIGBIN_CHR_LEN - 1); //chr name is always terminated
+    st  = (const uint64_t *)(map + dir[c].st_offset);
+    ed  = (const uint64_t *)(map + dir[c].ed_offset);
+    val = (const float *)(map + dir[c].val_offset);
+
+    if (!region_chr (rs, chr)) continue; //the chr is not queried
+    ch = chr_block_add (chr, chr_block_head, &idx); //adding chr link list (if the chr is already linked, the linked one is returned)
+
+    if (shm && (hd->flags & SIGBIN_SORTED) && sizeof(unsigned long) == sizeof(uint64_t) && dir[c].sig_nb && !ch->sig_nb && !ch->sig_blk_nb) {
+      sig_attach (ch, store, st, ed, val, dir[c].sig_nb); //whole chr is attached, because it costs nothing
+    } else if (rs == NULL) {
+      sig_reserve (ch, dir[c].sig_nb);
+      for (i = 0; i < dir[c].sig_nb; i++) sig_add (ch, st[i], ed[i], val[i]);
+    } else if (!(hd->flags & SIGBIN_DISJOINT)) {
+      for (i = 0; i < dir[c].sig_nb; i++) {
+        if (region_hit (rs, ch->id, st[i], ed[i])) sig_add (ch, st[i], ed[i], val[i]);
+      }
+    } else {
+      id = ch->id;
+      reg = rs->reg[id];
+      from = 0; //sig before from are already added
+      for (k = 0; k < rs->nb[id]; k++) { //regions from the first one, so sig is added from the first one
+        for (lo = from, hi = dir[c].sig_nb; lo < hi; ) { //the first sig which starts at or after the start of region
+          m = (lo + hi) / 2;
+          if (st[m] < reg[k].st) lo = m + 1;
+          else hi = m;
+        }
+        for (i = lo; i > from && ed[i - 1] > reg[k].st; i--); //sig which starts before the region and overlaps it. Only the previous sig can overlap it, because sig don't overlap each other
+        for (; i < dir[c].sig_nb && st[i] < reg[k].ed; i++) {
+          if (ed[i] > reg[k].st) sig_add (ch, st[i], ed[i], val[i]);
+        }
+        from = i;
+      }
+    }
+  }
+
+  MYFREE(idx.blk);
+  text_map_release (store); //the mapping is kept if sig are attached
+  close(fd);
+  return 0;
 
 err:
-  MYFREE (p);
-  return (NULL);
+  MYFREE(idx.blk);
+  if (store) text_map_release (store);
+  else if (map) munmap(map, sb.st_size);
+  close(fd);
+  return -1;
 }
 
-/*pointer which must be freed: struct bs *p, p->line, p->ex_st, p->ex_ed*/
 /*
- * This appends new struct ref list
- * *chr: pointer to chr name
- * **chr_block_head: pointer of pointer to the head of the link
- * st: start position
- * ed: end position
- * strand: strand either '+', '-' or '.'.
- * *ex_st: pointer to exon start positions
- * *ex_ed: pointer to exon end positions
- * *line: pointer to each line which is read
+ * This parses bigWig file.
+ * *filename       : file name
+ * **chr_block_head: pointer of pointer to struct chr_block
+ * This returns 0 if the file is parsed, otherwise -1.
  */
-static int ref_append (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const char strand, const char *ex_st, const char *ex_ed, const char *gene, const char *line)
+int ga_parse_bigwig (const char *filename, struct chr_block **chr_block_head)
 {
-  struct ref *p;
+  return parse_bigwig (filename, chr_block_head, NULL, 0);
+}
+
+/*
+ * This is ga_parse_bigwig with query regions.
+ * Only data blocks which overlap the query regions are read, and records outside the regions are skipped.
+ * *rs: query regions, or NULL for all records
+ * win: window size of the tool. If more than 0, summaries of zoom level are parsed instead of base level if the level fits the win (see ga_bw_zoom).
+ */
+static int parse_bigwig (const char *filename, struct chr_block **chr_block_head, const struct region_set *rs, const int win)
+{
+  struct bigwig *bw;
   struct chr_block *ch;
+  struct chr_index idx;
+  struct region whole = {0, UINT32_MAX};
+  const struct region *reg;
+  struct bw_block *blk = NULL;
+  struct bw_rec *rec = NULL;
+  int zoom, reg_nb, blk_nb, blk_len = 0, i, k, id;
+  long rec_nb, rec_len = 0, r, kept;
+  uint32_t c;
+
+  if ((bw = ga_bw_open (filename)) == NULL) return -1;
+  zoom = win > 0 ? ga_bw_zoom (bw, win) : -1;
+  if (zoom >= 0) printf("bigWig zoom level of %u bases is used for %s\n", bw->zoom[zoom].level, filename);
+
+  chr_index_init (&idx, *chr_block_head);
+
+  for (c = 0; c < bw->chr_nb; c++) {
+    if (bw->chr[c].chr == NULL) continue;
+
+    if (rs) { //regions of the chr
+      if (!region_chr (rs, bw->chr[c].chr)) continue; //the chr is not queried
+      id = ga_chr_find (bw->chr[c].chr);
+      reg = rs->reg[id];
+      reg_nb = rs->nb[id];
+    } else { //whole chr
+      reg = &whole;
+      reg_nb = 1;
+    }
 
-  p = my_malloc(sizeof(struct ref));
-  p -> st = st; //assigning start position
-  p -> ed = ed; //assigning end position
-  p -> strand = strand; //assigning strand info
-  p -> ex_st = strdup(ex_st); //assigning exon start
-  p -> ex_ed = strdup(ex_ed); //assigning exon end
-  p -> line = strdup(line); //assigning line
-  p -> gene = strdup(gene); //assigning gene
-  p -> rm_ex_st = NULL; //at this point, rm_ex_st is null.
-  p -> rm_ex_ed = NULL; //at this point, rm_ex_ed is null.
-  p -> ov_gene = NULL; //at this point, ov_gene is null.
+    blk_nb = 0;
+    for (i = 0; i < reg_nb; i++) {
+      if (ga_bw_blocks (bw, zoom, c, reg[i].st < UINT32_MAX ? reg[i].st : UINT32_MAX, reg[i].ed < UINT32_MAX ? reg[i].ed : UINT32_MAX, &blk, &blk_nb, &blk_len) != 0) goto err;
+    }
+    if (blk_nb == 0) continue;
+    qsort(blk, blk_nb, sizeof(struct bw_block), bw_block_cmp); //a block may overlap several regions
+    for (i = 1, k = 0; i < blk_nb; i++) {
+      if (blk[i].offset != blk[k].offset) blk[++k] = blk[i];
+    }
+    blk_nb = k + 1;
 
-  for (ch = *chr_block_head; ch; ch = ch->next) { //checking chr is already in chr_block list
-    if (!strcmp(chr, ch->chr)) break;
-  }
+    rec_nb = 0;
+    for (i = 0; i < blk_nb; i++) {
+      if (ga_bw_read_block (bw, zoom, &blk[i], c, &rec, &rec_nb, &rec_len) != 0) goto err;
+    }
 
-  if (ch == NULL) {
-    fprintf(stderr, "error: chr %s is not in the chr block list", chr);
-    goto err;
-  }
+    for (r = 0, kept = 0; r < rec_nb; r++) { //keeping records which overlap one of regions
+      k = region_find (reg, reg_nb, rec[r].st);
+      if (k < reg_nb && reg[k].st < rec[r].ed) rec[kept++] = rec[r];
+    }
+    if (kept == 0) continue;
 
-  /*initialization of bs*/
-  if (!(ch -> ref_init)) { //if the ref is the first one to be added.
-    ch -> ref_list = p;
-    p -> prev = NULL;
-    ch -> ref_init = 1; //initialization
-  } else { //if the bs is not the first one to be added.
-    ch -> ref_list -> tail -> next = p;
-    p -> prev = ch -> ref_list -> tail;
+    ch = chr_block_add (bw->chr[c].chr, chr_block_head, &idx); //adding chr link list (if the chr is already linked, the linked one is returned)
+    sig_reserve (ch, kept);
+    for (r = 0; r < kept; r++) sig_add (ch, rec[r].st, rec[r].ed, rec[r].val);
   }
 
-  p -> next = NULL;
-  ch -> ref_list -> tail = p;
-
+  MYFREE(idx.blk);
+  MYFREE(blk);
+  MYFREE(rec);
+  ga_bw_close (bw);
   return 0;
 
 err:
-  MYFREE (p);
+  MYFREE(idx.blk);
+  MYFREE(blk);
+  MYFREE(rec);
+  ga_bw_close (bw);
   return -1;
 }
 
-/*pointer which must be freed: struct sig *p */
+/*pointer which must be freed: return value (region_set_free)*/
 /*
- * This adds new struct bs list
- * *chr: pointer to chr name
- * **chr_block_head: pointer of pointer to the head of the link
- * st: start position
- * ed: end position
- * *line: pointer to each line which is read
+ * This makes query regions of all chrs from bs +- margin of all lists, so several summit sets are queried at once.
+ * *region_head[]: heads of chr blocks of summits or regions
+ * region_nb     : number of the heads
+ * margin        : margin added to both sides of each bs
  */
-static struct sig *sig_add (const char *chr, struct chr_block **chr_block_head, const unsigned long st, const unsigned long ed, const float val)
+static struct region_set *region_set_new (struct chr_block *region_head[], const int region_nb, const long margin)
 {
-  struct sig *p;
-  struct chr_block *ch;
+  struct region_set *rs;
+  struct chr_block *rc;
+  int *len, h, id;
+
+  rs = (struct region_set *)my_malloc(sizeof(struct region_set));
+  rs->len = ga_chr_nb() ? ga_chr_nb() : 1;
+  rs->reg = (struct region **)my_calloc(rs->len, sizeof(struct region *));
+  rs->nb = (int *)my_calloc(rs->len, sizeof(int));
+  len = (int *)my_calloc(rs->len, sizeof(int)); //allocated length of reg[id]
+  for (h = 0; h < region_nb; h++) {
+    for (rc = region_head[h]; rc; rc = rc->next) {
+      rs->nb[rc->id] = region_make (rc, margin, &rs->reg[rc->id], &len[rc->id], rs->nb[rc->id]);
+    }
+  }
+  for (id = 0; id < rs->len; id++) rs->nb[id] = region_merge (rs->reg[id], rs->nb[id]);
+  MYFREE(len);
+  return rs;
+}
 
-  p = my_malloc(sizeof(struct sig));
-  p -> st = st; //assigning start position
-  p -> ed = ed; //assigning end position
-  p -> val = val; //assigning value
+/*
+ * This frees struct region_set.
+ */
+static void region_set_free (struct region_set *rs)
+{
+  int id;
+
+  if (rs == NULL) return;
+  for (id = 0; id < rs->len; id++) MYFREE(rs->reg[id]);
+  MYFREE(rs->reg);
+  MYFREE(rs->nb);
+  MYFREE(rs);
+}
+
+/*
+ * This returns 1 if the chr is queried or rs is NULL, otherwise 0.
+ */
+static int region_chr (const struct region_set *rs, const char *chr)
+{
+  int id;
+
+  if (rs == NULL) return 1;
+  id = ga_chr_find (chr);
+  return (id >= 0 && id < rs->len && rs->nb[id] > 0);
+}
+
+/*
+ * This returns 1 if st-ed on the chr of id overlaps one of the regions, otherwise 0.
+ */
+static int region_hit (const struct region_set *rs, const int id, const unsigned long st, const unsigned long ed)
+{
+  int k;
+
+  if (id >= rs->len || rs->nb[id] == 0) return 0;
+  k = region_find (rs->reg[id], rs->nb[id], st);
+  return (k < rs->nb[id] && rs->reg[id][k].st < ed);
+}
+
+/*
+ * This finds the first region which ends after st by binary search. This returns nb if there's no such region.
+ */
+static int region_find (const struct region *reg, const int nb, const unsigned long st)
+{
+  int lo = 0, hi = nb, m;
 
-  for (ch = *chr_block_head; ch; ch = ch->next) { //checking chr is already in chr_block list
-    if (!strcmp(chr, ch->chr)) break;
+  while (lo < hi) {
+    m = (lo + hi) / 2;
+    if (reg[m].ed <= st) lo = m + 1;
+    else hi = m;
   }
+  return lo;
+}
 
-  if (ch == NULL) {
-    fprintf(stderr, "error: chr %s is not in the chr block list", chr);
-    goto err;
+/*
+ * This adds the query regions of one chr, bs +- margin, after nb regions of *reg. They are sorted and merged by region_merge.
+ * *rc     : chr block of the regions
+ * margin  : margin added to both sides of each bs
+ * **reg   : array of struct region, which is reallocated as needed
+ * *reg_len: allocated length of *reg
+ * nb      : number of regions already in *reg
+ * This returns the number of regions.
+ */
+static int region_make (struct chr_block *rc, const long margin, struct region **reg, int *reg_len, int nb)
+{
+  struct bs *bs;
+
+  for (bs = rc->bs_list; bs; bs = bs->next) {
+    if (nb == *reg_len) {
+      *reg_len = *reg_len ? *reg_len * 2 : 1024;
+      *reg = (struct region *)my_realloc(*reg, *reg_len * sizeof(struct region));
+    }
+    (*reg)[nb].st = bs->st > (unsigned long)margin ? bs->st - margin : 0;
+    (*reg)[nb].ed = (bs->ed > bs->st ? bs->ed : bs->st) + margin + 1;
+    nb++;
   }
+  return nb;
+}
 
-  /*initialization of sig block*/
-  if (!ch -> sig_init) { //if the sig is the first one to be added.
-    ch -> sig_list = NULL;
-    ch -> sig_init = 1; //initialization
+/*
+ * This sorts the regions of one chr and merges overlapping ones.
+ * This returns the number of merged regions.
+ */
+static int region_merge (struct region *reg, const int nb)
+{
+  int i, k;
+
+  if (nb == 0) return 0;
+
+  qsort(reg, nb, sizeof(struct region), region_cmp);
+  for (i = 1, k = 0; i < nb; i++) { //merging overlapping regions
+    if (reg[i].st <= reg[k].ed) {
+      if (reg[i].ed > reg[k].ed) reg[k].ed = reg[i].ed;
+    } else {
+      reg[++k] = reg[i];
+    }
   }
+  return k + 1;
+}
 
-  p -> prev = NULL;
-  p -> next = ch -> sig_list; //adding new sig
-  if (ch -> sig_list) ch -> sig_list -> prev = p;
-  ch -> sig_list = p;
+/*
+ * This compares regions by start position for qsort.
+ */
+static int region_cmp (const void *a, const void *b)
+{
+  const struct region *x = (const struct region *)a, *y = (const struct region *)b;
 
-  return (p);
+  if (x->st < y->st) return -1;
+  else if (x->st > y->st) return 1;
+  return 0;
+}
 
-err:
-  MYFREE (p);
-  return (NULL);
+/*
+ * This compares bigWig blocks by file offset for qsort.
+ */
+static int bw_block_cmp (const void *a, const void *b)
+{
+  const struct bw_block *x = (const struct bw_block *)a, *y = (const struct bw_block *)b;
+
+  if (x->offset < y->offset) return -1;
+  else if (x->offset > y->offset) return 1;
+  return 0;
 }
 
-/*pointer which must be freed: struct sig *p */
 /*
- * This parses separated wig.gz files.
- * *filename       : file name
+ * This parses signal file according to the signal format.
+ * *filename       : file name (or prefix for sepwiggz)
+ * *sigfmt         : signal format, bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig
  * **chr_block_head: pointer of pointer to struct chr_block
  */
-void ga_parse_sepwiggz (const char *filename, struct chr_block **chr_block_head)
+int ga_parse_sig (const char *filename, const char *sigfmt, struct chr_block **chr_block_head)
 {
-  char line[LINE_STR_LEN] = {0}, tmpfile[128] = {0}, str[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}, fileline[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0}, str_last[PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN] = {0};
+  return parse_sig (filename, sigfmt, chr_block_head, NULL, 0);
+}
 
-  char *step=NULL, *chr=NULL, *chr_tmp=NULL, *span=NULL, *span_tmp=NULL, *val_tmp=NULL, *st_tmp=NULL, *start=NULL, *step_tmp=NULL, *step_p=NULL, *e;
-  int span_val=1, step_val=0;
-  unsigned long st=0;
-  struct gzFile_s *gfp = NULL;
-  FILE *fp = NULL;
+/*
+ * This parses signal file around the query regions, bs +- margin of *region_head.
+ * Chrs without bs are skipped as a whole, and sig which doesn't overlap any bs +- margin is not stored,
+ * so memory and time scale with the queried regions rather than the genome.
+ * *filename       : file name (or prefix for sepwiggz)
+ * *sigfmt         : signal format, bedgraph | sepwiggz | onewiggz | sigbin | sigshm | bigwig
+ * **chr_block_head: pointer of pointer to struct chr_block
+ * *region_head    : chr blocks of summits or regions. If NULL, the whole file is parsed.
+ * margin          : margin added to both sides of each bs
+ * win             : window size for bigWig zoom level. If 0, base level is used.
+ */
+int ga_parse_sig_region (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, struct chr_block *region_head, const long margin, const int win)
+{
+  return ga_parse_sig_regions (filename, sigfmt, chr_block_head, &region_head, region_head ? 1 : 0, margin, win);
+}
 
-  sprintf(tmpfile,"/tmp/ls%d.tmp",getpid()); //tmp file
-  sprintf(str,"ls -1 %s_*.wig.gz > %s", filename, tmpfile); //list of wig.gz file is written in tmp file
-  if(system(str) == -1) {
-    LOG("error: system error for 'ls -1 filename*.wig.gz > tmpfile'");
-    goto err;
+/*
+ * This is ga_parse_sig_region with several lists of query regions, e.g. summit sets parsed one by one.
+ * sig around bs +- margin of any of the lists is parsed, so each list is parsed only once for its own use.
+ * *region_head[]: heads of chr blocks of summits or regions
+ * region_nb     : number of the heads. If 0, the whole file is parsed.
+ */
+int ga_parse_sig_regions (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb, const long margin, const int win)
+{
+  struct region_set *rs = NULL;
+  int ret;
+
+  if (region_nb > 0) rs = region_set_new (region_head, region_nb, margin);
+  ret = parse_sig (filename, sigfmt, chr_block_head, rs, win);
+  region_set_free (rs);
+  return ret;
+}
+
+/*
+ * This is the body of ga_parse_sig and ga_parse_sig_region(s).
+ * *rs: query regions, or NULL for the whole file
+ * win: window size for bigWig zoom level
+ */
+static int parse_sig (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, const struct region_set *rs, const int win)
+{
+  if (!strcmp(sigfmt, "bedgraph")) {
+    parse_bedgraph (filename, chr_block_head, rs);
+  } else if (!strcmp(sigfmt, "sepwiggz")) {
+    parse_sepwiggz (filename, chr_block_head, rs);
+  } else if (!strcmp(sigfmt, "onewiggz")) {
+    parse_onewiggz (filename, chr_block_head, rs);
+  } else if (!strcmp(sigfmt, "sigbin")) {
+    if (parse_sigbin (filename, chr_block_head, rs, 0) != 0) {
+      LOG("error: error in ga_parse_sigbin function.");
+      return -1;
+    }
+  } else if (!strcmp(sigfmt, "sigshm")) {
+    if (parse_sigbin (filename, chr_block_head, rs, 1) != 0) {
+      LOG("error: error in ga_parse_sigshm function.");
+      return -1;
+    }
+  } else if (!strcmp(sigfmt, "bigwig")) {
+    if (parse_bigwig (filename, chr_block_head, rs, win) != 0) {
+      LOG("error: error in ga_parse_bigwig function.");
+      return -1;
+    }
+  } else {
+    LOG("error: invalid signal file format.");
+    return -1;
   }
+  sig_block_check (*chr_block_head);
+  sig_trim (*chr_block_head); //the spare length of the arrays is released
 
-  if ((fp = fopen (tmpfile, "r")) == NULL) {
-    LOG("errer: tmp file cannot be open.");
-//    goto err;
-    exit(EXIT_FAILURE);
+  return 0;
+}
+
+/*
+ * This makes null-terminated string of line of bs or ref, which is not terminated in the mapped input file.
+ * *buf: buffer of LINE_STR_LEN chars
+ * *line: line of bs or ref
+ * len: line_len of bs or ref
+ * This returns buf.
+ */
+char *ga_line (char *buf, const char *line, const unsigned int len)
+{
+  memcpy(buf, line, len);
+  buf[len] = '\0';
+  return buf;
+}
+
+/*
+ * This simply sum total peak number from each chr.
+ * *chr_block_head: pointer to struct chr_block
+ */
+unsigned long ga_count_peaks (struct chr_block *chr_block_head)
+{
+  unsigned long smt = 0;
+  struct chr_block *ch;
+  for (ch = chr_block_head; ch; ch = ch->next) {
+    smt = smt + ch -> bs_nb; //adding each bs_nb for each chr
   }
+  return smt;
+}
 
-  while (fgets(fileline, (PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN) * sizeof(char), fp) != NULL) { //reading file name list
-    if (strlen(fileline) >= PATH_STR_LEN + FILE_STR_LEN + EXT_STR_LEN -1) {
-      LOG("errer: filename is too long.");
-      goto err;
-    }
+/*pointer which must be freed: ch->sig_cum */
+/*
+ * This makes prefix-sum index of sig of each chr block: sig_cum[i] is the sum of val * (ed - st) of sig before i.
+ * The index is made only for chr whose sig are sorted and don't overlap each other, otherwise sig_cum is left NULL
+ * and the sig is scanned as before.
+ * *chr_block_head: pointer to the head of the link. sig must be sorted by ga_sort_chr_block_sig.
+ */
+void ga_index_sig (struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+  unsigned long i;
 
-    fileline[strlen(fileline) - 1] = '\0'; // the last \n is set as \0
-    if ((gfp = gzopen (fileline, "r")) == NULL) {
-      LOG("errer: input file cannot be open.");
-//      goto err;
-      exit(EXIT_FAILURE);
+  for (ch = chr_block_head; ch; ch = ch->next) {
+    MYFREE(ch->sig_cum);
+    if (!ch->sig_nb) continue;
+    if (!ga_sig_disjoint (ch)) { //overlapping sig
+      fprintf(stderr, "warning: signal on %s overlaps each other. the index is not used for the chr.\n", ch->chr);
+      continue;
     }
+    ch->sig_cum = (double *)my_malloc((ch->sig_nb + 1) * sizeof(double));
+    ch->sig_cum[0] = 0;
+    for (i = 0; i < ch->sig_nb; i++) ch->sig_cum[i + 1] = ch->sig_cum[i] + (double)SIG_VAL(ch, i) * (SIG_ED(ch, i) - SIG_ST(ch, i));
+  }
+}
 
-    while (gzgets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line of each wig.gz
-      if (strlen(line) >= LINE_STR_LEN -1) {
-        LOG("errer: line length is too long.");
-        goto err;
+/*
+ * This compacts sorted sig of each chr block: adjacent sig with the same value (ed of one is st of the next) are merged into one,
+ * and sig with value 0 is removed if drop_zero. Sums of val * length in any window are kept except for float rounding,
+ * so the scan of sig gets shorter. sig with value 0 must be kept if the tool tells windows without sig from windows with 0.
+ * Dense sig blocks are not compacted.
+ * *chr_block_head: pointer to the head of the link. sig must be sorted by ga_sort_chr_block_sig, and not indexed or quantized yet.
+ * drop_zero: if 1, sig with value 0 is removed
+ * This prints the number of sig before and after the compaction, if there are sig arrays.
+ */
+void ga_compact_sig (struct chr_block *chr_block_head, const int drop_zero)
+{
+  struct chr_block *ch;
+  unsigned long i, n, before = 0, after = 0;
+
+  for (ch = chr_block_head; ch; ch = ch->next) {
+    if (!ch->sig_nb || ch->sig_q) continue;
+    sig_own (ch); //sig of signal store are compacted in own arrays
+    before += ch->sig_nb;
+    for (i = 0, n = 0; i < ch->sig_nb; i++) {
+      if (drop_zero && ch->sig_val[i] == 0) continue;
+      if (n && SIG_ED(ch, n - 1) == SIG_ST(ch, i) && ch->sig_val[n - 1] == ch->sig_val[i]) { //extending the previous sig
+        sig_set (ch, n - 1, SIG_ST(ch, n - 1), SIG_ED(ch, i));
+        continue;
       }
+      sig_set (ch, n, SIG_ST(ch, i), SIG_ED(ch, i));
+      ch->sig_val[n] = ch->sig_val[i];
+      n++;
+    }
+    after += n;
+    if (n == ch->sig_nb) continue;
+    ch->sig_nb = n;
+    if (n == 0) { //all sig are 0
+      MYFREE(ch->sig_st);
+      MYFREE(ch->sig_ed);
+      MYFREE(ch->sig_st32);
+      MYFREE(ch->sig_ed32);
+      MYFREE(ch->sig_val);
+      ch->sig_len = 0;
+      continue;
+    }
+    sig_resize (ch, n);
+  }
 
-      step = extract_val_line(line, 0, '\t'); //extracting step, chr, and so on...
+  if (before) printf("signal compaction: %lu -> %lu records (%.1f%%)\n", before, after, 100.0 * after / before);
+}
 
-      if (!strcmp(step, "variableStep")) {
-        chr_tmp  = extract_val_line(line, 1, '\t');
-        span_tmp = extract_val_line(line, 2, '\t');
-        chr = pickup_str (chr_tmp, 6);
-        chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
-        if (span_tmp!=NULL) {
-          span = pickup_str (span_tmp, 5);
-          span_val = atoi(span);
-          MYFREE(span);
-          MYFREE(span_tmp);
-        }
-        MYFREE(chr_tmp);
-        break;
-      } else if (!strcmp(step, "fixedStep")) {
-        chr_tmp  = extract_val_line(line, 1, '\t');
-        st_tmp   = extract_val_line(line, 2, '\t');
-        step_tmp = extract_val_line(line, 3, '\t');
-        span_tmp = extract_val_line(line, 4, '\t');
-
-        chr = pickup_str (chr_tmp, 6);
-        chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
-
-        start = pickup_str (st_tmp, 6);
-        st = strtoul(start, &e, 10); //start pos (unsigned long)
-        step_p = pickup_str (step_tmp, 5);
-        step_val = atoi(step_p);
-        if (span_tmp!=NULL) {
-          span = pickup_str (span_tmp, 5);
-          span_val = atoi(span);
-          MYFREE(span);
-          MYFREE(span_tmp);
-        }
-        MYFREE(chr_tmp);
-        MYFREE(st_tmp);
-        MYFREE(start);
-        MYFREE(step_tmp);
-        MYFREE(step_p);
-        break;
+/*pointer which must be freed: ch->sig_q, ch->sig_blk[]->q */
+/*
+ * This quantizes values of sig arrays and dense sig blocks of each chr block into 16 bits, and frees the float values.
+ * "half" keeps 16-bit floats (about 3 significant digits, up to 65504), and "int16" keeps integers scaled by the max absolute value of the chr.
+ * Values are decoded by SIG_VAL in the window sums, so sums may differ from float values by the precision.
+ * *chr_block_head: pointer to the head of the link. This must be called after sorting and compaction, and before indexing.
+ * *mode: none | half | int16
+ * This returns 0 if the mode is valid, otherwise -1.
+ */
+int ga_quantize_sig (struct chr_block *chr_block_head, const char *mode)
+{
+  struct chr_block *ch;
+  struct sig_block *b;
+  unsigned long i, clamp = 0;
+  float max;
+  long q;
+  int quant, h;
+
+  if (!strcmp(mode, "none")) return 0;
+  else if (!strcmp(mode, "half")) quant = SIG_QUANT_HALF;
+  else if (!strcmp(mode, "int16")) quant = SIG_QUANT_INT16;
+  else {
+    LOG("error: invalid quantization mode.");
+    return -1;
+  }
+  if (quant == SIG_QUANT_HALF) {
+    for (h = 0; h < 65536; h++) ga_half_table[h] = half_float ((uint16_t)h);
+  }
+
+  for (ch = chr_block_head; ch; ch = ch->next) {
+    if (ch->sig_quant != SIG_QUANT_NONE) continue;
+    ch->sig_quant = quant;
+    if (quant == SIG_QUANT_INT16) {
+      max = 0;
+      for (i = 0; i < ch->sig_nb; i++) if (fabsf(ch->sig_val[i]) > max) max = fabsf(ch->sig_val[i]);
+      for (b = ch->sig_blk; b < ch->sig_blk + ch->sig_blk_nb; b++) {
+        for (i = 0; i < b->nb; i++) if (fabsf(b->val[i]) > max) max = fabsf(b->val[i]);
       }
+      ch->sig_scale = max > 0 ? max / 32767 : 1;
     }
 
-    if (!strcmp(step, "variableStep")) {
-      while (gzgets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
-        st_tmp  = extract_val_line(line, 0, '\t');
-        val_tmp = extract_val_line(line, 1, '\t');
-        st = strtoul(st_tmp, &e, 10);
-        sig_add (chr, chr_block_head, st, st + span_val, atof(val_tmp));
-        MYFREE(st_tmp);
-        MYFREE(val_tmp);
+    if (ch->sig_nb) {
+      ch->sig_q = (uint16_t *)my_malloc(ch->sig_nb * sizeof(uint16_t));
+      for (i = 0; i < ch->sig_nb; i++) {
+        if (quant == SIG_QUANT_HALF) {
+          if (fabsf(ch->sig_val[i]) > 65504) clamp++;
+          ch->sig_q[i] = half_bits (ch->sig_val[i]);
+        } else {
+          q = lrintf(ch->sig_val[i] / ch->sig_scale);
+          ch->sig_q[i] = (uint16_t)(int16_t)(q > 32767 ? 32767 : q < -32767 ? -32767 : q);
+        }
       }
-    } else if (!strcmp(step, "fixedStep")) {
-      while (gzgets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
-        val_tmp = extract_val_line(line, 0, '\t');
-        sig_add (chr, chr_block_head, st, st + span_val, atof(val_tmp));
-        MYFREE(val_tmp);
-        st += step_val;
+    }
+    if (ch->sig_map) ch->sig_val = NULL; //values of signal store are left in the mapping
+    else MYFREE(ch->sig_val);
+
+    for (b = ch->sig_blk; b < ch->sig_blk + ch->sig_blk_nb; b++) {
+      b->q = (uint16_t *)my_malloc(b->nb * sizeof(uint16_t));
+      for (i = 0; i < b->nb; i++) {
+        if (quant == SIG_QUANT_HALF) {
+          if (fabsf(b->val[i]) > 65504) clamp++;
+          b->q[i] = half_bits (b->val[i]);
+        } else {
+          q = lrintf(b->val[i] / ch->sig_scale);
+          b->q[i] = (uint16_t)(int16_t)(q > 32767 ? 32767 : q < -32767 ? -32767 : q);
+        }
       }
+      MYFREE(b->val);
     }
   }
 
-  MYFREE(chr);
-  MYFREE(step);
-  gzclose(gfp);
-  fclose(fp);
+  if (clamp) fprintf(stderr, "warning: %lu signal values are out of range of 16-bit float, and clamped to 65504.\n", clamp);
+  return 0;
+}
 
-  sprintf(str_last,"rm -f %s",tmpfile);
-  if(system(str_last) == -1) {
-    LOG("error: system error for 'rm -f tmpfile'");
-    goto err;
+/*
+ * This converts float into 16-bit float (IEEE 754 binary16) rounding to nearest (ties away from zero). Values out of range are clamped to the max.
+ */
+static uint16_t half_bits (const float f)
+{
+  uint32_t x, man, sign, h;
+  int exp;
+
+  memcpy(&x, &f, sizeof(x));
+  sign = (x >> 16) & 0x8000;
+  man = x & 0x7fffff;
+  if (((x >> 23) & 0xff) == 0xff) return sign | (man ? 0x7e00 : 0x7bff); //NaN, or inf clamped to the max
+
+  exp = (int)((x >> 23) & 0xff) - 127 + 15;
+  if (exp >= 31) return sign | 0x7bff;
+  if (exp <= 0) { //subnormal
+    if (exp < -10) return sign;
+    man |= 0x800000;
+    h = man >> (14 - exp);
+    if ((man >> (13 - exp)) & 1) h++;
+    return sign | h;
   }
-
-  return;
-
-err:
-  gzclose(gfp);
-  fclose(fp);
-  MYFREE(step);
-  MYFREE(chr);
-  MYFREE(chr_tmp);
-  MYFREE(span);
-  MYFREE(span_tmp);
-  MYFREE(val_tmp);
-  MYFREE(st_tmp);
-  MYFREE(start);
-  MYFREE(step_tmp);
-  MYFREE(step_p);
-  return;
+  h = ((uint32_t)exp << 10) | (man >> 13);
+  if (man & 0x1000) h++; //the carry goes into exp
+  if (h >= 0x7c00) h = 0x7bff;
+  return sign | h;
 }
 
 /*
- * This parses one wig.gz files.
- * *filename       : file name
- * **chr_block_head: pointer of pointer to struct chr_block
+ * This converts 16-bit float (IEEE 754 binary16) into float.
  */
-void ga_parse_onewiggz (const char *filename, struct chr_block **chr_block_head)
+static float half_float (const uint16_t h)
 {
-  char line[LINE_STR_LEN] = {0}, stephold[20] = {0};
+  uint32_t x, exp = (h >> 10) & 0x1f, man = h & 0x3ff;
+  float f;
 
-  char *step=NULL, *chr=NULL, *chr_tmp=NULL, *span=NULL, *span_tmp=NULL, *val_tmp=NULL, *st_tmp=NULL, *start=NULL, *step_tmp=NULL, *step_p=NULL, *e;
-  int span_val=1, st=0, step_val=0, fl=0;
-  struct gzFile_s *gfp = NULL;
-
-
-  if ((gfp = gzopen (filename, "r")) == NULL) {
-    LOG("errer: input file cannot be open.");
-//    goto err;
-    exit(EXIT_FAILURE);
+  if (exp == 0) { //zero or subnormal
+    f = man / 16777216.0f;
+    return h & 0x8000 ? -f : f;
   }
+  if (exp == 31) x = ((uint32_t)(h & 0x8000) << 16) | 0x7f800000 | (man << 13); //inf or NaN
+  else x = ((uint32_t)(h & 0x8000) << 16) | ((exp + 112) << 23) | (man << 13);
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
 
-  while (gzgets(gfp, line, LINE_STR_LEN * sizeof(char)) != NULL) { //reading each line
-    if (strlen(line) >= LINE_STR_LEN -1) {
-      LOG("errer: line length is too long.");
-      goto err;
-    }
-
-    step = extract_val_line(line, 0, ' '); //extracting step, chr, and so on...
-
-    if (!strcmp(step, "variableStep")) {
-      chr_tmp  = extract_val_line(line, 1, ' ');
-      span_tmp = extract_val_line(line, 2, ' ');
+/*
+ * This sums val * length of sig in st-ed by prefix-sum index, which is two binary searches whatever the width is.
+ * For chr block with dense sig blocks, the sig in st-ed are found by index arithmetic instead (see sig_block_sum).
+ * sig which partly overlaps st-ed is counted only for the overlapping length.
+ * *ch : pointer to chr block which has sig_cum made by ga_index_sig or sig_blk (see SIG_DIRECT)
+ * st  : start position
+ * ed  : end position
+ * *sum: the sum is returned
+ * This returns 1 if one of sig overlaps st-ed, otherwise 0 (*sum is 0).
+ */
+int ga_sig_sum (const struct chr_block *ch, const unsigned long st, const unsigned long ed, double *sum)
+{
+  unsigned long lo, hi, m, first;
 
-      chr = pickup_str (chr_tmp, 6);
-      chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
+  if (ch->sig_blk_nb) return sig_block_sum (ch, st, ed, sum);
 
-      if (span_tmp!=NULL) {
-        span = pickup_str (span_tmp, 5);
-        span_val = atoi(span);
-        MYFREE(span);
-        MYFREE(span_tmp);
-      }
-      MYFREE(chr_tmp);
-      fl = 1; //with the flag, the program can read the value.
-      strcpy(stephold, step);
-      continue;
-    } else if (!strcmp(step, "fixedStep")) {
-      chr_tmp  = extract_val_line(line, 1, ' ');
-      st_tmp   = extract_val_line(line, 2, ' ');
-      step_tmp = extract_val_line(line, 3, ' ');
-      span_tmp = extract_val_line(line, 4, ' ');
-
-      chr = pickup_str (chr_tmp, 6);
-      chr_block_add (chr, chr_block_head); //adding chr link list (if the chr is already linked, the input chr is just ignored)
-
-      start = pickup_str (st_tmp, 6);
-      st = strtoul(start, &e, 10); //start pos (unsigned long)
-      step_p = pickup_str (step_tmp, 5);
-      step_val = atoi(step_p);
-      if (span_tmp!=NULL) {
-        span = pickup_str (span_tmp, 5);
-        span_val = atoi(span);
-        MYFREE(span);
-        MYFREE(span_tmp);
-      }
-      MYFREE(chr_tmp);
-      MYFREE(st_tmp);
-      MYFREE(start);
-      MYFREE(step_tmp);
-      MYFREE(step_p);
-      fl = 1; //with the flag, the program can read the value
-      strcpy(stephold, step);
-      continue;
-    } else if (fl && !strcmp(stephold, "variableStep")) {
-      st_tmp  = extract_val_line(line, 0, ' ');
-      val_tmp = extract_val_line(line, 1, ' ');
-      st = strtoul(st_tmp, &e, 10);
-      sig_add (chr, chr_block_head, st, st + span_val, atof(val_tmp));
-      MYFREE(st_tmp);
-      MYFREE(val_tmp);
-    } else if (fl && !strcmp(stephold, "fixedStep")) {
-      val_tmp = extract_val_line(line, 0, ' ');
-      sig_add (chr, chr_block_head, st, st + span_val, atof(val_tmp));
-      MYFREE(val_tmp);
-      st += step_val;
-    }
+  for (lo = 0, hi = ch->sig_nb; lo < hi; ) { //the first sig which ends after st. ed is sorted because sig don't overlap
+    m = (lo + hi) / 2;
+    if (SIG_ED(ch, m) <= st) lo = m + 1;
+    else hi = m;
+  }
+  first = lo;
+  for (hi = ch->sig_nb; lo < hi; ) { //the first sig which starts at or after ed
+    m = (lo + hi) / 2;
+    if (SIG_ST(ch, m) < ed) lo = m + 1;
+    else hi = m;
   }
 
-  MYFREE(chr);
-  MYFREE(step);
-  gzclose(gfp);
+  *sum = 0;
+  if (first >= lo) return 0;
+  *sum = ch->sig_cum[lo] - ch->sig_cum[first];
+  if (SIG_ST(ch, first) < st) *sum -= (double)SIG_VAL(ch, first) * (st - SIG_ST(ch, first)); //the part before st
+  if (SIG_ED(ch, lo - 1) > ed) *sum -= (double)SIG_VAL(ch, lo - 1) * (SIG_ED(ch, lo - 1) - ed); //the part after ed
+  return 1;
+}
 
-  return;
+/*
+ * This checks that sig arrays of the chr block are sorted and don't overlap each other, which ga_index_sig and ga_sig_slide need.
+ * *ch : pointer to chr block
+ * This returns 1 if they are, otherwise 0.
+ */
+int ga_sig_disjoint (const struct chr_block *ch)
+{
+  unsigned long i;
 
-err:
-  gzclose(gfp);
-  MYFREE(step);
-  MYFREE(chr);
-  MYFREE(chr_tmp);
-  MYFREE(span);
-  MYFREE(span_tmp);
-  MYFREE(val_tmp);
-  MYFREE(st_tmp);
-  MYFREE(start);
-  MYFREE(step_tmp);
-  MYFREE(step_p);
-  return;
+  for (i = 1; i < ch->sig_nb && SIG_ED(ch, i - 1) <= SIG_ST(ch, i); i++);
+  return i >= ch->sig_nb;
 }
 
 /*
- *pointer which must be freed: char *strtemp
- * This picks up string from str
- * *str: original string
- * st  : the number where picking starts. For example, if the str = "chr=chr1" and you want to get "chr1", st = 4. For now, we cannot pick up string like "chr1" from "chr1=chr" or "aaa=chr1,bbb".
+ * This sums val * length of sig in nb windows, st + i * step to st + i * step + len (i < nb), by sliding one window along the sig:
+ * when the window moves by step, the span entering at its end is added and the span leaving at its start is subtracted.
+ * Both ends only go forward, so the sig are walked once for all the windows instead of once per window.
+ * The sums are in double, so the last digit may differ from the scan of sig in float.
+ * *ch  : pointer to chr block whose sig arrays are sorted and don't overlap each other (ga_sig_disjoint)
+ * *j   : index of sig which the search starts from. It is moved to the first sig which ends after the first window starts.
+ * st   : start position of the first window
+ * len  : window length
+ * step : step of windows
+ * nb   : number of windows
+ * sum[]: the sums are returned. Windows which start at a negative position are 0 like ga_sig_sum.
  */
-static char *pickup_str (const char *str, const int st) {
+void ga_sig_slide (const struct chr_block *ch, unsigned long *j, const long st, const long len, const long step, const int nb, double sum[])
+{
+  unsigned long lead, lag; //sig where the end and the start of the window are
+  double lead_cum = 0, lag_cum = 0; //sums of sig which the end and the start of the window have passed from *j
+  long x = st;
   int i;
-  int len = strlen(str);
 
-  char *strtemp = my_calloc (len, sizeof(char));
+  for (i = 0; i < nb && x < 0; i++, x += step) sum[i] = 0;
+  if (i == nb) return;
 
-  for (i = 0; ;i++) {
-    strtemp[i] = str[i+st];
-    if (str[i+st] == '\0') break;
-  }
+  while (*j < ch->sig_nb && SIG_ED(ch, *j) <= (unsigned long)x) (*j)++;
+  lead = lag = *j;
+  for (; i < nb; i++, x += step) sum[i] = sig_slide_cum (ch, &lead, &lead_cum, x + len) - sig_slide_cum (ch, &lag, &lag_cum, x);
+}
 
-  return strtemp;
+/*
+ * This moves an end of the window of ga_sig_slide to x, and returns the sum of sig before x from where the end started.
+ * *k  : sig where the end is. It is moved over the sig which end by x.
+ * *cum: sum of the whole sig which the end has passed. The sig are added when passed.
+ * x   : new position of the end. It must not go backward.
+ */
+static double sig_slide_cum (const struct chr_block *ch, unsigned long *k, double *cum, const unsigned long x)
+{
+  for (; *k < ch->sig_nb && SIG_ED(ch, *k) <= x; (*k)++) *cum += (double)SIG_VAL(ch, *k) * (SIG_ED(ch, *k) - SIG_ST(ch, *k));
+  if (*k < ch->sig_nb && SIG_ST(ch, *k) < x) return *cum + (double)SIG_VAL(ch, *k) * (x - SIG_ST(ch, *k)); //the part of sig which x is in
+  return *cum;
 }
 
 /*
- * This simply sum total peak number from each chr.
- * *chr_block_head: pointer to struct chr_block
+ * This is ga_sig_sum for dense sig blocks. The block is found by binary search, and sig in the block by its step.
+ * val * length is summed in float from the left like the scan of sig arrays, so the sum is the same as the scan.
  */
-unsigned long ga_count_peaks (struct chr_block *chr_block_head)
+static int sig_block_sum (const struct chr_block *ch, const unsigned long st, const unsigned long ed, double *sum)
 {
-  unsigned long smt = 0;
-  struct chr_block *ch;
-  for (ch = chr_block_head; ch; ch = ch->next) {
-    smt = smt + ch -> bs_nb; //adding each bs_nb for each chr
+  const struct sig_block *b;
+  unsigned long lo, hi, m, i, i_ed, s, e;
+  float val = 0;
+  int ov = 0;
+
+  for (lo = 0, hi = ch->sig_blk_nb; lo < hi; ) { //the first block which ends after st
+    m = (lo + hi) / 2;
+    b = &ch->sig_blk[m];
+    if (b->st + (b->nb - 1) * b->step + b->span <= st) lo = m + 1;
+    else hi = m;
   }
-  return smt;
+
+  for (b = ch->sig_blk + lo; b < ch->sig_blk + ch->sig_blk_nb && b->st < ed; b++) {
+    i = st < b->st + b->span ? 0 : (st - b->st - b->span) / b->step + 1; //the first sig which ends after st
+    i_ed = (ed - b->st - 1) / b->step + 1; //the first sig which starts at or after ed
+    if (i_ed > b->nb) i_ed = b->nb;
+    for (; i < i_ed; i++) {
+      s = b->st + i * b->step;
+      e = s + b->span;
+      val += SIG_BLOCK_VAL(ch, b, i) * (long)((e > ed ? ed : e) - (s < st ? st : s));
+      ov = 1;
+    }
+  }
+
+  *sum = val;
+  return ov;
 }
 
 /*
@@ -939,47 +3001,44 @@ unsigned long ga_count_peaks (struct chr_block *chr_block_head)
 void ga_free_chr_block (struct chr_block **chr_block)
 {
   struct chr_block *ch, *ch_tmp;
-  struct bs *bs, *bs_tmp;
-  struct sig *sig, *sig_tmp;
-  struct ref *ref, *ref_tmp;
+  struct ref *ref;
+  struct arena_chunk *c, *c_tmp;
+  unsigned long i;
 
   ch = *chr_block;
   while (ch) {
-    bs = ch -> bs_list;
-    sig = ch -> sig_list;
-    ref = ch -> ref_list;
-
-    if (ch->bs_init) {
-      while (bs) {
-        MYFREE(bs->line);
-        bs_tmp = bs->next;
-        MYFREE(bs);
-        bs = bs_tmp;
-      }
-    }
-
     if (ch->ref_init) {
-      while (ref) {
-        MYFREE(ref->ex_st);
-        MYFREE(ref->ex_ed);
+      for (ref = ch -> ref_list; ref; ref = ref->next) { //strings made by the tool
         MYFREE(ref->rm_ex_st);
         MYFREE(ref->rm_ex_ed);
-        MYFREE(ref->gene);
         MYFREE(ref->ov_gene);
-        MYFREE(ref->line);
-        ref_tmp = ref->next;
-        MYFREE(ref);
-        ref = ref_tmp;
       }
     }
 
-    if (ch->sig_init) {
-      while (sig) {
-        sig_tmp = sig->next;
-        MYFREE(sig);
-        sig = sig_tmp;
-      }
+    for (c = ch->arena; c; c = c_tmp) { //bs and ref records and their strings
+      c_tmp = c->next;
+      if (c->map) text_map_release (c->map); //lines point into the mapping
+      MYFREE(c);
+    }
+
+    if (ch->sig_map) { //sig arrays point into signal store
+      ch->sig_st = NULL;
+      ch->sig_ed = NULL;
+      ch->sig_val = NULL;
+      text_map_release (ch->sig_map);
+    }
+    MYFREE(ch->sig_st);
+    MYFREE(ch->sig_ed);
+    MYFREE(ch->sig_st32);
+    MYFREE(ch->sig_ed32);
+    MYFREE(ch->sig_val);
+    MYFREE(ch->sig_q);
+    MYFREE(ch->sig_cum);
+    for (i = 0; i < ch->sig_blk_nb; i++) {
+      MYFREE(ch->sig_blk[i].val);
+      MYFREE(ch->sig_blk[i].q);
     }
+    MYFREE(ch->sig_blk);
 
     MYFREE(ch->chr);
     ch_tmp = ch->next;
@@ -6,27 +6,116 @@
 #include <stdlib.h>
 #include <zlib.h>
 #include <time.h>
+#include <stdint.h>
 
 #include "write_tab.h"
 
 #define LINE_STR_LEN 100000 //char length per line
+#define SIGBIN_MAGIC "GASIGBN1" //magic string at the head of binary signal file
+#define SIGBIN_VERSION 1 //version of binary signal file
+#define SIGBIN_CHR_LEN 128 //max chr name length in binary signal file
+#define SIGBIN_SORTED 1 //flag: sig of each chr is sorted by start position
+#define SIGBIN_DISJOINT 2 //flag: sig of each chr is sorted and don't overlap each other (ga_sig_disjoint)
+#define LIST_ASC 1 //order flag: list is sorted by start position from the head
+#define LIST_DESC 2 //order flag: list is strictly descending by start position from the head
+#define ARENA_CHUNK_MIN 4096 //size of the first arena chunk of chr block
+#define ARENA_CHUNK_MAX (1 << 20) //arena chunks grow twice up to this size
+#define SIG_DIRECT(ch) ((ch)->sig_cum != NULL || (ch)->sig_blk_nb > 0) //sig of the chr block is summed by ga_sig_sum instead of scanning
+#define SIG_QUANT_NONE 0 //sig values are float
+#define SIG_QUANT_HALF 1 //sig values are 16-bit floats
+#define SIG_QUANT_INT16 2 //sig values are 16-bit integers scaled by sig_scale of the chr block
+#define SIG_DEQUANT(ch, q) ((ch)->sig_quant == SIG_QUANT_HALF ? ga_half_table[(q)] : (int16_t)(q) * (ch)->sig_scale) //value of quantized sig
+#define SIG_ST(ch, i) ((ch)->sig_wide ? (ch)->sig_st[i] : (unsigned long)(ch)->sig_st32[i]) //start of i-th sig
+#define SIG_ED(ch, i) ((ch)->sig_wide ? (ch)->sig_ed[i] : (unsigned long)(ch)->sig_ed32[i]) //end of i-th sig
+#define SIG_VAL(ch, i) ((ch)->sig_q ? SIG_DEQUANT((ch), (ch)->sig_q[i]) : (ch)->sig_val[i]) //value of i-th sig
+#define SIG_BLOCK_VAL(ch, b, i) ((b)->q ? SIG_DEQUANT((ch), (b)->q[i]) : (b)->val[i]) //value of i-th sig of dense sig block b
 
 /*
  * Structure of chr block.
  * This is a link list.
  * For each chr block, binding site(bs) list is linked.
+ * sig is stored as arrays (structure of arrays): i-th sig is SIG_ST(i), SIG_ED(i), sig_val[i] (i < sig_nb).
+ * Coordinates of sig are kept in 32-bit sig_st32 and sig_ed32, and in 64-bit sig_st and sig_ed only if one of them doesn't fit (sig_wide).
+ * bs_order, sig_order and ref_order are kept by the parser while the list is built (LIST_ASC and/or LIST_DESC),
+ * so ga_sort_chr_block_* can skip sorting of the list which is already in order.
+ * sig_order uses only LIST_ASC.
+ * bs and ref records and their strings are allocated from arena of the chr block, and freed at once by ga_free_chr_block.
+ * If the input file is mapped, lines of bs and ref point into the mapping, which is kept while an arena chunk holds a reference to it.
+ * fixedStep wig is stored as dense sig blocks (sig_blk) instead of the sig arrays. A chr block has either of them after parsing.
+ * After ga_quantize_sig, values are kept as 16-bit sig_q (and q of sig blocks) instead of float, and must be read by SIG_VAL (SIG_BLOCK_VAL).
+ * sig attached from shared-memory signal store (sigshm) point into the mapping (sig_map) with 64-bit coordinates, and are sorted.
+ * They are copied to own arrays before they are changed (compaction, growth), and are not freed by ga_free_chr_block.
  */
 struct chr_block {
   char *chr;
+  int id; //chr ID given by chr dictionary
   struct chr_block *next;
   struct chr_block *tail;
   struct bs *bs_list;
-  struct sig *sig_list;
   struct ref *ref_list;
+  unsigned long *sig_st; //used if sig_wide
+  unsigned long *sig_ed;
+  uint32_t *sig_st32; //used unless sig_wide
+  uint32_t *sig_ed32;
+  float *sig_val;
+  uint16_t *sig_q; //quantized sig_val made by ga_quantize_sig, or NULL
+  double *sig_cum; //prefix-sum index of sig made by ga_index_sig, or NULL
+  struct sig_block *sig_blk; //dense sig blocks sorted by start position
+  struct arena_chunk *arena; //the newest chunk first
+  struct text_map *map; //mapped input file which the newest reference of arena is held for, or NULL
+  struct text_map *sig_map; //mapped signal store which sig arrays point into (read-only), or NULL
+  unsigned long sig_nb;
+  unsigned long sig_len; //allocated length of sig arrays
+  unsigned long sig_blk_nb;
+  unsigned long sig_blk_len; //allocated length of sig_blk
+  float sig_scale; //scale of SIG_QUANT_INT16
+  int sig_quant; //SIG_QUANT_*
+  int sig_wide; //1 if sig coordinates are 64-bit
   unsigned long bs_nb;
   int bs_init;
   int sig_init;
   int ref_init;
+  int bs_order;
+  int sig_order;
+  int ref_order;
+};
+
+/*
+ * Structure of dense sig block.
+ * This is one run of fixedStep wig: i-th sig (i < nb) is st + i * step to st + i * step + span with value val[i].
+ * Only blocks with span <= step are made, so sig in a block don't overlap each other.
+ */
+struct sig_block {
+  unsigned long st;
+  unsigned long step;
+  unsigned long span;
+  unsigned long nb;
+  unsigned long len; //allocated length of val
+  float *val;
+  uint16_t *q; //quantized val made by ga_quantize_sig, or NULL
+};
+
+/*
+ * Structure of arena chunk.
+ * Records and strings are bump-allocated from data[] from the head, and the chunks are linked by next.
+ * A chunk may hold a reference to mapped input file instead of data (len is 0), and releases it when freed.
+ */
+struct arena_chunk {
+  struct arena_chunk *next;
+  struct text_map *map; //mapped input file, or NULL
+  size_t len; //size of data[]
+  size_t used;
+  char data[];
+};
+
+/*
+ * Structure of mapped input file.
+ * Lines of bs and ref (or sig arrays of signal store) point into p[] instead of being copied, so the mapping is unmapped when the last reference is released.
+ */
+struct text_map {
+  char *p;
+  size_t len;
+  int ref; //number of references held by the parser, arena chunks and sig_map
 };
 
 /*
@@ -36,6 +125,7 @@ struct chr_block {
  */
 struct chr_block_fa {
   char *chr;
+  int id; //chr ID given by chr dictionary
   char *letter;
   struct chr_block_fa *next;
   struct chr_block_fa *tail;
@@ -46,42 +136,34 @@ struct chr_block_fa {
  * Structure of bs.
  * This is a link list.
  * Binding site(bs) list is linked to one chr block.
+ * bs is allocated from arena of the chr block, so it must not be freed one by one.
+ * line is line_len bytes in the mapped input file (or in arena) with the trailing '\n' as read by fgets, and is not null-terminated. ga_line makes the string.
  */
 struct bs {
   unsigned long st;
   unsigned long ed;
   char strand;
-  char *line;
+  unsigned int line_len;
+  const char *line;
   struct bs *next;
   struct bs *prev;
 };
 
-/*
- * Structure of sig.
- * This is a link list.
- * sig data list is linked to one chr block.
- */
-struct sig {
-  unsigned long st;
-  unsigned long ed;
-  float val;
-  struct sig *next;
-  struct sig *prev;
-};
-
 /*
  * Structure of ref.
  * This is a link list.
  * reference list is linked to one chr block.
- * *ex_st, *ex_ed, *line must be freed.
+ * ref, *ex_st, *ex_ed and *gene are allocated from arena of the chr block. line is not null-terminated like that of bs.
+ * *rm_ex_st, *rm_ex_ed and *ov_gene are made by the tool with malloc, and must be freed.
  */
 struct ref {
   unsigned long st;
   unsigned long ed;
   char strand;
+  unsigned int line_len;
   char *ex_st;
   char *ex_ed;
-  char *line;
+  const char *line;
   char *gene;
   char *rm_ex_st;
   char *rm_ex_ed;
@@ -92,7 +174,49 @@ struct ref {
   struct ref *prev;
 };
 
+/*
+ * Structure of binary signal file header.
+ * The file is "header | chr directory (chr_nb entries) | st, ed, val arrays of each chr".
+ * Values are written in the native byte order.
+ * The same layout is placed in POSIX shared memory as signal store (sigshm), which tools attach without copying.
+ */
+struct sigbin_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t chr_nb;
+};
+
+/*
+ * Structure of binary signal file chr directory.
+ * Offsets are bytes from the head of the file. Each array is 8-byte aligned.
+ */
+struct sigbin_chr {
+  char chr[SIGBIN_CHR_LEN];
+  uint64_t sig_nb;
+  uint64_t st_offset; //uint64_t st[sig_nb]
+  uint64_t ed_offset; //uint64_t ed[sig_nb]
+  uint64_t val_offset; //float val[sig_nb]
+};
+
+/*
+ * Structure of chr dictionary.
+ * chr names are interned to dense integer IDs (0, 1, 2, ...) which are shared by all tracks loaded in the program,
+ * so chr blocks of different tracks can be matched by ID instead of strcmp.
+ * slot[] is an open addressing hash table of IDs. -1 means empty slot.
+ */
+struct chr_dict {
+  char **name; //name[id]
+  int nb; //number of IDs
+  int name_len; //allocated length of name[]
+  int *slot;
+  int slot_len; //power of 2
+};
+
 extern char *ga_header_line;
+extern int ga_thread_nb;
+extern int ga_pipe_stat;
+extern float ga_half_table[65536];
 
 void ga_parse_chr_bs (const char *filename, struct chr_block **chr_block_head, int col_chr, int col_st, int col_ed, int col_strand, int hf);
 void ga_parse_chr_bs_rand (struct chr_block **chr_block_head, struct chr_block *chr_block_head_ori, struct chr_block *chr_table, int hw);
@@ -101,8 +225,28 @@ int ga_parse_chr_fa (const char *filename, struct chr_block_fa **chr_block_head,
 void ga_parse_bedgraph (const char *filename, struct chr_block **chr_block_head);
 void ga_parse_sepwiggz (const char *filename, struct chr_block **chr_block_head);
 void ga_parse_onewiggz (const char *filename, struct chr_block **chr_block_head);
+int ga_parse_sigbin (const char *filename, struct chr_block **chr_block_head);
+int ga_parse_sigshm (const char *name, struct chr_block **chr_block_head);
+int ga_parse_bigwig (const char *filename, struct chr_block **chr_block_head);
+int ga_parse_sig (const char *filename, const char *sigfmt, struct chr_block **chr_block_head);
+int ga_parse_sig_region (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, struct chr_block *region_head, const long margin, const int win);
+int ga_parse_sig_regions (const char *filename, const char *sigfmt, struct chr_block **chr_block_head, struct chr_block *region_head[], const int region_nb, const long margin, const int win);
 void ga_free_chr_block (struct chr_block **chr_block);
 void ga_free_chr_block_fa (struct chr_block_fa **chr_block);
 unsigned long ga_count_peaks (struct chr_block *chr_block_head);
+void ga_index_sig (struct chr_block *chr_block_head);
+void ga_compact_sig (struct chr_block *chr_block_head, const int drop_zero);
+int ga_quantize_sig (struct chr_block *chr_block_head, const char *mode);
+void ga_expand_sig (struct chr_block *chr_block_head);
+char *ga_line (char *buf, const char *line, const unsigned int len);
+int ga_sig_sum (const struct chr_block *ch, const unsigned long st, const unsigned long ed, double *sum);
+int ga_sig_disjoint (const struct chr_block *ch);
+void ga_sig_slide (const struct chr_block *ch, unsigned long *j, const long st, const long len, const long step, const int nb, double sum[]);
+int ga_chr_id (const char *chr);
+int ga_chr_find (const char *chr);
+int ga_chr_nb (void);
+struct chr_block **ga_index_chr_block (struct chr_block *chr_block_head);
+struct chr_block_fa **ga_index_chr_block_fa (struct chr_block_fa *chr_block_head);
+void ga_free_chr_dict (void);
 
 #endif
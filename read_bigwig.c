@@ -0,0 +1,377 @@
+/*
+ * This program is one of the genome analysis tools.
+ * This program reads bigWig files.
+ * Data blocks overlapping a region are found by the R tree index, so only the needed blocks are read and inflated.
+ * Zoom levels are read by the same way, which gives summaries of signal without base level data.
+ */
+
+#include "read_bigwig.h"
+#include "ga_my.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define LOG(m) \
+  fprintf(stderr, \
+  "%s:line%d:%s(): " m "\n", \
+  __FILE__, __LINE__, __FUNCTION__)
+
+#define BW_HEADER_LEN 64
+#define BW_ZOOM_HEADER_LEN 24
+#define BW_CHR_TREE_HEADER_LEN 32
+#define BW_RTREE_HEADER_LEN 48
+#define BW_SECTION_HEADER_LEN 24
+#define BW_ZOOM_REC_LEN 32
+
+static uint16_t get_u16 (const unsigned char *p);
+static uint32_t get_u32 (const unsigned char *p);
+static uint64_t get_u64 (const unsigned char *p);
+static float get_f (const unsigned char *p);
+static int read_at (struct bigwig *bw, void *buf, const size_t len, const uint64_t offset);
+static int chr_tree_read (struct bigwig *bw, const uint64_t offset, const uint32_t key_len);
+static int rtree_read (struct bigwig *bw, const uint64_t offset, const uint32_t chr_id, const uint32_t st, const uint32_t ed, struct bw_block **blk, int *blk_nb, int *blk_len, const int depth);
+static void rec_add (struct bw_rec **rec, long *rec_nb, long *rec_len, const uint32_t st, const uint32_t ed, const float val);
+
+/*pointer which must be freed: return value (ga_bw_close)*/
+/*
+ * This opens bigWig file and reads the header, zoom headers and chromosome list.
+ * *filename: file name
+ * This returns NULL if the file is not bigWig.
+ */
+struct bigwig *ga_bw_open (const char *filename)
+{
+  unsigned char h[BW_HEADER_LEN], z[BW_ZOOM_HEADER_LEN], t[BW_CHR_TREE_HEADER_LEN];
+  struct bigwig *bw;
+  uint64_t chr_tree_offset;
+  int i;
+
+  bw = (struct bigwig *)my_calloc(1, sizeof(struct bigwig));
+  if ((bw->fd = open (filename, O_RDONLY)) < 0) {
+    LOG("errer: input file cannot be open.");
+    MYFREE(bw);
+    return NULL;
+  }
+
+  if (read_at(bw, h, BW_HEADER_LEN, 0) != 0) goto err;
+  if (get_u32(h) != BW_MAGIC) {
+    if (h[0] == 0x88 && h[1] == 0x8f && h[2] == 0xfc && h[3] == 0x26) LOG("error: big endian bigWig is not supported.");
+    else LOG("error: input file is not bigWig.");
+    goto err;
+  }
+  bw->zoom_nb = get_u16(h + 6);
+  chr_tree_offset = get_u64(h + 8);
+  bw->index_offset = get_u64(h + 24);
+  bw->uncompress_len = get_u32(h + 52);
+
+  bw->zoom = (struct bw_zoom *)my_calloc(bw->zoom_nb + 1, sizeof(struct bw_zoom));
+  for (i = 0; i < bw->zoom_nb; i++) { //zoom headers follow the header
+    if (read_at(bw, z, BW_ZOOM_HEADER_LEN, BW_HEADER_LEN + i * BW_ZOOM_HEADER_LEN) != 0) goto err;
+    bw->zoom[i].level = get_u32(z);
+    bw->zoom[i].data_offset = get_u64(z + 8);
+    bw->zoom[i].index_offset = get_u64(z + 16);
+  }
+
+  if (read_at(bw, t, BW_CHR_TREE_HEADER_LEN, chr_tree_offset) != 0) goto err;
+  if (get_u32(t) != BW_CHR_TREE_MAGIC) {
+    LOG("error: chromosome tree of bigWig is broken.");
+    goto err;
+  }
+  bw->chr_nb = (uint32_t)get_u64(t + 16);
+  bw->chr = (struct bw_chr *)my_calloc(bw->chr_nb + 1, sizeof(struct bw_chr));
+  if (chr_tree_read(bw, chr_tree_offset + BW_CHR_TREE_HEADER_LEN, get_u32(t + 8)) != 0) goto err;
+
+  if (bw->uncompress_len) bw->ubuf = (unsigned char *)my_malloc(bw->uncompress_len);
+  return bw;
+
+err:
+  ga_bw_close(bw);
+  return NULL;
+}
+
+/*
+ * This closes bigWig file.
+ * *bw: pointer to struct bigwig
+ */
+void ga_bw_close (struct bigwig *bw)
+{
+  uint32_t i;
+
+  if (bw == NULL) return;
+  if (bw->chr) {
+    for (i = 0; i < bw->chr_nb; i++) MYFREE(bw->chr[i].chr);
+  }
+  MYFREE(bw->chr);
+  MYFREE(bw->zoom);
+  MYFREE(bw->cbuf);
+  MYFREE(bw->ubuf);
+  close(bw->fd);
+  MYFREE(bw);
+  return;
+}
+
+/*
+ * This chooses the zoom level for window size win: the coarsest level whose reduction level * BW_ZOOM_DIV <= win.
+ * Summaries of such level are much smaller than the window, so the window is answered with small error at its edges.
+ * This returns the index of bw->zoom, or -1 if base level should be used.
+ */
+int ga_bw_zoom (const struct bigwig *bw, const int win)
+{
+  int i, z = -1;
+
+  for (i = 0; i < bw->zoom_nb; i++) {
+    if ((uint64_t)bw->zoom[i].level * BW_ZOOM_DIV <= (uint64_t)win && (z < 0 || bw->zoom[i].level > bw->zoom[z].level)) z = i;
+  }
+  return z;
+}
+
+/*
+ * This finds data blocks which overlap chr_id:st-ed by R tree, and appends them to *blk.
+ * *bw    : pointer to struct bigwig
+ * zoom   : index of zoom level, or -1 for base level
+ * chr_id : chromosome ID in the file
+ * st, ed : region (0-based, end-exclusive)
+ * **blk  : array of struct bw_block, which is reallocated as needed
+ * *blk_nb: number of blocks in *blk
+ * *blk_len: allocated length of *blk
+ * This returns 0, or -1 if the index is broken.
+ */
+int ga_bw_blocks (struct bigwig *bw, const int zoom, const uint32_t chr_id, const uint32_t st, const uint32_t ed, struct bw_block **blk, int *blk_nb, int *blk_len)
+{
+  unsigned char h[BW_RTREE_HEADER_LEN];
+  uint64_t offset = zoom < 0 ? bw->index_offset : bw->zoom[zoom].index_offset;
+
+  if (read_at(bw, h, BW_RTREE_HEADER_LEN, offset) != 0) return -1;
+  if (get_u32(h) != BW_RTREE_MAGIC) {
+    LOG("error: R tree index of bigWig is broken.");
+    return -1;
+  }
+  return rtree_read(bw, offset + BW_RTREE_HEADER_LEN, chr_id, st, ed, blk, blk_nb, blk_len, 0);
+}
+
+/*
+ * This reads one data block and appends the records on chr_id to *rec in the order of the block.
+ * *bw    : pointer to struct bigwig
+ * zoom   : index of zoom level, or -1 for base level
+ * *blk   : data block given by ga_bw_blocks
+ * chr_id : chromosome ID in the file
+ * **rec  : array of struct bw_rec, which is reallocated as needed
+ * *rec_nb: number of records in *rec
+ * *rec_len: allocated length of *rec
+ * This returns 0, or -1 if the block is broken.
+ */
+int ga_bw_read_block (struct bigwig *bw, const int zoom, const struct bw_block *blk, const uint32_t chr_id, struct bw_rec **rec, long *rec_nb, long *rec_len)
+{
+  const unsigned char *p, *end;
+  uLongf len;
+  uint32_t st, step, span, i;
+  uint16_t nb;
+  unsigned char type;
+
+  if (blk->size > bw->cbuf_len) {
+    bw->cbuf = (unsigned char *)my_realloc(bw->cbuf, blk->size);
+    bw->cbuf_len = blk->size;
+  }
+  if (read_at(bw, bw->cbuf, blk->size, blk->offset) != 0) return -1;
+
+  if (bw->uncompress_len) {
+    len = bw->uncompress_len;
+    if (uncompress(bw->ubuf, &len, bw->cbuf, blk->size) != Z_OK) {
+      LOG("error: data block of bigWig cannot be inflated.");
+      return -1;
+    }
+    p = bw->ubuf;
+  } else {
+    len = blk->size;
+    p = bw->cbuf;
+  }
+  end = p + len;
+
+  if (zoom >= 0) { //zoom records: chr, st, ed, valid count, min, max, sum, sum of squares
+    for (; p + BW_ZOOM_REC_LEN <= end; p += BW_ZOOM_REC_LEN) {
+      if (get_u32(p) != chr_id || get_u32(p + 8) <= get_u32(p + 4)) continue;
+      rec_add(rec, rec_nb, rec_len, get_u32(p + 4), get_u32(p + 8), get_f(p + 24) / (get_u32(p + 8) - get_u32(p + 4)));
+    }
+    return 0;
+  }
+
+  if (p + BW_SECTION_HEADER_LEN > end) goto err;
+  if (get_u32(p) != chr_id) return 0; //one block has one section
+  st = get_u32(p + 4);
+  step = get_u32(p + 12);
+  span = get_u32(p + 16);
+  type = p[20];
+  nb = get_u16(p + 22);
+  p += BW_SECTION_HEADER_LEN;
+
+  if (type == BW_BEDGRAPH) {
+    if (p + (size_t)nb * 12 > end) goto err;
+    for (i = 0; i < nb; i++, p += 12) rec_add(rec, rec_nb, rec_len, get_u32(p), get_u32(p + 4), get_f(p + 8));
+  } else if (type == BW_VARSTEP) {
+    if (p + (size_t)nb * 8 > end) goto err;
+    for (i = 0; i < nb; i++, p += 8) rec_add(rec, rec_nb, rec_len, get_u32(p), get_u32(p) + span, get_f(p + 4));
+  } else if (type == BW_FIXEDSTEP) {
+    if (p + (size_t)nb * 4 > end) goto err;
+    for (i = 0; i < nb; i++, p += 4) rec_add(rec, rec_nb, rec_len, st + i * step, st + i * step + span, get_f(p));
+  } else {
+    goto err;
+  }
+  return 0;
+
+err:
+  LOG("error: data block of bigWig is broken.");
+  return -1;
+}
+
+/*
+ * These read little endian values.
+ */
+static uint16_t get_u16 (const unsigned char *p)
+{
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32 (const unsigned char *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64 (const unsigned char *p)
+{
+  return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static float get_f (const unsigned char *p)
+{
+  uint32_t u = get_u32(p);
+  float f;
+
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+/*
+ * This reads len bytes at offset. This returns 0, or -1 if the file is too short.
+ */
+static int read_at (struct bigwig *bw, void *buf, const size_t len, const uint64_t offset)
+{
+  size_t n = 0;
+  ssize_t r;
+
+  while (n < len) {
+    if ((r = pread(bw->fd, (char *)buf + n, len - n, offset + n)) <= 0) {
+      LOG("error: bigWig file is truncated.");
+      return -1;
+    }
+    n += r;
+  }
+  return 0;
+}
+
+/*
+ * This reads a node of chromosome B+ tree, and sets bw->chr[id] of each leaf item.
+ * offset : file offset of the node
+ * key_len: length of chromosome name in the tree (not null-terminated if the name is as long as key_len)
+ */
+static int chr_tree_read (struct bigwig *bw, const uint64_t offset, const uint32_t key_len)
+{
+  unsigned char h[4], *item = NULL;
+  uint16_t nb, i;
+  uint32_t id, item_len;
+  int leaf;
+
+  if (read_at(bw, h, 4, offset) != 0) return -1;
+  leaf = h[0];
+  nb = get_u16(h + 2);
+  item_len = key_len + 8; //key and (chr ID, chr size) or child offset
+  item = (unsigned char *)my_malloc((size_t)nb * item_len + 1);
+  if (read_at(bw, item, (size_t)nb * item_len, offset + 4) != 0) goto err;
+
+  for (i = 0; i < nb; i++) {
+    if (leaf) {
+      id = get_u32(item + i * item_len + key_len);
+      if (id >= bw->chr_nb) { //IDs are usually 0 ... chr_nb - 1
+        bw->chr = (struct bw_chr *)my_realloc(bw->chr, (id + 1) * sizeof(struct bw_chr));
+        memset(bw->chr + bw->chr_nb, 0, (id + 1 - bw->chr_nb) * sizeof(struct bw_chr));
+        bw->chr_nb = id + 1;
+      }
+      MYFREE(bw->chr[id].chr);
+      bw->chr[id].chr = (char *)my_calloc(key_len + 1, sizeof(char));
+      memcpy(bw->chr[id].chr, item + i * item_len, key_len);
+      bw->chr[id].size = get_u32(item + i * item_len + key_len + 4);
+    } else {
+      if (chr_tree_read(bw, get_u64(item + i * item_len + key_len), key_len) != 0) goto err;
+    }
+  }
+
+  MYFREE(item);
+  return 0;
+
+err:
+  MYFREE(item);
+  return -1;
+}
+
+/*
+ * This reads a node of R tree and appends leaf blocks which overlap chr_id:st-ed.
+ * Items are (start chr, start base, end chr, end base), and the region is compared as (chr, base) pair.
+ */
+static int rtree_read (struct bigwig *bw, const uint64_t offset, const uint32_t chr_id, const uint32_t st, const uint32_t ed, struct bw_block **blk, int *blk_nb, int *blk_len, const int depth)
+{
+  unsigned char h[4], *item = NULL, *p;
+  uint16_t nb, i;
+  int leaf, item_len;
+
+  if (depth > 64) {
+    LOG("error: R tree index of bigWig is broken.");
+    return -1;
+  }
+  if (read_at(bw, h, 4, offset) != 0) return -1;
+  leaf = h[0];
+  nb = get_u16(h + 2);
+  item_len = leaf ? 32 : 24; //leaf has data offset and size, and node has child offset
+  item = (unsigned char *)my_malloc((size_t)nb * item_len + 1);
+  if (read_at(bw, item, (size_t)nb * item_len, offset + 4) != 0) goto err;
+
+  for (i = 0; i < nb; i++) {
+    p = item + i * item_len;
+    if (get_u32(p) > chr_id || (get_u32(p) == chr_id && get_u32(p + 4) >= ed)) continue; //item starts after the region
+    if (get_u32(p + 8) < chr_id || (get_u32(p + 8) == chr_id && get_u32(p + 12) <= st)) continue; //item ends before the region
+
+    if (leaf) {
+      if (*blk_nb == *blk_len) {
+        *blk_len = *blk_len ? *blk_len * 2 : 64;
+        *blk = (struct bw_block *)my_realloc(*blk, *blk_len * sizeof(struct bw_block));
+      }
+      (*blk)[*blk_nb].offset = get_u64(p + 16);
+      (*blk)[*blk_nb].size = get_u64(p + 24);
+      (*blk_nb)++;
+    } else {
+      if (rtree_read(bw, get_u64(p + 16), chr_id, st, ed, blk, blk_nb, blk_len, depth + 1) != 0) goto err;
+    }
+  }
+
+  MYFREE(item);
+  return 0;
+
+err:
+  MYFREE(item);
+  return -1;
+}
+
+/*
+ * This appends one record to *rec.
+ */
+static void rec_add (struct bw_rec **rec, long *rec_nb, long *rec_len, const uint32_t st, const uint32_t ed, const float val)
+{
+  if (*rec_nb == *rec_len) {
+    *rec_len = *rec_len ? *rec_len * 2 : 1024;
+    *rec = (struct bw_rec *)my_realloc(*rec, *rec_len * sizeof(struct bw_rec));
+  }
+  (*rec)[*rec_nb].st = st;
+  (*rec)[*rec_nb].ed = ed;
+  (*rec)[*rec_nb].val = val;
+  (*rec_nb)++;
+  return;
+}
@@ -0,0 +1,77 @@
+#ifndef _READ_BIGWIG_H_
+#define _READ_BIGWIG_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BW_MAGIC 0x888FFC26 //magic number of bigWig
+#define BW_CHR_TREE_MAGIC 0x78CA8C91 //magic number of chromosome B+ tree
+#define BW_RTREE_MAGIC 0x2468ACE0 //magic number of R tree index
+#define BW_ZOOM_DIV 8 //zoom level is used if reduction level * BW_ZOOM_DIV <= win
+#define BW_BEDGRAPH 1 //section type of data block
+#define BW_VARSTEP 2
+#define BW_FIXEDSTEP 3
+
+/*
+ * Structure of bigWig zoom level.
+ */
+struct bw_zoom {
+  uint32_t level; //reduction level (bases per summary)
+  uint64_t data_offset;
+  uint64_t index_offset; //R tree index of the zoom level
+};
+
+/*
+ * Structure of bigWig chromosome.
+ * chr[id] in struct bigwig, where id is the chromosome ID in the file (not in chr dictionary).
+ */
+struct bw_chr {
+  char *chr;
+  uint32_t size;
+};
+
+/*
+ * Structure of bigWig data block.
+ * Compressed block of records, found by R tree.
+ */
+struct bw_block {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/*
+ * Structure of bigWig record.
+ * Position is 0-based and end-exclusive like bedgraph.
+ * For zoom level, val is the mean over st-ed, so that val * (ed - st) is the sum of the summary.
+ */
+struct bw_rec {
+  uint32_t st;
+  uint32_t ed;
+  float val;
+};
+
+/*
+ * Structure of bigWig file.
+ * Only the header, zoom headers and chromosome list are read at open. Data blocks are read on demand.
+ */
+struct bigwig {
+  int fd;
+  uint16_t zoom_nb;
+  uint64_t index_offset; //R tree index of base level
+  uint32_t uncompress_len; //0 if data is not compressed
+  struct bw_zoom *zoom;
+  struct bw_chr *chr;
+  uint32_t chr_nb;
+  unsigned char *cbuf; //buffer for compressed block
+  uint64_t cbuf_len;
+  unsigned char *ubuf; //buffer for uncompressed block
+};
+
+struct bigwig *ga_bw_open (const char *filename);
+void ga_bw_close (struct bigwig *bw);
+int ga_bw_zoom (const struct bigwig *bw, const int win);
+int ga_bw_blocks (struct bigwig *bw, const int zoom, const uint32_t chr_id, const uint32_t st, const uint32_t ed, struct bw_block **blk, int *blk_nb, int *blk_len);
+int ga_bw_read_block (struct bigwig *bw, const int zoom, const struct bw_block *blk, const uint32_t chr_id, struct bw_rec **rec, long *rec_nb, long *rec_len);
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * This program is one of the genome analysis tools.
+ * This program reads lines from gzip files.
+ * Inflation is separated from parsing, so one thread inflates while the other parses,
+ * and BGZF (blocked gzip) blocks are inflated on several threads in parallel.
+ * Decompressed data is queued by whole lines, so the lines can also be parsed on several threads.
+ */
+
+#include "read_gz.h"
+#include "ga_my.h"
+
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define LOG(m) \
+  fprintf(stderr, \
+  "%s:line%d:%s(): " m "\n", \
+  __FILE__, __LINE__, __FUNCTION__)
+
+/*
+ * Structure of BGZF block.
+ */
+struct bgzf_block {
+  unsigned char *cdata; //compressed data (raw deflate)
+  unsigned int clen; //length of cdata
+  unsigned int isize; //length of decompressed data
+  unsigned long crc; //crc32 of decompressed data
+  char *buf; //decompressed data, which points into the chunk of the batch
+  int err;
+};
+
+/*
+ * Structure of BGZF inflate job.
+ * Thread w inflates block w, w + thread_nb, w + 2 * thread_nb, ...
+ */
+struct bgzf_job {
+  struct bgzf_block *blk;
+  int blk_nb;
+  int w;
+  int thread_nb;
+};
+
+static int is_bgzf (FILE *fp);
+static int bgzf_read_block (FILE *fp, struct bgzf_block *blk);
+static void *bgzf_inflate (void *arg);
+static void *bgzf_producer (void *arg);
+static void *gz_producer (void *arg);
+static char *chunk_new (struct gz_reader *r, const size_t len);
+static int chunk_put_lines (struct gz_reader *r, char *buf, const size_t len);
+static int chunk_put_carry (struct gz_reader *r);
+static int chunk_put (struct gz_reader *r, char *buf, const size_t len);
+static int chunk_get (struct gz_reader *r, struct gz_chunk *c, long *seq);
+static double now (void);
+
+/*pointer which must be freed: return value (ga_gz_close)*/
+/*
+ * This opens gzip file for ga_gz_gets.
+ * *filename: file name. Plain text file is also read as it is (as gzopen does).
+ * thread_nb: number of inflate threads. If 0, no thread is used and lines are read by gzgets.
+ * This returns NULL if the file cannot be opened.
+ */
+struct gz_reader *ga_gz_open (const char *filename, const int thread_nb)
+{
+  struct gz_reader *r;
+  struct stat sb;
+  FILE *fp;
+
+  r = (struct gz_reader *)my_calloc(1, sizeof(struct gz_reader));
+  r -> thread_nb = thread_nb > 0 ? thread_nb : 0;
+
+  if (r -> thread_nb) {
+    if ((fp = fopen(filename, "rb")) == NULL) goto err;
+    if (fstat(fileno(fp), &sb) == 0 && S_ISREG(sb.st_mode) && is_bgzf(fp)) { //the head of pipe cannot be read twice
+      r -> bgzf = 1;
+      r -> fp = fp;
+    } else {
+      fclose(fp);
+    }
+  }
+  if (!r -> bgzf && (r -> gfp = gzopen(filename, "r")) == NULL) goto err;
+
+  if (r -> thread_nb) {
+    pthread_mutex_init(&r -> mutex, NULL);
+    pthread_cond_init(&r -> cond_put, NULL);
+    pthread_cond_init(&r -> cond_get, NULL);
+    if (pthread_create(&r -> th, NULL, r -> bgzf ? bgzf_producer : gz_producer, r) != 0) {
+      LOG("error: thread cannot be created.");
+      exit(EXIT_FAILURE);
+    }
+    r -> th_init = 1;
+  }
+
+  return r;
+
+err:
+  MYFREE(r);
+  return NULL;
+}
+
+/*
+ * This reads one line like gzgets.
+ * *r  : pointer to struct gz_reader
+ * line: buffer which receives the line including '\n'
+ * len : length of line. At most len - 1 chars are read.
+ * This returns line, or NULL if no char is read (end of file or error).
+ */
+char *ga_gz_gets (struct gz_reader *r, char *line, const int len)
+{
+  size_t n = 0, k;
+  char *nl = NULL;
+
+  if (!r -> thread_nb) return gzgets(r -> gfp, line, len);
+
+  while (n < (size_t)len - 1) {
+    if (r -> pos == r -> cur.len) { //taking next chunk
+      MYFREE(r -> cur.buf);
+      r -> cur.len = 0;
+      r -> pos = 0;
+      if (chunk_get(r, &r -> cur, NULL) != 0) break; //end of file
+    }
+
+    k = r -> cur.len - r -> pos;
+    if (k > (size_t)len - 1 - n) k = (size_t)len - 1 - n;
+    if ((nl = memchr(r -> cur.buf + r -> pos, '\n', k)) != NULL) k = nl - (r -> cur.buf + r -> pos) + 1;
+    memcpy(line + n, r -> cur.buf + r -> pos, k);
+    n += k;
+    r -> pos += k;
+    if (nl) break;
+  }
+
+  if (n == 0) return NULL;
+  line[n] = '\0';
+  return line;
+}
+
+/*pointer which must be freed: c->buf*/
+/*
+ * This takes the next chunk of whole lines (the last line of file may not have '\n').
+ * This can be called by several parsing threads at once, and seq gives the order of the chunk in the file.
+ * Lines which are left by ga_gz_gets are returned first, so ga_gz_gets can be used for header before parsing threads start.
+ * *r  : pointer to struct gz_reader opened with thread_nb >= 1
+ * *c  : chunk which receives the data
+ * *seq: sequence number of the chunk, 0, 1, 2, ...
+ * This returns 0, or -1 at the end of file.
+ */
+int ga_gz_chunk (struct gz_reader *r, struct gz_chunk *c, long *seq)
+{
+  if (!r -> thread_nb) return -1;
+
+  pthread_mutex_lock(&r -> mutex);
+  if (r -> pos < r -> cur.len) { //rest of the chunk read by ga_gz_gets
+    memmove(r -> cur.buf, r -> cur.buf + r -> pos, r -> cur.len - r -> pos);
+    c -> buf = r -> cur.buf;
+    c -> len = r -> cur.len - r -> pos;
+    *seq = r -> seq++;
+    r -> cur.buf = NULL;
+    r -> cur.len = 0;
+    r -> pos = 0;
+    pthread_mutex_unlock(&r -> mutex);
+    return 0;
+  }
+  pthread_mutex_unlock(&r -> mutex);
+
+  return chunk_get (r, c, seq);
+}
+
+/*
+ * This closes gz reader. The inflate thread is stopped even if the file is not read to the end.
+ * *r: pointer to struct gz_reader
+ * This returns 0, or -1 if the file had decompression error.
+ */
+int ga_gz_close (struct gz_reader *r)
+{
+  int ret = 0;
+
+  if (r -> th_init) {
+    pthread_mutex_lock(&r -> mutex);
+    r -> stop = 1;
+    pthread_cond_broadcast(&r -> cond_get);
+    pthread_mutex_unlock(&r -> mutex);
+    pthread_join(r -> th, NULL);
+
+    while (r -> q_nb) { //chunks which are not parsed
+      MYFREE(r -> queue[r -> q_head].buf);
+      r -> q_head = (r -> q_head + 1) % GZ_QUEUE_LEN;
+      r -> q_nb--;
+    }
+    pthread_mutex_destroy(&r -> mutex);
+    pthread_cond_destroy(&r -> cond_put);
+    pthread_cond_destroy(&r -> cond_get);
+  }
+
+  if (r -> err) ret = -1;
+  MYFREE(r -> cur.buf);
+  MYFREE(r -> carry);
+  if (r -> gfp) gzclose(r -> gfp);
+  if (r -> fp) fclose(r -> fp);
+  MYFREE(r);
+  return ret;
+}
+
+/*
+ * This checks the head of file is BGZF block, that is, gzip header with "BC" extra subfield.
+ * The file position is returned to the head.
+ */
+static int is_bgzf (FILE *fp)
+{
+  unsigned char h[18];
+  size_t n;
+
+  n = fread(h, 1, sizeof(h), fp);
+  rewind(fp);
+  if (n < sizeof(h)) return 0;
+  return (h[0] == 0x1f && h[1] == 0x8b && h[2] == 8 && (h[3] & 4) && (h[10] | h[11] << 8) >= 6 &&\
+          h[12] == 'B' && h[13] == 'C' && (h[14] | h[15] << 8) == 2);
+}
+
+/*
+ * This reads one BGZF block. blk->cdata must have BGZF_BLOCK_LEN bytes.
+ * This returns 1 if a block is read, 0 at the end of file, and -1 if the block is broken.
+ */
+static int bgzf_read_block (FILE *fp, struct bgzf_block *blk)
+{
+  unsigned char h[12], x[BGZF_BLOCK_LEN], t[8];
+  unsigned int xlen, bsize = 0, i, slen;
+  size_t n;
+
+  if ((n = fread(h, 1, sizeof(h), fp)) == 0) return 0;
+  if (n < sizeof(h) || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4)) return -1;
+
+  xlen = h[10] | h[11] << 8;
+  if (fread(x, 1, xlen, fp) != xlen) return -1;
+  for (i = 0; i + 4 <= xlen; i += 4 + slen) { //finding BC subfield
+    slen = x[i + 2] | x[i + 3] << 8;
+    if (x[i] == 'B' && x[i + 1] == 'C' && slen == 2 && i + 6 <= xlen) bsize = (x[i + 4] | x[i + 5] << 8) + 1;
+  }
+  if (bsize < 12 + xlen + 8 || bsize > BGZF_BLOCK_LEN) return -1;
+
+  blk -> clen = bsize - 12 - xlen - 8;
+  if (fread(blk -> cdata, 1, blk -> clen, fp) != blk -> clen || fread(t, 1, 8, fp) != 8) return -1;
+  blk -> crc = (unsigned long)t[0] | (unsigned long)t[1] << 8 | (unsigned long)t[2] << 16 | (unsigned long)t[3] << 24;
+  blk -> isize = t[4] | t[5] << 8 | t[6] << 16 | (unsigned int)t[7] << 24;
+  if (blk -> isize > BGZF_BLOCK_LEN) return -1;
+
+  return 1;
+}
+
+/*
+ * This is the thread function which inflates BGZF blocks of a batch.
+ * *arg: pointer to struct bgzf_job
+ */
+static void *bgzf_inflate (void *arg)
+{
+  struct bgzf_job *job = (struct bgzf_job *)arg;
+  struct bgzf_block *blk;
+  z_stream zs;
+  int i;
+
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, -15) != Z_OK) { //raw deflate
+    for (i = job -> w; i < job -> blk_nb; i += job -> thread_nb) job -> blk[i].err = 1;
+    return NULL;
+  }
+
+  for (i = job -> w; i < job -> blk_nb; i += job -> thread_nb) {
+    blk = &job -> blk[i];
+    inflateReset(&zs);
+    zs.next_in = blk -> cdata;
+    zs.avail_in = blk -> clen;
+    zs.next_out = (unsigned char *)blk -> buf;
+    zs.avail_out = blk -> isize;
+    if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.total_out != blk -> isize ||\
+        crc32(crc32(0L, Z_NULL, 0), (unsigned char *)blk -> buf, blk -> isize) != blk -> crc) {
+      blk -> err = 1;
+    }
+  }
+
+  inflateEnd(&zs);
+  return NULL;
+}
+
+/*
+ * This is the inflate thread for BGZF.
+ * thread_nb * BGZF_BATCH blocks are read at once and inflated in parallel into one chunk, which is put in the queue in the file order.
+ * *arg: pointer to struct gz_reader
+ */
+static void *bgzf_producer (void *arg)
+{
+  struct gz_reader *r = (struct gz_reader *)arg;
+  struct bgzf_block *blk;
+  struct bgzf_job *job;
+  pthread_t *th;
+  char *buf;
+  size_t len;
+  int batch = r -> thread_nb * BGZF_BATCH, n, i, ret = 1, err = 0;
+
+  blk = (struct bgzf_block *)my_calloc(batch, sizeof(struct bgzf_block));
+  job = (struct bgzf_job *)my_calloc(r -> thread_nb, sizeof(struct bgzf_job));
+  th = (pthread_t *)my_calloc(r -> thread_nb, sizeof(pthread_t));
+  for (i = 0; i < batch; i++) blk[i].cdata = (unsigned char *)my_malloc(BGZF_BLOCK_LEN);
+
+  while (ret == 1 && !err) {
+    for (n = 0; n < batch; n++) {
+      blk[n].err = 0;
+      if ((ret = bgzf_read_block(r -> fp, &blk[n])) != 1) break;
+    }
+    if (ret < 0) {
+      LOG("error: BGZF block is broken.");
+      err = 1;
+    }
+
+    for (i = 0, len = 0; i < n; i++) len += blk[i].isize;
+    buf = chunk_new (r, len);
+    for (i = 0, len = r -> carry_len; i < n; i++) { //blocks are inflated after the carry
+      blk[i].buf = buf + len;
+      len += blk[i].isize;
+    }
+
+    for (i = 0; i < r -> thread_nb; i++) { //inflating n blocks. This thread works as the thread 0.
+      job[i].blk = blk;
+      job[i].blk_nb = n;
+      job[i].w = i;
+      job[i].thread_nb = r -> thread_nb;
+      if (i && pthread_create(&th[i], NULL, bgzf_inflate, &job[i]) != 0) {
+        LOG("error: thread cannot be created.");
+        exit(EXIT_FAILURE);
+      }
+    }
+    bgzf_inflate (&job[0]);
+    for (i = 1; i < r -> thread_nb; i++) pthread_join(th[i], NULL);
+
+    for (i = 0; i < n; i++) {
+      if (blk[i].err) {
+        if (!err) LOG("error: BGZF block cannot be inflated.");
+        err = 1;
+      }
+    }
+    if (err) {
+      MYFREE(buf);
+      break;
+    }
+    if (chunk_put_lines(r, buf, len) != 0) ret = 0; //parsing thread stopped
+  }
+  if (!err && ret == 0) chunk_put_carry (r); //the last line without '\n'
+
+  pthread_mutex_lock(&r -> mutex);
+  r -> eof = 1;
+  if (err) r -> err = 1;
+  pthread_cond_broadcast(&r -> cond_put);
+  pthread_mutex_unlock(&r -> mutex);
+
+  for (i = 0; i < batch; i++) MYFREE(blk[i].cdata);
+  MYFREE(blk);
+  MYFREE(job);
+  MYFREE(th);
+  return NULL;
+}
+
+/*
+ * This is the inflate thread for ordinary gzip. Decompressed data is put in the queue by GZ_CHUNK_LEN.
+ * *arg: pointer to struct gz_reader
+ */
+static void *gz_producer (void *arg)
+{
+  struct gz_reader *r = (struct gz_reader *)arg;
+  char *buf;
+  int n, err = 0;
+
+  while (1) {
+    buf = chunk_new (r, GZ_CHUNK_LEN);
+    if ((n = gzread(r -> gfp, buf + r -> carry_len, GZ_CHUNK_LEN)) <= 0) {
+      if (n < 0) {
+        LOG("error: gzip file cannot be inflated.");
+        err = 1;
+      }
+      MYFREE(buf);
+      if (!err) chunk_put_carry (r); //the last line without '\n'
+      break;
+    }
+    if (chunk_put_lines(r, buf, r -> carry_len + n) != 0) break; //parsing thread stopped
+  }
+
+  pthread_mutex_lock(&r -> mutex);
+  r -> eof = 1;
+  if (err) r -> err = 1;
+  pthread_cond_broadcast(&r -> cond_put);
+  pthread_mutex_unlock(&r -> mutex);
+  return NULL;
+}
+
+/*pointer which must be freed: return value*/
+/*
+ * This allocates a chunk for len bytes of new data. The carry is copied at the head, so new data is written after r->carry_len bytes.
+ */
+static char *chunk_new (struct gz_reader *r, const size_t len)
+{
+  char *buf;
+
+  buf = (char *)my_malloc(r -> carry_len + len + 1);
+  if (r -> carry_len) memcpy(buf, r -> carry, r -> carry_len); //the carry is NULL before the first partial line
+  return buf;
+}
+
+/*
+ * This puts the data in the queue up to the last '\n', and the rest is kept as the carry for the next chunk.
+ * The buf is owned by the queue (or freed) after this.
+ * This returns 0, or -1 if the parsing thread stopped.
+ */
+static int chunk_put_lines (struct gz_reader *r, char *buf, const size_t len)
+{
+  size_t n;
+
+  for (n = len; n > 0 && buf[n - 1] != '\n'; n--); //the end of the last line
+  if (len - n > r -> carry_size) {
+    r -> carry_size = 2 * (len - n);
+    r -> carry = (char *)my_realloc(r -> carry, r -> carry_size);
+  }
+  if (len - n) memcpy(r -> carry, buf + n, len - n); //the carry is NULL until a chunk ends in the middle of a line
+  r -> carry_len = len - n;
+
+  if (n == 0) { //no '\n' in the data, so the line continues to the next chunk
+    MYFREE(buf);
+    return 0;
+  }
+  return chunk_put (r, buf, n);
+}
+
+/*
+ * This puts the carry in the queue at the end of file.
+ * This returns 0, or -1 if the parsing thread stopped.
+ */
+static int chunk_put_carry (struct gz_reader *r)
+{
+  char *buf;
+  size_t len = r -> carry_len;
+
+  if (len == 0) return 0;
+  buf = chunk_new (r, 0);
+  r -> carry_len = 0;
+  return chunk_put (r, buf, len);
+}
+
+/*
+ * This puts a chunk in the queue. It waits while the queue is full.
+ * The buf is owned by the queue after this, or freed if the parsing thread stopped.
+ * This returns 0, or -1 if the parsing thread stopped.
+ */
+static int chunk_put (struct gz_reader *r, char *buf, const size_t len)
+{
+  double t;
+
+  pthread_mutex_lock(&r -> mutex);
+  if (r -> q_nb == GZ_QUEUE_LEN && !r -> stop) { //parsing is slower
+    t = now();
+    while (r -> q_nb == GZ_QUEUE_LEN && !r -> stop) pthread_cond_wait(&r -> cond_get, &r -> mutex);
+    r -> wait_put += now() - t;
+  }
+  if (r -> stop) {
+    pthread_mutex_unlock(&r -> mutex);
+    MYFREE(buf);
+    return -1;
+  }
+
+  r -> queue[(r -> q_head + r -> q_nb) % GZ_QUEUE_LEN].buf = buf;
+  r -> queue[(r -> q_head + r -> q_nb) % GZ_QUEUE_LEN].len = len;
+  r -> q_nb++;
+  pthread_cond_signal(&r -> cond_put);
+  pthread_mutex_unlock(&r -> mutex);
+  return 0;
+}
+
+/*
+ * This takes a chunk from the queue. It waits while the queue is empty.
+ * *seq: receives the sequence number of the chunk, or NULL
+ * This returns 0, or -1 if all chunks are taken.
+ */
+static int chunk_get (struct gz_reader *r, struct gz_chunk *c, long *seq)
+{
+  double t;
+
+  pthread_mutex_lock(&r -> mutex);
+  if (r -> q_nb == 0 && !r -> eof) { //inflation is slower
+    t = now();
+    while (r -> q_nb == 0 && !r -> eof) pthread_cond_wait(&r -> cond_put, &r -> mutex);
+    r -> wait_get += now() - t;
+  }
+  if (r -> q_nb == 0) {
+    pthread_mutex_unlock(&r -> mutex);
+    return -1;
+  }
+
+  *c = r -> queue[r -> q_head];
+  if (seq) *seq = r -> seq++;
+  r -> q_head = (r -> q_head + 1) % GZ_QUEUE_LEN;
+  r -> q_nb--;
+  pthread_cond_signal(&r -> cond_get);
+  pthread_mutex_unlock(&r -> mutex);
+  return 0;
+}
+
+/*
+ * This returns monotonic time in seconds.
+ */
+static double now (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
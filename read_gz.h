@@ -0,0 +1,65 @@
+#ifndef _READ_GZ_H_
+#define _READ_GZ_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include <pthread.h>
+
+#define GZ_CHUNK_LEN 1048576 //decompressed bytes per chunk of ordinary gzip
+#define GZ_QUEUE_LEN 64 //number of decompressed chunks waiting for parsing
+#define BGZF_BLOCK_LEN 65536 //max length of BGZF block (both compressed and decompressed)
+#define BGZF_BATCH 8 //number of BGZF blocks inflated by one thread at once
+
+/*
+ * Structure of chunk.
+ * Decompressed data handed from inflate thread to parsing thread.
+ */
+struct gz_chunk {
+  char *buf;
+  size_t len;
+};
+
+/*
+ * Structure of gz reader.
+ * If thread_nb is 0, lines are read by gzgets as it is.
+ * Otherwise, inflation runs on its own thread(s) and decompressed chunks are queued:
+ * BGZF (blocked gzip) blocks are inflated by thread_nb threads in parallel, and ordinary gzip is inflated by one thread.
+ * Each chunk ends at the end of a line, so chunks can be parsed by several threads (see ga_gz_chunk).
+ * wait_put and wait_get show which side is slower: the inflate thread waits for a free slot if parsing is slower, and vice versa.
+ */
+struct gz_reader {
+  struct gzFile_s *gfp; //ordinary gzip (or plain text)
+  FILE *fp; //BGZF
+  int bgzf; //1 if BGZF
+  int thread_nb; //number of inflate threads
+  pthread_t th; //inflate thread
+  int th_init;
+
+  struct gz_chunk queue[GZ_QUEUE_LEN]; //ring buffer of chunks
+  int q_head; //position of the first chunk
+  int q_nb; //number of chunks in the queue
+  int eof; //1 if inflate thread finished
+  int err; //1 if decompression error
+  int stop; //1 if parsing thread stops reading
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_put; //signaled when a chunk is put
+  pthread_cond_t cond_get; //signaled when a chunk is taken
+
+  char *carry; //partial line at the end of the last data, which is put in front of the next chunk
+  size_t carry_len;
+  size_t carry_size; //allocated size of carry
+  long seq; //sequence number of the next chunk taken by ga_gz_chunk
+  double wait_put; //seconds the inflate thread waited for a free slot
+  double wait_get; //seconds the parsing thread(s) waited for a chunk
+
+  struct gz_chunk cur; //chunk being parsed
+  size_t pos; //position in cur
+};
+
+struct gz_reader *ga_gz_open (const char *filename, const int thread_nb);
+char *ga_gz_gets (struct gz_reader *r, char *line, const int len);
+int ga_gz_chunk (struct gz_reader *r, struct gz_chunk *c, long *seq);
+int ga_gz_close (struct gz_reader *r);
+
+#endif
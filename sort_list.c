@@ -1,79 +1,94 @@
 #include "sort_list.h"
+#include "ga_my.h"
 
-static struct chr_block *merge_chr(struct chr_block *a, struct chr_block *b);
-static struct bs *merge_bs(struct bs *a, struct bs *b);
-static struct ref *merge_ref(struct ref *a, struct ref *b);
-static struct sig *merge_sig(struct sig *a, struct sig *b);
-
-struct chr_block *ga_mergesort_chr(struct chr_block *p)
-{
-  struct chr_block *a, *b;
+/*
+ * Structure of sort key of radix sort.
+ */
+struct sort_key {
+  unsigned long st;
+  unsigned long i; //index of the record before sorting
+};
 
-  if (p == NULL) return p;
-  if (p->next == NULL) return p;
 
-  a = p;
-  b = p->next->next;
-
-  while (b != NULL) {
-    a = a->next;
-    b = b->next;
-    if (b != NULL) b = b->next;
+static struct chr_block *merge_chr(struct chr_block *a, struct chr_block *b);
+static struct chr_block *sort_chr(struct chr_block *p);
+static struct bs *reverse_bs(struct bs *p);
+static struct ref *reverse_ref(struct ref *p);
+static struct bs *sort_bs(struct bs *p);
+static struct ref *sort_ref(struct ref *p);
+static void sort_sig(struct chr_block *ch);
+static void radix_sort_key(struct sort_key *key, const unsigned long nb);
+
+/*
+ * This sorts chr blocks by chr name and bs of each chr block by start position.
+ * The bs list which is already in order (bs_order given by the parser) is not sorted.
+ * The list which is strictly descending is reversed, which is the same as the stable sort because no position is equal.
+ * *p: pointer to the head of chr block
+ * This returns the new head of chr block.
+ */
+struct chr_block *ga_sort_chr_block_bs(struct chr_block *p)
+{
+  struct chr_block *ch;
+
+  p = sort_chr(p);
+  for (ch = p; ch; ch = ch->next) {
+    if (!ch->bs_init) continue;
+    if (ch->bs_order & LIST_ASC) continue;
+    if (ch->bs_order & LIST_DESC) ch->bs_list = reverse_bs(ch->bs_list);
+    else ch->bs_list = sort_bs(ch->bs_list);
+    ch->bs_order = LIST_ASC;
   }
 
-  b = a->next;
-  a->next = NULL;
-
-  return merge_chr(ga_mergesort_chr(p),ga_mergesort_chr(b));
+  return p;
 }
 
-struct bs *ga_mergesort_bs(struct bs *p)
+/*
+ * This sorts chr blocks by chr name and sig arrays of each chr block by start position.
+ * The arrays which are already in order (sig_order given by the parser) are not sorted.
+ * sig which start at the same position keep the order in which they were added.
+ * *p: pointer to the head of chr block
+ * This returns the new head of chr block.
+ */
+struct chr_block *ga_sort_chr_block_sig(struct chr_block *p)
 {
-  struct bs *a, *b;
-
-  if (p == NULL) return p;
-  if (p->next == NULL) return p;
-
-  a = p;
-  b = p->next->next;
-
-  while (b != NULL) {
-    a = a->next;
-    b = b->next;
-    if (b != NULL) b = b->next;
+  struct chr_block *ch;
+
+  p = sort_chr(p);
+  for (ch = p; ch; ch = ch->next) {
+    if (!ch->sig_init) continue;
+    if (ch->sig_order & LIST_ASC) continue;
+    sort_sig(ch);
+    ch->sig_order = LIST_ASC;
   }
 
-  b = a->next;
-  a->next = NULL;
-
-  return merge_bs(ga_mergesort_bs(p),ga_mergesort_bs(b));
+  return p;
 }
 
-struct ref *ga_mergesort_ref(struct ref *p)
+/*
+ * This sorts chr blocks by chr name and ref of each chr block by start position.
+ * The ref list is sorted in the same way as ga_sort_chr_block_bs.
+ * *p: pointer to the head of chr block
+ * This returns the new head of chr block.
+ */
+struct chr_block *ga_sort_chr_block_ref(struct chr_block *p)
 {
-  struct ref *a, *b;
-
-  if (p == NULL) return p;
-  if (p->next == NULL) return p;
-
-  a = p;
-  b = p->next->next;
-
-  while (b != NULL) {
-    a = a->next;
-    b = b->next;
-    if (b != NULL) b = b->next;
+  struct chr_block *ch;
+
+  p = sort_chr(p);
+  for (ch = p; ch; ch = ch->next) {
+    if (!ch->ref_init) continue;
+    if (ch->ref_order & LIST_ASC) continue;
+    if (ch->ref_order & LIST_DESC) ch->ref_list = reverse_ref(ch->ref_list);
+    else ch->ref_list = sort_ref(ch->ref_list);
+    ch->ref_order = LIST_ASC;
   }
 
-  b = a->next;
-  a->next = NULL;
-
-  return merge_ref(ga_mergesort_ref(p),ga_mergesort_ref(b));
+  return p;
 }
 
-struct sig *ga_mergesort_sig(struct sig *p)
+struct chr_block *ga_mergesort_chr(struct chr_block *p)
 {
-  struct sig *a, *b;
+  struct chr_block *a, *b;
 
   if (p == NULL) return p;
   if (p->next == NULL) return p;
@@ -90,7 +105,7 @@ struct sig *ga_mergesort_sig(struct sig *p)
   b = a->next;
   a->next = NULL;
 
-  return merge_sig(ga_mergesort_sig(p),ga_mergesort_sig(b));
+  return merge_chr(ga_mergesort_chr(p),ga_mergesort_chr(b));
 }
 
 static struct chr_block *merge_chr(struct chr_block *a, struct chr_block *b)
@@ -121,96 +136,227 @@ static struct chr_block *merge_chr(struct chr_block *a, struct chr_block *b)
 }
 
 
-static struct bs *merge_bs(struct bs *a, struct bs *b)
+/*
+ * This sorts chr blocks by chr name.
+ * chr names are unique, so the list which is already ascending is kept and the descending one is reversed.
+ * *p: pointer to the head of chr block
+ * This returns the new head of chr block.
+ */
+static struct chr_block *sort_chr(struct chr_block *p)
 {
-  struct bs *x, head;
-
-  x = &head;
+  struct chr_block *x, *next, *head = NULL;
+  int asc = 1, desc = 1;
 
-  while (a && b) {
-      if (a->st <= b->st) {
-          x->next = a;
-          a = a->next;
-          x = x->next;
-      }
-      else {
-          x->next = b;
-          b = b->next;
-          x = x->next;
-      }
+  for (x = p; x && x->next; x = x->next) {
+    if (strcmp(x->chr, x->next->chr) < 0) desc = 0;
+    else asc = 0;
   }
 
-  if (a == NULL) {
-    x->next = b;
-    b->prev = x; //test code...
-  } else {
-    x->next = a;
-    a->prev = x; //test code...
+  if (asc) return p;
+  if (!desc) return ga_mergesort_chr(p);
+
+  for (x = p; x; x = next) {
+    next = x->next;
+    x->next = head;
+    head = x;
   }
 
-  head.next->prev = NULL; //test code...
-  return head.next;
+  return head;
 }
 
-static struct ref *merge_ref(struct ref *a, struct ref *b)
+/*
+ * This reverses bs list. next and prev of each bs are swapped.
+ * *p: pointer to the head of bs list
+ * This returns the new head of bs list.
+ */
+static struct bs *reverse_bs(struct bs *p)
 {
-  struct ref *x, head;
-
-  x = &head;
+  struct bs *x, *next, *head = NULL;
 
-  while (a && b) {
-      if (a->st <= b->st) {
-          x->next = a;
-          a = a->next;
-          x = x->next;
-      }
-      else {
-          x->next = b;
-          b = b->next;
-          x = x->next;
-      }
+  for (x = p; x; x = next) {
+    next = x->next;
+    x->next = head;
+    x->prev = next;
+    head = x;
   }
 
-  if (a == NULL) {
-    x->next = b;
-    b->prev = x; //test code...
-  } else {
-    x->next = a;
-    a->prev = x; //test code...
+  return head;
+}
+
+/*
+ * This reverses ref list. next and prev of each ref are swapped.
+ * *p: pointer to the head of ref list
+ * This returns the new head of ref list.
+ */
+static struct ref *reverse_ref(struct ref *p)
+{
+  struct ref *x, *next, *head = NULL;
+
+  for (x = p; x; x = next) {
+    next = x->next;
+    x->next = head;
+    x->prev = next;
+    head = x;
   }
 
-  head.next->prev = NULL; //test code...
-  return head.next;
+  return head;
 }
 
-static struct sig *merge_sig(struct sig *a, struct sig *b)
+/*
+ * This sorts bs list by start position with radix sort. bs which start at the same position keep the order in the list.
+ * next and prev of each bs are linked again in the sorted order.
+ * *p: pointer to the head of bs list
+ * This returns the new head of bs list.
+ */
+static struct bs *sort_bs(struct bs *p)
 {
-  struct sig *x, head;
+  struct sort_key *key;
+  struct bs **node, *x;
+  unsigned long i, n;
+
+  if (p == NULL || p->next == NULL) return p;
+  for (n = 0, x = p; x; x = x->next) n++;
+
+  key = (struct sort_key *)my_malloc(n * sizeof(struct sort_key));
+  node = (struct bs **)my_malloc(n * sizeof(struct bs *));
+  for (i = 0, x = p; x; x = x->next, i++) {
+    key[i].st = x->st;
+    key[i].i = i;
+    node[i] = x;
+  }
+  radix_sort_key(key, n);
 
-  x = &head;
+  for (i = 0; i < n; i++) {
+    x = node[key[i].i];
+    x->prev = i ? node[key[i - 1].i] : NULL;
+    x->next = i + 1 < n ? node[key[i + 1].i] : NULL;
+  }
+  p = node[key[0].i];
+  MYFREE(key);
+  MYFREE(node);
+  return p;
+}
 
-  while (a && b) {
-      if (a->st <= b->st) {
-          x->next = a;
-          a = a->next;
-          x = x->next;
-      }
-      else {
-          x->next = b;
-          b = b->next;
-          x = x->next;
-      }
+/*
+ * This sorts ref list by start position with radix sort in the same way as sort_bs.
+ * *p: pointer to the head of ref list
+ * This returns the new head of ref list.
+ */
+static struct ref *sort_ref(struct ref *p)
+{
+  struct sort_key *key;
+  struct ref **node, *x;
+  unsigned long i, n;
+
+  if (p == NULL || p->next == NULL) return p;
+  for (n = 0, x = p; x; x = x->next) n++;
+
+  key = (struct sort_key *)my_malloc(n * sizeof(struct sort_key));
+  node = (struct ref **)my_malloc(n * sizeof(struct ref *));
+  for (i = 0, x = p; x; x = x->next, i++) {
+    key[i].st = x->st;
+    key[i].i = i;
+    node[i] = x;
   }
+  radix_sort_key(key, n);
 
-  if (a == NULL) {
-    x->next = b;
-    b->prev = x; //test code...
-  } else {
-    x->next = a;
-    a->prev = x; //test code...
+  for (i = 0; i < n; i++) {
+    x = node[key[i].i];
+    x->prev = i ? node[key[i - 1].i] : NULL;
+    x->next = i + 1 < n ? node[key[i + 1].i] : NULL;
   }
+  p = node[key[0].i];
+  p->tail = node[key[n - 1].i]; //the head keeps the tail like ref_append
+  MYFREE(key);
+  MYFREE(node);
+  return p;
+}
 
-  head.next->prev = NULL; //test code...
-  return head.next;
+/*
+ * This sorts sig arrays of chr block by start position.
+ * *ch: pointer to chr block
+ */
+static void sort_sig(struct chr_block *ch)
+{
+  struct sort_key *key;
+  unsigned long *st, *ed, i;
+  uint32_t *st32, *ed32;
+  float *val;
+
+  key = (struct sort_key *)my_malloc(ch->sig_nb * sizeof(struct sort_key));
+  for (i = 0; i < ch->sig_nb; i++) {
+    key[i].st = SIG_ST(ch, i);
+    key[i].i = i;
+  }
+  radix_sort_key(key, ch->sig_nb);
+
+  val = (float *)my_malloc(ch->sig_nb * sizeof(float));
+  for (i = 0; i < ch->sig_nb; i++) val[i] = ch->sig_val[key[i].i];
+  MYFREE(ch->sig_val);
+  ch->sig_val = val;
+
+  if (ch->sig_wide) {
+    st = (unsigned long *)my_malloc(ch->sig_nb * sizeof(unsigned long));
+    ed = (unsigned long *)my_malloc(ch->sig_nb * sizeof(unsigned long));
+    for (i = 0; i < ch->sig_nb; i++) {
+      st[i] = key[i].st;
+      ed[i] = ch->sig_ed[key[i].i];
+    }
+    MYFREE(ch->sig_st);
+    MYFREE(ch->sig_ed);
+    ch->sig_st = st;
+    ch->sig_ed = ed;
+  } else {
+    st32 = (uint32_t *)my_malloc(ch->sig_nb * sizeof(uint32_t));
+    ed32 = (uint32_t *)my_malloc(ch->sig_nb * sizeof(uint32_t));
+    for (i = 0; i < ch->sig_nb; i++) {
+      st32[i] = (uint32_t)key[i].st;
+      ed32[i] = ch->sig_ed32[key[i].i];
+    }
+    MYFREE(ch->sig_st32);
+    MYFREE(ch->sig_ed32);
+    ch->sig_st32 = st32;
+    ch->sig_ed32 = ed32;
+  }
+  MYFREE(key);
+  ch->sig_len = ch->sig_nb;
 }
 
+/*
+ * This sorts keys by st with LSD radix sort of 8-bit digits. The sort is stable, so keys with the same st keep the order of i.
+ * Digits which are the same in all keys (such as the upper bytes of positions) are skipped.
+ * *key: array of keys
+ * nb: number of keys
+ */
+static void radix_sort_key(struct sort_key *key, const unsigned long nb)
+{
+  unsigned long (*hist)[256], i, sum, tmp;
+  struct sort_key *buf, *src, *dst, *t;
+  int d;
+
+  if (nb < 2) return;
+  hist = (unsigned long (*)[256])my_calloc(8 * 256, sizeof(unsigned long));
+  for (i = 0; i < nb; i++) { //histograms of all digits in one pass
+    for (d = 0; d < 8; d++) hist[d][(key[i].st >> (8 * d)) & 0xff]++;
+  }
+
+  buf = (struct sort_key *)my_malloc(nb * sizeof(struct sort_key));
+  src = key;
+  dst = buf;
+  for (d = 0; d < 8; d++) {
+    if (hist[d][(key[0].st >> (8 * d)) & 0xff] == nb) continue; //all keys have the same digit
+    for (sum = 0, i = 0; i < 256; i++) { //start of each digit in dst
+      tmp = hist[d][i];
+      hist[d][i] = sum;
+      sum += tmp;
+    }
+    for (i = 0; i < nb; i++) dst[hist[d][(src[i].st >> (8 * d)) & 0xff]++] = src[i];
+    t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != key) memcpy(key, src, nb * sizeof(struct sort_key));
+
+  MYFREE(buf);
+  MYFREE(hist);
+}
@@ -5,10 +5,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 struct chr_block *ga_mergesort_chr(struct chr_block *p);
-struct bs *ga_mergesort_bs(struct bs *p);
-struct ref *ga_mergesort_ref(struct ref *p);
-struct sig *ga_mergesort_sig(struct sig *p);
+struct chr_block *ga_sort_chr_block_bs(struct chr_block *p);
+struct chr_block *ga_sort_chr_block_sig(struct chr_block *p);
+struct chr_block *ga_sort_chr_block_ref(struct chr_block *p);
 
 #endif
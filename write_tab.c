@@ -9,12 +9,18 @@
 #include "parse_chr.h"
 #include "ga_my.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 #define LOG(m) \
   fprintf(stderr, \
   "%s:line%d:%s(): " m "\n", \
   __FILE__, __LINE__, __FUNCTION__)
 
 static void get_path (char *str, const char *delim, char *path, size_t path_len, char *fn, size_t fn_len);
+static int write_sigbin (FILE *fp, struct chr_block *chr_block_head);
 
 /*pointer which must be freed: struct output *p, p->line */
 /*
@@ -99,6 +105,27 @@ void ga_parse_file_path (char *file_path, char *path, char *fn, char *ext)
   return;
 }
 
+/*pointer which must be freed: *file */
+/*
+ * This splits comma separated file names. Commas of list are replaced with '\0', and file[i] points into list.
+ * *list : file names separated by comma
+ * ***file: array of file names is returned
+ * This returns the number of file names.
+ */
+int ga_file_list (char *list, char ***file)
+{
+  char *p;
+  int nb = 1;
+
+  for (p = list; *p; p++) if (*p == ',') nb++;
+  *file = (char **)my_malloc(nb * sizeof(char *));
+  for (nb = 0, p = list; p; nb++) {
+    (*file)[nb] = p;
+    if ((p = strchr(p, ',')) != NULL) *p++ = '\0';
+  }
+  return nb;
+}
+
 /*pointer which must be freed: strp, tmp*/
 /*
  * Path and filename are obtained by this function. If *str is "/aaa/bbb/ccc/ddd.eee.txt", *delim="/", *path is "/aaa/bbb/ccc/", and *fn is "ddd.eee.txt"
@@ -191,6 +218,145 @@ err:
   return;
 }
 
+/*
+ * This writes sig of struct chr_block list as binary signal file which is read by ga_parse_sigbin.
+ * sig of each chr should be sorted before writing.
+ * *output: pointer to output filename
+ * *chr_block_head: pointer to struct chr_block head link
+ */
+int ga_write_sigbin (const char *output, struct chr_block *chr_block_head)
+{
+  FILE *fp;
+
+  if ((fp = fopen(output, "wb")) == NULL) {
+    LOG("error: output file cannot be open.");
+    return -1;
+  }
+  return write_sigbin (fp, chr_block_head);
+}
+
+/*
+ * This places sig of struct chr_block list in POSIX shared memory as signal store, which is attached by ga_parse_sigshm.
+ * The layout is the same as binary signal file. The object is removed if writing fails, so a partial store is not left.
+ * *name: name of shared memory object, e.g. /chip1. The existing object is unlinked, and a new object is made under the name,
+ *        so tools which have attached the old one keep reading it until they unmap it, and only later attaches see the new one.
+ * *chr_block_head: pointer to struct chr_block head link. sig of each chr should be sorted.
+ */
+int ga_write_sigshm (const char *name, struct chr_block *chr_block_head)
+{
+  FILE *fp;
+  int fd;
+
+  if (shm_unlink(name) != 0 && errno != ENOENT) { //the old object is never truncated under the tools which map it
+    LOG("error: the existing shared memory object cannot be removed.");
+    return -1;
+  }
+  if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644)) < 0) {
+    LOG("error: shared memory object cannot be open.");
+    return -1;
+  }
+  if ((fp = fdopen(fd, "wb")) == NULL) {
+    LOG("error: shared memory object cannot be open.");
+    close(fd);
+    shm_unlink(name);
+    return -1;
+  }
+  if (write_sigbin (fp, chr_block_head) != 0) {
+    shm_unlink(name);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * This is the body of ga_write_sigbin and ga_write_sigshm. fp is closed.
+ */
+static int write_sigbin (FILE *fp, struct chr_block *chr_block_head)
+{
+  struct chr_block *ch;
+  struct sigbin_header hd;
+  struct sigbin_chr *dir = NULL;
+  uint64_t *buf = NULL, offset, n, c, i;
+  float *fbuf;
+  int col;
+  const size_t buf_nb = 65536; //number of values written at once
+  static const char pad[8] = {0};
+
+  memset(&hd, 0, sizeof(hd));
+  memcpy(hd.magic, SIGBIN_MAGIC, sizeof(hd.magic));
+  hd.version = SIGBIN_VERSION;
+  hd.flags = SIGBIN_SORTED | SIGBIN_DISJOINT;
+  for (ch = chr_block_head; ch; ch = ch->next) hd.chr_nb++;
+
+  dir = (struct sigbin_chr *)my_calloc(hd.chr_nb ? hd.chr_nb : 1, sizeof(struct sigbin_chr));
+  buf = (uint64_t *)my_malloc(buf_nb * sizeof(uint64_t));
+  fbuf = (float *)buf;
+
+  offset = sizeof(struct sigbin_header) + hd.chr_nb * sizeof(struct sigbin_chr);
+  for (ch = chr_block_head, c = 0; ch; ch = ch->next, c++) { //making chr directory
+    if (strlen(ch->chr) >= SIGBIN_CHR_LEN) {
+      fprintf(stderr, "error: chr name %s is too long for binary signal file.\n", ch->chr);
+      goto err_fp;
+    }
+    strcpy(dir[c].chr, ch->chr);
+    dir[c].sig_nb = ch->sig_nb;
+    for (i = 1; i < ch->sig_nb; i++) {
+      if (SIG_ST(ch, i) < SIG_ST(ch, i - 1)) hd.flags &= ~SIGBIN_SORTED;
+    }
+    if (!ga_sig_disjoint (ch)) hd.flags &= ~SIGBIN_DISJOINT; //sorted sig may still overlap each other
+    dir[c].st_offset = offset;
+    offset += dir[c].sig_nb * sizeof(uint64_t);
+    dir[c].ed_offset = offset;
+    offset += dir[c].sig_nb * sizeof(uint64_t);
+    dir[c].val_offset = offset;
+    offset += (dir[c].sig_nb * sizeof(float) + 7) / 8 * 8; //8-byte alignment for the next st array
+  }
+
+  if (fwrite(&hd, sizeof(hd), 1, fp) != 1 || (hd.chr_nb && fwrite(dir, sizeof(struct sigbin_chr), hd.chr_nb, fp) != hd.chr_nb)) {
+    LOG("error: file writing error.");
+    goto err_fp;
+  }
+
+  for (ch = chr_block_head, c = 0; ch; ch = ch->next, c++) {
+    if (!dir[c].sig_nb) continue;
+    for (col = 0; col < 3; col++) { //st, ed, val arrays
+      n = 0;
+      for (i = 0; i < ch->sig_nb; i++) {
+        if (col == 0) buf[n++] = SIG_ST(ch, i);
+        else if (col == 1) buf[n++] = SIG_ED(ch, i);
+        else fbuf[n++] = ch->sig_val[i];
+        if (n == buf_nb || i == ch->sig_nb - 1) {
+          if (fwrite(buf, col == 2 ? sizeof(float) : sizeof(uint64_t), n, fp) != n) {
+            LOG("error: file writing error.");
+            goto err_fp;
+          }
+          n = 0;
+        }
+      }
+    }
+    n = (dir[c].sig_nb * sizeof(float)) % 8;
+    if (n && fwrite(pad, 1, 8 - n, fp) != 8 - n) {
+      LOG("error: file writing error.");
+      goto err_fp;
+    }
+  }
+
+  if (fclose(fp) != 0) {
+    LOG("error: file writing error.");
+    goto err;
+  }
+  MYFREE(dir);
+  MYFREE(buf);
+  return 0;
+
+err_fp:
+  fclose(fp);
+err:
+  MYFREE(dir);
+  MYFREE(buf);
+  return -1;
+}
+
 /*
  * This function add one more value to string. If line_out[xxx], line = "aaa\tbbb\n", val = "ccc\n", line_out is "aaa\tbbb\tccc\n".
  * line_out[]: char array. This must have size of LINE_STR_LEN.
@@ -20,11 +20,16 @@ struct output {
   struct output *tail; //pointer to the tail, for appending a link
 };
 
+struct chr_block;
+
 struct output *ga_output_add (struct output **out_head, const char *line); //caution: the order is reversed
 void ga_output_append (struct output **out_head, const char *line);
 void ga_free_output (struct output **out_head);
 void ga_parse_file_path (char *file_path, char *pathp, char *fnp, char *extp);
+int ga_file_list (char *list, char ***file);
 void ga_write_lines (const char *output, struct output *out_head, const char *header);
 int add_one_val (char line_out[], const char *line, const char *val);
+int ga_write_sigbin (const char *output, struct chr_block *chr_block_head);
+int ga_write_sigshm (const char *name, struct chr_block *chr_block_head);
 
 #endif